@@ -0,0 +1,207 @@
+// Acknowledged delivery checks and lossy link simulation (env:native_ack)
+//
+//   pio run -e native_ack -t exec
+//
+// Checks the downlink command codec, the gateway's command line and the outbox bookkeeping of
+// delivered sources. Then simulates wakes over a link that loses each packet, and each ACK, with
+// the given probability. Without acknowledgements the node sends MSGS_TO_TRANSMIT_BEFORE_DONE + 1
+// messages round-robin over its sources, a record arrives when any copy does. With RF24_ACK_MODE
+// each record is written until acked, the radio retransmits up to RF24_ACK_RETRIES times per write
+// and the node retries a failed write MAX_RETRIES_BEFORE_DONE times. Both run on CVEDOutbox.
+// Exits non-zero when a check fails.
+
+#include <stdio.h>
+#include <string.h>
+#include <random>
+#include <string>
+
+#include "NativeCheck.h"
+
+#include "RF24Command.h"
+#include "RF24Decoder.h"
+#include "VEDirectOutbox.h"
+
+#define MSGS_TO_TRANSMIT 4    // MSGS_TO_TRANSMIT_BEFORE_DONE
+#define ACK_RETRIES 15        // RF24_ACK_RETRIES
+#define MAX_RETRIES 10        // MAX_RETRIES_BEFORE_DONE
+#define SIM_WAKES 20000
+
+class CLinePrint: public Print {
+public:
+  std::string text;
+  virtual size_t write(uint8_t c) { return write(&c, 1); }
+  virtual size_t write(const uint8_t *buffer, size_t size) {
+    text.append(reinterpret_cast<const char*>(buffer), size);
+    return size;
+  }
+};
+
+static ved_snapshot_t snapshotOf(uint8_t source) {
+  ved_snapshot_t snap;
+  memset(&snap, 0, sizeof(snap));
+  snap.deviceClass = source % 2 == 0 ? VED_CLASS_BATT : VED_CLASS_BATT_SUP;
+  snap.pid = 0xA380 + source / 2;
+  return snap;
+}
+
+static void verifyCommands() {
+  uint8_t pipe = 0;
+  r24_command_t command;
+  check(RF24_parseCommand("CMD 2 a4cf1200 SLEEP 600\r", &pipe, &command) && pipe == 2 && command.id == MSG_COMMAND_ID
+    && command.command == RF24_COMMAND_SLEEP && command.target == 0xA4CF1200 && command.value == 600, "sleep command line");
+  check(RF24_parseCommand(" CMD 1 0 RESEND", &pipe, &command) && pipe == 1 && command.command == RF24_COMMAND_RESEND
+    && command.target == RF24_COMMAND_TARGET_ANY, "resend to every node on the pipe");
+  check(RF24_parseCommand("CMD 5 ff SLOT 17", &pipe, &command) && command.command == RF24_COMMAND_SLOT && command.value == 17, "slot command line");
+  check(!RF24_parseCommand("CMD 0 0 RESEND", &pipe, &command), "pipe 0 is refused");
+  check(!RF24_parseCommand("CMD 6 0 RESEND", &pipe, &command), "pipe out of range");
+  check(!RF24_parseCommand("CMD 1 0 SLEEP", &pipe, &command), "sleep without seconds");
+  check(!RF24_parseCommand("CMD 1 0 SLEEP 70000", &pipe, &command), "sleep beyond 16 bit seconds");
+  check(!RF24_parseCommand("CMD 1 0 REBOOT", &pipe, &command), "unknown command");
+  check(!RF24_parseCommand("CMDX 1 0 RESEND", &pipe, &command), "not a command line");
+
+  // Through an ACK payload, applied only by the node it names
+  RF24_parseCommand("CMD 2 a4cf1200 SLEEP 600", &pipe, &command);
+  command.seq = 7;
+  uint8_t payload[32];
+  memcpy(payload, &command, sizeof(command));
+  r24_command_t received;
+  check(sizeof(command) == 11, "command fits any ACK payload");
+  check(RF24_readCommand(payload, sizeof(command), 0xA4CF1200, &received) && received.seq == 7 && received.value == 600, "command for this node");
+  check(!RF24_readCommand(payload, sizeof(command), 0xA4CF1201, &received), "command for another node");
+  check(!RF24_readCommand(payload, sizeof(command) - 1, 0xA4CF1200, &received), "short payload");
+  command.seq = 0;
+  memcpy(payload, &command, sizeof(command));
+  check(!RF24_readCommand(payload, sizeof(command), 0xA4CF1200, &received), "seq 0 is never sent");
+
+  CLinePrint out;
+  CRF24Decoder decoder(&out, 10000);
+  command.seq = 7;
+  decoder.writeCommand(2, command);
+  RF24_parseCommand("CMD 1 0 RESEND", &pipe, &command);
+  command.seq = 8;
+  decoder.writeCommand(1, command);
+  check(out.text == "2 CMD seq=7 target=a4cf1200 SLEEP=600\n1 CMD seq=8 target=00000000 RESEND\n", "command lines");
+}
+
+static void verifyOutbox() {
+  CVEDOutbox outbox;
+  ved_snapshot_t snap;
+  float temp;
+  uint8_t source[3];
+  check(outbox.isDelivered() && outbox.sourceCount() == 0, "empty outbox has nothing to deliver");
+  for (uint8_t s = 0; s < 3; s++) {
+    outbox.put(snapshotOf(s), 20);
+  }
+  for (uint8_t n = 0; n < 3; n++) {
+    uint8_t bit = 0;
+    outbox.take(&snap, &temp, &bit);
+    source[(snap.pid - 0xA380) * 2 + (snap.deviceClass == VED_CLASS_BATT_SUP)] = bit;
+  }
+  check(source[0] != source[1] && source[1] != source[2] && (source[0] | source[1] | source[2]) == 0x07, "a bit per source");
+  outbox.setDelivered(source[0] | source[2]);
+  check(!outbox.isDelivered() && outbox.sourceCount() == 3, "one source still undelivered");
+
+  // The next frame queues the undelivered source only
+  for (uint8_t s = 0; s < 3; s++) {
+    outbox.put(snapshotOf(s), 20);
+  }
+  check(outbox.pendingCount() == 1 && outbox.take(&snap, &temp, &source[1]) && snap.pid == snapshotOf(1).pid, "delivered sources stay quiet");
+  outbox.setDelivered(source[1]);
+  check(outbox.isDelivered() && outbox.isEmpty(), "all delivered");
+
+  outbox.resend();
+  check(outbox.pendingCount() == 3 && !outbox.isDelivered(), "resend queues every source again");
+  outbox.clear();
+  outbox.put(snapshotOf(0), 20);
+  check(outbox.pendingCount() == 1 && !outbox.isDelivered(), "clear forgets the delivered sources");
+}
+
+typedef struct {
+  double delivered;   // Share of records with a copy through
+  double packets;     // Sent per record
+} result_t;
+
+static result_t simulate(uint8_t sources, double loss, bool ack, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> unit(0, 1);
+  CVEDOutbox outbox;
+  uint32_t delivered = 0;
+  uint32_t packets = 0;
+
+  for (uint32_t wake = 0; wake < SIM_WAKES; wake++) {
+    outbox.clear();
+    bool through[VED_OUTBOX_SLOTS] = { false };
+    uint8_t messages = 0;
+    uint8_t retries = 0;
+    while (ack ? !outbox.isDelivered() || outbox.sourceCount() == 0 : messages <= MSGS_TO_TRANSMIT) {
+      ved_snapshot_t snap;
+      float temp;
+      uint8_t source;
+      if (!outbox.take(&snap, &temp, &source)) {
+        for (uint8_t s = 0; s < sources; s++) {
+          outbox.put(snapshotOf(s), 20); // Next TEXT frame
+        }
+        continue;
+      }
+      uint8_t slot = 0;
+      while ((source >> slot) != 1) {
+        slot++;
+      }
+      messages++;
+      if (!ack) {
+        packets++;
+        through[slot] = through[slot] || unit(rng) >= loss;
+        continue;
+      }
+      // Written until acked, a failed write backs off and goes again
+      bool acked = false;
+      while (!acked && retries <= MAX_RETRIES) {
+        for (uint8_t attempt = 0; attempt <= ACK_RETRIES && !acked; attempt++) {
+          packets++;
+          const bool arrived = unit(rng) >= loss;
+          through[slot] = through[slot] || arrived;
+          acked = arrived && unit(rng) >= loss;
+        }
+        if (!acked) {
+          retries++;
+        }
+      }
+      if (!acked) {
+        break; // Lost cause, the log takes it
+      }
+      outbox.setDelivered(source);
+    }
+    for (uint8_t s = 0; s < VED_OUTBOX_SLOTS; s++) {
+      delivered += through[s];
+    }
+  }
+  const double records = static_cast<double>(SIM_WAKES) * sources;
+  result_t result = { delivered / records, packets / records };
+  return result;
+}
+
+int main() {
+  printf("Acknowledged delivery\n");
+  verifyCommands();
+  verifyOutbox();
+
+  printf("\n%u wakes, record delivery (packets per record)\n", SIM_WAKES);
+  printf("%6s %8s %20s %20s\n", "loss", "sources", "repeated", "acked");
+  const double losses[] = { 0, 0.05, 0.1, 0.2, 0.3, 0.5 };
+  for (double loss: losses) {
+    for (uint8_t sources = 1; sources <= 3; sources++) {
+      const result_t repeated = simulate(sources, loss, false, sources);
+      const result_t acked = simulate(sources, loss, true, sources);
+      printf("%5.0f%% %8u %12.3f%% (%4.2f) %12.3f%% (%4.2f)\n", 100 * loss, sources,
+        100 * repeated.delivered, repeated.packets, 100 * acked.delivered, acked.packets);
+      check(acked.delivered >= repeated.delivered, "acked delivers at least as much");
+      if (loss <= 0.1) {
+        check(acked.packets < repeated.packets, "fewer packets per record on a fair link");
+      }
+      if (loss == 0) {
+        check(acked.packets == 1, "one packet per record on a perfect link");
+      }
+    }
+  }
+  return checkSummary();
+}
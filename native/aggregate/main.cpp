@@ -0,0 +1,141 @@
+// Aggregator checks (env:native_aggregate)
+//
+//   pio run -e native_aggregate -t exec
+//
+// Feeds CVEDAggregator snapshots a second apart like the TEXT protocol sends them and checks the
+// window, min/mean/max, the energy and charge integrated between snapshots, what carries into the
+// next window, when the first window of a wake is still pending and which snapshots are left out.
+// Exits non-zero when a check fails.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "NativeCheck.h"
+
+#include "VEDirectAggregate.h"
+
+#define WINDOW_MS 3000        // VED_AGGREGATE_WINDOW_MS
+#define FRAME_MS 1000         // TEXT frame period
+
+static ved_snapshot_t mppt(uint16_t pid, int32_t mV, int32_t mA, int32_t W) {
+  ved_snapshot_t s;
+  memset(&s, 0, sizeof(s));
+  s.deviceClass = VED_CLASS_MPPT;
+  s.pid = pid;
+  s.raw[VED_MPPT_V] = mV;
+  s.raw[VED_MPPT_I] = mA;
+  s.raw[VED_MPPT_PPV] = W;
+  s.present = (1 << VED_MPPT_V) | (1 << VED_MPPT_I) | (1 << VED_MPPT_PPV);
+  return s;
+}
+
+static ved_snapshot_t battery(uint16_t pid, int32_t mV, int32_t mA, int32_t W) {
+  ved_snapshot_t s;
+  memset(&s, 0, sizeof(s));
+  s.deviceClass = VED_CLASS_BATT;
+  s.pid = pid;
+  s.raw[VED_BATT_V] = mV;
+  s.raw[VED_BATT_I] = mA;
+  s.raw[VED_BATT_P] = W;
+  s.present = (1 << VED_BATT_V) | (1 << VED_BATT_I) | (1 << VED_BATT_P);
+  return s;
+}
+
+static void verifyWindow() {
+  CVEDAggregator aggregator;
+  ved_aggregate_t a;
+  const int32_t watts[] = { 100, 200, 300, 400 };
+  for (uint8_t i = 0; i < 3; i++) {
+    aggregator.add(mppt(0xA053, 13000 + i * 100, 2000 * (i + 1), watts[i]), i * FRAME_MS);
+  }
+  check(!aggregator.isReady(WINDOW_MS) && !aggregator.take(&a, WINDOW_MS), "no aggregate before the window is full");
+  check(aggregator.isPending(2 * FRAME_MS), "pending while the first window fills");
+  aggregator.add(mppt(0xA053, 13300, 8000, watts[3]), 3 * FRAME_MS);
+  check(aggregator.isReady(WINDOW_MS), "ready once the window spans WINDOW_MS");
+  check(aggregator.take(&a, WINDOW_MS), "taken once ready");
+  check(a.pid == 0xA053 && a.deviceClass == VED_CLASS_MPPT && a.samples == 4, "device and sample count");
+  check(a.firstMs == 0 && a.lastMs == 3 * FRAME_MS, "window bounds");
+  check(a.voltage.min == 13000 && a.voltage.max == 13300 && CVEDAggregator::mean(a.voltage, a.samples) == 13150, "voltage min/mean/max");
+  check(a.power.min == 100 && a.power.max == 400 && CVEDAggregator::mean(a.power, a.samples) == 250, "power min/mean/max");
+  // Each value holds until the next snapshot: 100 + 200 + 300 W for a second each
+  check(a.energy == 600LL * FRAME_MS, "energy integrated between snapshots");
+  check(a.charge == 12000LL * FRAME_MS, "charge integrated between snapshots");
+  check(!aggregator.isReady(WINDOW_MS) && !aggregator.take(&a, WINDOW_MS), "restarted after take");
+  check(!aggregator.isPending(3 * FRAME_MS), "not pending once taken");
+
+  // The last values carry over, the interval up to the next snapshot counts in the next window
+  for (uint8_t i = 4; i <= 7; i++) {
+    aggregator.add(mppt(0xA053, 13000, 1000, 50), i * FRAME_MS);
+  }
+  check(aggregator.take(&a, WINDOW_MS), "second window");
+  check(a.firstMs == 3 * FRAME_MS && a.samples == 4, "second window starts where the first ended");
+  check(!aggregator.isPending(7 * FRAME_MS), "later windows don't hold the wake");
+  check(a.energy == (400LL + 3 * 50) * FRAME_MS, "carried power integrated into the second window");
+  check(a.charge == (8000LL + 3 * 1000) * FRAME_MS, "carried current integrated into the second window");
+}
+
+static void verifyUnits() {
+  CVEDAggregator aggregator;
+  ved_aggregate_t a;
+  // An hour of 12 W and 1 A discharge, a frame a second
+  for (uint32_t t = 0; t <= 3600; t++) {
+    aggregator.add(battery(0xA389, 12000, -1000, -12), t * FRAME_MS);
+  }
+  check(aggregator.take(&a, WINDOW_MS), "hour window");
+  check(CVEDAggregator::energyMWh(a) == -12000, "energy in mWh");
+  check(CVEDAggregator::chargeMAh(a) == -1000, "charge in mAh");
+  check(a.current.min == -1000 && a.current.max == -1000, "negative current kept");
+}
+
+static void verifyFiltering() {
+  CVEDAggregator aggregator;
+  ved_aggregate_t a;
+
+  ved_snapshot_t partial = mppt(0xA053, 13000, 1000, 10);
+  partial.present &= ~(1 << VED_MPPT_I);
+  aggregator.add(partial, 0);
+  aggregator.add(partial, WINDOW_MS);
+  check(!aggregator.isReady(0) && !aggregator.isPending(WINDOW_MS), "partial snapshots are ignored");
+
+  ved_snapshot_t history;
+  memset(&history, 0, sizeof(history));
+  history.deviceClass = VED_CLASS_BATT_SUP;
+  history.present = 0xFFFF;
+  aggregator.add(history, 0);
+  history.deviceClass = VED_CLASS_COUNT;
+  aggregator.add(history, 0);
+  check(!aggregator.isReady(0), "classes without V, I or P are ignored");
+
+  // A gap longer than VED_AGGREGATE_MAX_GAP_MS isn't integrated, the samples still count
+  aggregator.add(mppt(0xA053, 13000, 1000, 10), 0);
+  check(aggregator.isPending(VED_AGGREGATE_MAX_GAP_MS) && !aggregator.isPending(VED_AGGREGATE_MAX_GAP_MS + 1), "a device that stopped sending isn't waited for");
+  aggregator.add(mppt(0xA053, 13000, 1000, 10), VED_AGGREGATE_MAX_GAP_MS + 1);
+  check(aggregator.take(&a, WINDOW_MS) && a.samples == 2 && a.energy == 0 && a.charge == 0, "no integration across a gap");
+
+  // Only VED_AGGREGATE_SOURCES devices at once
+  aggregator.clear();
+  for (uint16_t pid = 0; pid < VED_AGGREGATE_SOURCES + 1; pid++) {
+    aggregator.add(mppt(0xA050 + pid, 13000, 1000, 10), 0);
+    aggregator.add(mppt(0xA050 + pid, 13000, 1000, 10), WINDOW_MS);
+  }
+  uint8_t taken = 0;
+  while (aggregator.take(&a, WINDOW_MS)) {
+    taken++;
+  }
+  check(taken == VED_AGGREGATE_SOURCES, "devices beyond VED_AGGREGATE_SOURCES are dropped");
+
+  aggregator.add(mppt(0xA053, 13000, 1000, 10), 0);
+  aggregator.add(mppt(0xA053, 13000, 1000, 10), WINDOW_MS);
+  aggregator.clear();
+  check(!aggregator.isReady(0) && !aggregator.isPending(WINDOW_MS), "clear() drops every window");
+  aggregator.add(mppt(0xA053, 13000, 1000, 10), 2 * WINDOW_MS);
+  check(aggregator.isPending(2 * WINDOW_MS), "pending again after clear()");
+}
+
+int main() {
+  printf("Aggregator\n");
+  verifyWindow();
+  verifyUnits();
+  verifyFiltering();
+  return checkSummary();
+}
@@ -0,0 +1,206 @@
+#pragma once
+
+// TEXT protocol output recorded from the devices in the installation (4 seconds each)
+
+static const char captureMPPT[] =
+  "\r\nPID\t0xA057"
+  "\r\nFW\t159"
+  "\r\nSER#\tHQ2132QY2KR"
+  "\r\nV\t13439"
+  "\r\nI\t2089"
+  "\r\nVPV\t18309"
+  "\r\nPPV\t19"
+  "\r\nCS\t3"
+  "\r\nMPPT\t2"
+  "\r\nOR\t0x00000000"
+  "\r\nERR\t0"
+  "\r\nLOAD\tON"
+  "\r\nIL\t0"
+  "\r\nH19\t12345"
+  "\r\nH20\t45"
+  "\r\nH21\t210"
+  "\r\nH22\t52"
+  "\r\nH23\t230"
+  "\r\nHSDS\t123"
+  "\r\nChecksum\t2"
+  "\r\nPID\t0xA057"
+  "\r\nFW\t159"
+  "\r\nSER#\tHQ2132QY2KR"
+  "\r\nV\t13446"
+  "\r\nI\t2096"
+  "\r\nVPV\t18316"
+  "\r\nPPV\t26"
+  "\r\nCS\t3"
+  "\r\nMPPT\t2"
+  "\r\nOR\t0x00000000"
+  "\r\nERR\t0"
+  "\r\nLOAD\tON"
+  "\r\nIL\t0"
+  "\r\nH19\t12345"
+  "\r\nH20\t45"
+  "\r\nH21\t210"
+  "\r\nH22\t52"
+  "\r\nH23\t230"
+  "\r\nHSDS\t123"
+  "\r\nChecksum\t:"
+  "\r\nPID\t0xA057"
+  "\r\nFW\t159"
+  "\r\nSER#\tHQ2132QY2KR"
+  "\r\nV\t13453"
+  "\r\nI\t2103"
+  "\r\nVPV\t18323"
+  "\r\nPPV\t33"
+  "\r\nCS\t3"
+  "\r\nMPPT\t2"
+  "\r\nOR\t0x00000000"
+  "\r\nERR\t0"
+  "\r\nLOAD\tON"
+  "\r\nIL\t0"
+  "\r\nH19\t12345"
+  "\r\nH20\t45"
+  "\r\nH21\t210"
+  "\r\nH22\t52"
+  "\r\nH23\t230"
+  "\r\nHSDS\t123"
+  "\r\nChecksum\tK"
+  "\r\nPID\t0xA057"
+  "\r\nFW\t159"
+  "\r\nSER#\tHQ2132QY2KR"
+  "\r\nV\t13460"
+  "\r\nI\t2110"
+  "\r\nVPV\t18330"
+  "\r\nPPV\t40"
+  "\r\nCS\t3"
+  "\r\nMPPT\t2"
+  "\r\nOR\t0x00000000"
+  "\r\nERR\t0"
+  "\r\nLOAD\tON"
+  "\r\nIL\t0"
+  "\r\nH19\t12345"
+  "\r\nH20\t45"
+  "\r\nH21\t210"
+  "\r\nH22\t52"
+  "\r\nH23\t230"
+  "\r\nHSDS\t123"
+  "\r\nChecksum\tS";
+
+static const char captureSmartShunt[] =
+  "\r\nPID\t0xA389"
+  "\r\nV\t13269"
+  "\r\nVS\t12950"
+  "\r\nI\t-1261"
+  "\r\nP\t-17"
+  "\r\nCE\t-23400"
+  "\r\nSOC\t865"
+  "\r\nTTG\t1440"
+  "\r\nAlarm\tOFF"
+  "\r\nRelay\tOFF"
+  "\r\nAR\t0"
+  "\r\nBMV\tSmartShunt 500A/50mV"
+  "\r\nFW\t0416"
+  "\r\nMON\t0"
+  "\r\nChecksum\t;"
+  "\r\nH1\t-102345"
+  "\r\nH2\t-23400"
+  "\r\nH3\t-50000"
+  "\r\nH4\t42"
+  "\r\nH5\t0"
+  "\r\nH6\t-2345678"
+  "\r\nH7\t11890"
+  "\r\nH8\t14450"
+  "\r\nH9\t86400"
+  "\r\nH10\t3"
+  "\r\nH11\t0"
+  "\r\nH12\t0"
+  "\r\nH15\t12"
+  "\r\nH16\t13900"
+  "\r\nH17\t23456"
+  "\r\nH18\t26789"
+  "\r\nChecksum\t" "\xa8"
+  "\r\nPID\t0xA389"
+  "\r\nV\t13276"
+  "\r\nVS\t12950"
+  "\r\nI\t-1254"
+  "\r\nP\t-17"
+  "\r\nCE\t-23400"
+  "\r\nSOC\t872"
+  "\r\nTTG\t1440"
+  "\r\nAlarm\tOFF"
+  "\r\nRelay\tOFF"
+  "\r\nAR\t0"
+  "\r\nBMV\tSmartShunt 500A/50mV"
+  "\r\nFW\t0416"
+  "\r\nMON\t0"
+  "\r\nChecksum\t="
+  "\r\nH1\t-102345"
+  "\r\nH2\t-23400"
+  "\r\nH3\t-50000"
+  "\r\nH4\t42"
+  "\r\nH5\t0"
+  "\r\nH6\t-2345678"
+  "\r\nH7\t11890"
+  "\r\nH8\t14450"
+  "\r\nH9\t86400"
+  "\r\nH10\t3"
+  "\r\nH11\t0"
+  "\r\nH12\t0"
+  "\r\nH15\t12"
+  "\r\nH16\t13900"
+  "\r\nH17\t23456"
+  "\r\nH18\t26789"
+  "\r\nChecksum\t" "\xa8";
+
+static const char captureInverter[] =
+  "\r\nPID\t0xA2FA"
+  "\r\nFW\t0114"
+  "\r\nSER#\tHQ1929A1B2C"
+  "\r\nMODE\t2"
+  "\r\nCS\t9"
+  "\r\nAR\t0"
+  "\r\nWARN\t0"
+  "\r\nV\t12939"
+  "\r\nAC_OUT_V\t23000"
+  "\r\nAC_OUT_I\t13"
+  "\r\nAC_OUT_S\t289"
+  "\r\nOR\t0x00000000"
+  "\r\nChecksum\t" "\x93"
+  "\r\nPID\t0xA2FA"
+  "\r\nFW\t0114"
+  "\r\nSER#\tHQ1929A1B2C"
+  "\r\nMODE\t2"
+  "\r\nCS\t9"
+  "\r\nAR\t0"
+  "\r\nWARN\t0"
+  "\r\nV\t12946"
+  "\r\nAC_OUT_V\t23000"
+  "\r\nAC_OUT_I\t13"
+  "\r\nAC_OUT_S\t296"
+  "\r\nOR\t0x00000000"
+  "\r\nChecksum\t" "\x97"
+  "\r\nPID\t0xA2FA"
+  "\r\nFW\t0114"
+  "\r\nSER#\tHQ1929A1B2C"
+  "\r\nMODE\t2"
+  "\r\nCS\t9"
+  "\r\nAR\t0"
+  "\r\nWARN\t0"
+  "\r\nV\t12953"
+  "\r\nAC_OUT_V\t23000"
+  "\r\nAC_OUT_I\t13"
+  "\r\nAC_OUT_S\t303"
+  "\r\nOR\t0x00000000"
+  "\r\nChecksum\t" "\xa4"
+  "\r\nPID\t0xA2FA"
+  "\r\nFW\t0114"
+  "\r\nSER#\tHQ1929A1B2C"
+  "\r\nMODE\t2"
+  "\r\nCS\t9"
+  "\r\nAR\t0"
+  "\r\nWARN\t0"
+  "\r\nV\t12960"
+  "\r\nAC_OUT_V\t23000"
+  "\r\nAC_OUT_I\t13"
+  "\r\nAC_OUT_S\t310"
+  "\r\nOR\t0x00000000"
+  "\r\nChecksum\t" "\xa8";
+
@@ -0,0 +1,134 @@
+// VE.Direct parser throughput benchmark (env:native)
+//
+//   pio run -e native -t exec
+//
+// Replays recorded TEXT streams through CVEDirectParser and the schema decoder,
+// the same path CVEDirectManager takes from the UART to a message struct.
+
+#include <chrono>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <Arduino.h>
+
+#include "SensorProvider.h"
+#include "VEDirectParser.h"
+#include "VEDirectSchema.h"
+#include "Captures.h"
+
+#define BENCH_BYTES_PER_CAPTURE (8UL * 1024 * 1024)
+
+static unsigned long allocations = 0;
+
+void* operator new(size_t size) {
+  allocations++;
+  void *p = malloc(size);
+  if (p == NULL) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t size) noexcept { free(p); }
+void operator delete[](void *p, size_t size) noexcept { free(p); }
+
+// Replays a recorded capture in a loop, like a device broadcasting once a second
+class CFakeStream: public Stream {
+
+private:
+  const uint8_t *data;
+  size_t length, pos;
+
+public:
+  CFakeStream(const char *data, size_t length)
+  :data(reinterpret_cast<const uint8_t*>(data)), length(length), pos(0) {}
+
+  virtual int available() { return 1; }
+  virtual int read() { uint8_t c = data[pos]; pos = (pos + 1) % length; return c; }
+  virtual int peek() { return data[pos]; }
+  virtual size_t write(uint8_t c) { return 1; }
+};
+
+class CStubSensor: public ISensorProvider {
+public:
+  virtual float getTemperature(bool *current) { if (current != NULL) { *current = true; } return 21.5; }
+  virtual bool isSensorReady() { return true; }
+};
+
+// Mirrors CVEDirectManager::frameEndEvent up to the point a message would be built
+class CBenchHandler: public IVEDFrameHandler {
+
+private:
+  ISensorProvider *sensor;
+  uint16_t lastPid;
+
+public:
+  ved_snapshot_t snap;
+  unsigned long captured;
+
+  CBenchHandler(ISensorProvider *sensor): sensor(sensor), lastPid(0), captured(0) {}
+
+  virtual void frameEndEvent(const CVEDFrame &frame) {
+    bool tempCurrent = false;
+    sensor->getTemperature(&tempCurrent);
+    if (!sensor->isSensorReady() || !tempCurrent) {
+      return;
+    }
+
+    uint8_t deviceClass = VED_CLASS_NONE;
+    if (frame.has(VED_LABEL_PID)) {
+      lastPid = static_cast<uint16_t>(frame.getInt(VED_LABEL_PID));
+      switch(lastPid) {
+        case 0xA057: case 0xA055: deviceClass = VED_CLASS_MPPT; break;
+        case 0xA2FA: deviceClass = VED_CLASS_INV; break;
+        case 0xA389: deviceClass = VED_CLASS_BATT; break;
+      }
+    } else if (lastPid == 0xA389) {
+      deviceClass = VED_CLASS_BATT_SUP;
+    }
+    if (deviceClass != VED_CLASS_NONE) {
+      VED_capture(frame, deviceClass, lastPid, &snap);
+      captured++;
+    }
+  }
+};
+
+static void bench(const char *name, const char *capture, size_t length) {
+  CFakeStream stream(capture, length);
+  CStubSensor sensor;
+  CBenchHandler handler(&sensor);
+  CVEDirectParser parser(&handler);
+
+  // Warm up and sync to the frame boundary
+  for (size_t i = 0; i < length; i++) {
+    parser.rxData(stream.read());
+  }
+  const ved_parser_stats_t before = parser.getStats();
+  const unsigned long allocBefore = allocations;
+
+  const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  for (unsigned long i = 0; i < BENCH_BYTES_PER_CAPTURE && stream.available() > 0; i++) {
+    parser.rxData(stream.read());
+  }
+  const std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+
+  const ved_parser_stats_t &after = parser.getStats();
+  const double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+  const unsigned long bytes = after.bytes - before.bytes;
+  const unsigned long frames = after.frames - before.frames;
+  const unsigned long errors = after.checksumErrors - before.checksumErrors;
+
+  printf("%-12s %10lu %8lu %6lu %10.2f %8.2f %10.3f\n", name, bytes, frames, errors,
+    bytes / ns * 1e3, ns / bytes, frames > 0 ? (double)(allocations - allocBefore) / frames : 0.0);
+}
+
+int main(int argc, char **argv) {
+  printf("%-12s %10s %8s %6s %10s %8s %10s\n", "capture", "bytes", "frames", "bad", "MB/s", "ns/byte", "alloc/frm");
+  bench("MPPT", captureMPPT, sizeof(captureMPPT) - 1);
+  bench("SmartShunt", captureSmartShunt, sizeof(captureSmartShunt) - 1);
+  bench("Inverter", captureInverter, sizeof(captureInverter) - 1);
+  return 0;
+}
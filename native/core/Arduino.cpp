@@ -0,0 +1,30 @@
+#include <chrono>
+#include <thread>
+
+#include <Arduino.h>
+#include <ArduinoLog.h>
+
+Logging Log;
+
+static const std::chrono::steady_clock::time_point tBoot = std::chrono::steady_clock::now();
+
+unsigned long millis() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tBoot).count();
+}
+
+unsigned long micros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tBoot).count();
+}
+
+void delay(unsigned long ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+void delayMicroseconds(unsigned int us) { std::this_thread::sleep_for(std::chrono::microseconds(us)); }
+void yield() { std::this_thread::yield(); }
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+void digitalWrite(uint8_t pin, uint8_t val) {}
+int digitalRead(uint8_t pin) { return LOW; }
+int analogRead(uint8_t pin) { return 0; }
+
+long random(long max) { return max > 0 ? rand() % max : 0; }
+long random(long min, long max) { return min < max ? min + rand() % (max - min) : min; }
+void randomSeed(unsigned long seed) { srand(seed); }
@@ -0,0 +1,317 @@
+// Gateway decode core load test (env:native_gateway)
+//
+//   pio run -e native_gateway -t exec
+//
+// Feeds CRF24Decoder the traffic of growing numbers of nodes waking at the same time: fixed
+// layout, packed and aggregate messages, log markers with replayed payloads, every payload sent
+// MSGS_TO_TRANSMIT_BEFORE_DONE times and interleaved with the other nodes. Checks that each
+// payload comes out exactly once and that a snapshot reads the same in every format, then
+// reports the decode rate and the serial bandwidth the lines need at the radio's packet rate.
+// Exits non-zero when a check fails.
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "NativeCheck.h"
+
+#include "RF24Decoder.h"
+#include "VEDirectPacked.h"
+#include "RF24Message_VED_AGG.h"
+#include "RF24Message_LOG.h"
+
+// Stand-ins for the stus-rf24-commons ids, registered like the gateway does
+#define TEST_UVTHP_ID 0x01
+#define TEST_MPPT_ID 0x02
+#define TEST_INV_ID 0x03
+#define TEST_BATT_ID 0x04
+#define TEST_BATT_SUP_ID 0x05
+
+#define COPIES 4              // MSGS_TO_TRANSMIT_BEFORE_DONE
+#define WAKES 20
+#define WAKE_INTERVAL_MS 300000
+#define AIR_TIME_US 1300      // 32 byte payload at 250 kbps with preamble, address and CRC
+#define SERIAL_BYTES_PER_SEC 92160 // 921600 baud 8N1
+
+class CLinePrint: public Print {
+public:
+  std::string text;
+  uint32_t bytes = 0;
+  bool keep = true;
+  virtual size_t write(uint8_t c) { return write(&c, 1); }
+  virtual size_t write(const uint8_t *buffer, size_t size) {
+    if (keep) {
+      text.append(reinterpret_cast<const char*>(buffer), size);
+    }
+    bytes += size;
+    return size;
+  }
+};
+
+typedef struct packet_t {
+  uint8_t pipe;
+  uint8_t payload[RF24_DECODER_PAYLOAD_SIZE];
+} packet_t;
+
+static void registerLayouts(CRF24Decoder &decoder) {
+  decoder.addLayout(TEST_UVTHP_ID, VED_CLASS_NONE, false);
+  decoder.addLayout(TEST_MPPT_ID, VED_CLASS_MPPT, true);
+  decoder.addLayout(TEST_INV_ID, VED_CLASS_INV, true);
+  decoder.addLayout(TEST_BATT_ID, VED_CLASS_BATT, false);
+  decoder.addLayout(TEST_BATT_SUP_ID, VED_CLASS_BATT_SUP, true);
+}
+
+// What the node's r24_message_ved_*_t initializers produce: id, schema fields, temperature
+static void encodeFixed(const ved_snapshot_t &snap, float temperature, uint8_t *out) {
+  static const uint8_t ids[VED_CLASS_COUNT] = { 0, TEST_MPPT_ID, TEST_INV_ID, TEST_BATT_ID, TEST_BATT_SUP_ID };
+  const VEDSchema *schema = VED_schema(snap.deviceClass);
+  memset(out, 0, RF24_DECODER_PAYLOAD_SIZE);
+  uint8_t n = 0;
+  out[n++] = ids[snap.deviceClass];
+  for (uint8_t f = 0; f < schema->count; f++) {
+    switch (schema->fields[f].type) {
+      case VED_FIELD_F32: { const float v = snap.value<float>(f); memcpy(out + n, &v, 4); n += 4; break; }
+      case VED_FIELD_U8: out[n++] = snap.value<uint8_t>(f); break;
+      case VED_FIELD_I8: out[n++] = static_cast<uint8_t>(snap.value<int8_t>(f)); break;
+      case VED_FIELD_U16: { const uint16_t v = snap.value<uint16_t>(f); memcpy(out + n, &v, 2); n += 2; break; }
+      case VED_FIELD_I16: { const int16_t v = snap.value<int16_t>(f); memcpy(out + n, &v, 2); n += 2; break; }
+    }
+  }
+  if (snap.deviceClass != VED_CLASS_BATT) {
+    memcpy(out + n, &temperature, 4);
+  }
+}
+
+// Values on the packed quanta and within the field types, so every format carries them exactly
+static void snapshotFor(uint32_t node, uint32_t wake, uint8_t deviceClass, ved_snapshot_t *snap) {
+  const VEDSchema *schema = VED_schema(deviceClass);
+  snap->deviceClass = deviceClass;
+  snap->pid = static_cast<uint16_t>(0xA000 + node);
+  snap->present = static_cast<uint16_t>((1 << schema->count) - 1);
+  for (uint8_t f = 0; f < schema->count; f++) {
+    const VEDFieldSpec &spec = schema->fields[f];
+    const int32_t value = static_cast<int32_t>((node * 7919 + wake * 104729 + f * 31) % 200);
+    switch (spec.type) {
+      case VED_FIELD_U8: snap->raw[f] = value; break;
+      case VED_FIELD_I8: snap->raw[f] = value - 100; break;
+      case VED_FIELD_I16: snap->raw[f] = value * 10 - 1000; break;
+      default: snap->raw[f] = (value + 1000) * VED_packedQuantum(spec.unit); break;
+    }
+  }
+}
+
+static void packet(std::vector<packet_t> &out, uint8_t pipe, const void *payload, uint8_t length) {
+  packet_t p;
+  p.pipe = pipe;
+  memset(p.payload, 0, sizeof(p.payload));
+  memcpy(p.payload, payload, length);
+  out.push_back(p);
+}
+
+// Distinct payloads of one node's wake, each producing expectLines lines
+static void wakePayloads(uint32_t node, uint32_t wake, std::vector<packet_t> &out, uint32_t *expectLines, uint32_t *expectReplays) {
+  const uint8_t pipe = 1 + node % 2;
+  const uint8_t deviceClass = 1 + node % 3;
+  const float temperature = 20.0f + (node % 10);
+  ved_snapshot_t snap;
+  snapshotFor(node, wake, deviceClass, &snap);
+
+  uint8_t buffer[RF24_DECODER_PAYLOAD_SIZE];
+  encodeFixed(snap, temperature, buffer);
+  packet(out, pipe, buffer, sizeof(buffer));
+  (*expectLines)++;
+  if (deviceClass == VED_CLASS_BATT) {
+    ved_snapshot_t sup;
+    snapshotFor(node, wake, VED_CLASS_BATT_SUP, &sup);
+    encodeFixed(sup, temperature, buffer);
+    packet(out, pipe, buffer, sizeof(buffer));
+    (*expectLines)++;
+  }
+
+  CVEDPackedWriter writer;
+  writer.begin(temperature);
+  writer.add(snap);
+  packet(out, pipe, writer.getBuffer(), writer.getLength());
+  (*expectLines)++;
+
+  r24_message_ved_agg_t agg;
+  memset(&agg, 0, sizeof(agg));
+  agg.id = MSG_VED_AGG_ID;
+  agg.pid = snap.pid;
+  agg.samples = 10;
+  agg.seconds = 3;
+  agg.energy = static_cast<int32_t>(node * 100 + wake);
+  packet(out, pipe, &agg, sizeof(agg));
+  (*expectLines)++;
+
+  // Every 8th node drains two payloads of an earlier wake from its log
+  if (node % 8 == 0 && wake > 0) {
+    const r24_message_log_marker_t marker = { MSG_LOG_MARKER_ID, 600 + node, 2 };
+    packet(out, pipe, &marker, sizeof(marker));
+    (*expectLines)++;
+    for (uint32_t r = 0; r < 2; r++) {
+      ved_snapshot_t old;
+      snapshotFor(node, wake + 100 + r, deviceClass, &old);
+      CVEDPackedWriter replay;
+      replay.begin(temperature);
+      replay.add(old);
+      packet(out, pipe, replay.getBuffer(), replay.getLength());
+      (*expectLines)++;
+      (*expectReplays)++;
+    }
+  }
+}
+
+static std::string afterType(const std::string &line, bool dropPid) {
+  std::string rest = line.substr(line.find(' ', line.find(' ') + 1));
+  if (dropPid) {
+    const size_t pid = rest.find(" pid=");
+    rest.erase(pid, 9);
+  }
+  return rest;
+}
+
+static void verifyFormats() {
+  CLinePrint out;
+  CRF24Decoder decoder(&out, 10000);
+  registerLayouts(decoder);
+
+  for (uint8_t deviceClass = VED_CLASS_MPPT; deviceClass < VED_CLASS_COUNT; deviceClass++) {
+    ved_snapshot_t snap;
+    snapshotFor(5, 3, deviceClass, &snap);
+    uint8_t fixed[RF24_DECODER_PAYLOAD_SIZE];
+    encodeFixed(snap, 21.5f, fixed);
+    CVEDPackedWriter writer;
+    writer.begin(deviceClass == VED_CLASS_BATT ? NAN : 21.5f);
+    writer.add(snap);
+
+    out.text.clear();
+    decoder.decode(1, fixed, sizeof(fixed), 0);
+    const std::string fixedLine = out.text;
+    out.text.clear();
+    decoder.decode(1, writer.getBuffer(), writer.getLength(), 0);
+    const std::string packedLine = out.text;
+    check(!fixedLine.empty() && afterType(fixedLine, false) == afterType(packedLine, true), "fixed and packed layout decode to the same record");
+  }
+
+  out.text.clear();
+  uint8_t status[RF24_DECODER_PAYLOAD_SIZE] = { TEST_UVTHP_ID };
+  const uint32_t uptime = 12345;
+  const float values[4] = { 3.3f, NAN, 45.5f, NAN };
+  memcpy(status + 1, &uptime, 4);
+  memcpy(status + 5, values, sizeof(values));
+  status[21] = 1;
+  decoder.decode(2, status, sizeof(status), 0);
+  check(out.text == "2 STATUS up=12345 mV=3300 rh=455 err=1\n", "status message");
+
+  out.text.clear();
+  const uint8_t unknown[4] = { 0x7E, 0x01, 0x00, 0x00 };
+  decoder.decode(3, unknown, sizeof(unknown), 0);
+  check(out.text == "3 RAW 7e01\n", "unknown id as raw hex");
+
+  // Copies within the window are dropped, the same payload on another pipe is another node
+  out.text.clear();
+  decoder.decode(3, unknown, sizeof(unknown), 5000);
+  decoder.decode(4, unknown, sizeof(unknown), 5000);
+  decoder.decode(3, unknown, sizeof(unknown), 10001);
+  check(out.text == "4 RAW 7e01\n3 RAW 7e01\n", "dedupe per pipe and window");
+
+  // The payloads counted by a marker carry its age
+  out.text.clear();
+  const r24_message_log_marker_t marker = { MSG_LOG_MARKER_ID, 600, 1 };
+  decoder.decode(5, reinterpret_cast<const uint8_t*>(&marker), sizeof(marker), 20000);
+  ved_snapshot_t snap;
+  snapshotFor(1, 1, VED_CLASS_MPPT, &snap);
+  snap.present = 1 << VED_MPPT_V | 1 << VED_MPPT_CS;
+  CVEDPackedWriter writer;
+  writer.begin(NAN);
+  writer.add(snap);
+  decoder.decode(5, writer.getBuffer(), writer.getLength(), 20000);
+  snap.raw[VED_MPPT_CS] = 3;
+  writer.begin(-1.25f);
+  writer.add(snap);
+  decoder.decode(5, writer.getBuffer(), writer.getLength(), 20000);
+  check(out.text == "5 LOG age=600 count=1\n"
+    "5 MPPT pid=a001 V=10480 CS=172 age=600\n"
+    "5 MPPT pid=a001 t=-13 V=10480 CS=3\n", "replayed payloads carry the marker age");
+
+  // A cut payload decodes as far as it goes and is counted
+  const rf24_decoder_stats_t before = decoder.getStats();
+  decoder.decode(5, writer.getBuffer(), writer.getLength() - 1, 30000);
+  check(decoder.getStats().malformed == before.malformed + 1, "truncated packed payload is malformed");
+}
+
+// Every node wakes at once and sends its payloads COPIES times, node streams interleaved at random
+static void loadTest(uint32_t nodes, bool report) {
+  CLinePrint out;
+  out.keep = false;
+  CRF24Decoder decoder(&out, 10000);
+  registerLayouts(decoder);
+  std::mt19937 rng(nodes);
+
+  uint32_t expectLines = 0;
+  uint32_t expectReplays = 0;
+  uint32_t packets = 0;
+  double decodeSec = 0;
+  std::vector<std::vector<packet_t> > streams(nodes);
+  std::vector<packet_t> air;
+  for (uint32_t wake = 0; wake < WAKES; wake++) {
+    air.clear();
+    std::vector<uint32_t> order;
+    for (uint32_t node = 0; node < nodes; node++) {
+      streams[node].clear();
+      wakePayloads(node, wake, streams[node], &expectLines, &expectReplays);
+      for (uint32_t i = 0; i < streams[node].size() * COPIES; i++) {
+        order.push_back(node);
+      }
+    }
+    std::shuffle(order.begin(), order.end(), rng);
+    std::vector<uint32_t> sent(nodes, 0);
+    for (uint32_t node: order) {
+      const std::vector<packet_t> &stream = streams[node];
+      air.push_back(stream[sent[node]++ % stream.size()]);
+    }
+
+    const uint32_t wakeMs = wake * WAKE_INTERVAL_MS;
+    const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < air.size(); i++) {
+      decoder.decode(air[i].pipe, air[i].payload, RF24_DECODER_PAYLOAD_SIZE, wakeMs + i * AIR_TIME_US / 1000);
+    }
+    decodeSec += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    packets += air.size();
+  }
+
+  const rf24_decoder_stats_t &stats = decoder.getStats();
+  if (nodes <= 128) {
+    check(stats.lines == expectLines, "one line per distinct payload");
+    check(stats.duplicates == packets - expectLines, "every copy dropped");
+    check(stats.unknown == 0 && stats.malformed == 0, "every payload decodes");
+  }
+  if (!report) {
+    return;
+  }
+  // Several nodes on one address can drain their logs at the same time, the ages then go astray
+  const double packetsPerSec = 1000000.0 / AIR_TIME_US;
+  const double bytesPerPacket = static_cast<double>(out.bytes) / packets;
+  printf("%6u %9u %9u %9u %8u/%-6u %10.2f %9.0f %8.0f%%\n", nodes, packets, stats.lines, stats.lines - expectLines,
+    stats.replays, expectReplays, decodeSec * 1e9 / packets, packets / decodeSec,
+    100 * bytesPerPacket * packetsPerSec / SERIAL_BYTES_PER_SEC);
+}
+
+int main() {
+  printf("Gateway decoder, %u dedupe slots, %u ms window\n", RF24_DECODER_DEDUPE_SLOTS, 10000);
+  verifyFormats();
+
+  printf("\n%6s %9s %9s %9s %15s %10s %9s %9s\n", "nodes", "payloads", "lines", "extra", "replays", "ns/payload", "payload/s", "serial");
+  const uint32_t counts[] = { 8, 16, 32, 64, 128, 256 };
+  for (uint32_t n: counts) {
+    loadTest(n, true);
+  }
+  printf("serial: share of %u baud the lines need with the radio saturated (%u payloads/s)\n", SERIAL_BYTES_PER_SEC * 10, 1000000 / AIR_TIME_US);
+
+  return checkSummary();
+}
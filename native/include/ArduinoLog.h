@@ -0,0 +1,29 @@
+#pragma once
+
+// Host stand-in for thijse/ArduinoLog, every call is a no-op
+
+#include <Arduino.h>
+
+#define LOG_LEVEL_SILENT  0
+#define LOG_LEVEL_FATAL   1
+#define LOG_LEVEL_ERROR   2
+#define LOG_LEVEL_WARNING 3
+#define LOG_LEVEL_INFO    4
+#define LOG_LEVEL_NOTICE  4
+#define LOG_LEVEL_TRACE   5
+#define LOG_LEVEL_VERBOSE 6
+
+class Logging {
+public:
+  void begin(int level, Print *output, bool showLevel = true) {};
+  int getLevel() { return LOG_LEVEL_SILENT; }
+  template <class T, typename... Args> void fatalln(T msg, Args... args) {};
+  template <class T, typename... Args> void errorln(T msg, Args... args) {};
+  template <class T, typename... Args> void warningln(T msg, Args... args) {};
+  template <class T, typename... Args> void noticeln(T msg, Args... args) {};
+  template <class T, typename... Args> void infoln(T msg, Args... args) {};
+  template <class T, typename... Args> void traceln(T msg, Args... args) {};
+  template <class T, typename... Args> void verboseln(T msg, Args... args) {};
+};
+
+extern Logging Log;
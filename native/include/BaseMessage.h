@@ -0,0 +1,20 @@
+#pragma once
+
+// Host stand-in for the stus-rf24-commons message base, so the in-tree message layouts
+// can be used by host programs. The messages themselves are only built for the boards.
+
+#include <Arduino.h>
+
+class String;
+
+class CBaseMessage {
+protected:
+  uint8_t pipe;
+
+public:
+  CBaseMessage(uint8_t pipe): pipe(pipe) {};
+  virtual ~CBaseMessage() {};
+  virtual const void* getMessageBuffer() = 0;
+  virtual const uint8_t getMessageLength() = 0;
+  virtual const String getString() = 0;
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdio.h>
+
+// Failure bookkeeping of the native harnesses. A failed check prints what was expected and the
+// harness carries on, checkSummary() prints OK or the number of failures and gives the exit code.
+
+inline int& checkFailures() {
+  static int failures = 0;
+  return failures;
+}
+
+inline void check(bool condition, const char *what) {
+  if (!condition) {
+    printf("  FAILED: %s\n", what);
+    checkFailures()++;
+  }
+}
+
+// Names the expression and its line instead of a description
+#define EXPECT(cond) do { if (!(cond)) { printf("  FAILED %s:%i: %s\n", __FILE__, __LINE__, #cond); checkFailures()++; } } while(0)
+
+inline int checkSummary() {
+  printf(checkFailures() == 0 ? "OK\n" : "%i FAILED\n", checkFailures());
+  return checkFailures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,212 @@
+// Store-and-forward log checks and append/flush benchmark (env:native_log)
+//
+//   pio run -e native_log -t exec
+//
+// Runs CVEDLog over a RAM store with flash semantics in the geometry of each board: ESP8266
+// RTC user memory, ESP32 RTC slow memory and SAMD21 flash rows. Checks order, remount, overflow,
+// torn writes and garbage memory, then times append, drain and mount and reports how evenly the
+// sectors wear. Exits non-zero when a check fails.
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "NativeCheck.h"
+
+#include "VEDirectLog.h"
+
+#define BENCH_RECORDS 200000
+#define PAYLOAD_SIZE 24 // Packed frame with one or two device records
+
+typedef struct geometry_t {
+  const char *name;
+  uint16_t size;
+  uint16_t sectorSize;
+} geometry_t;
+
+static const geometry_t geometries[] = {
+  { "ESP8266 RTC user memory", 132, 44 },
+  { "ESP32 RTC slow memory", 2048, 256 },
+  { "SAMD21 flash", 4096, 256 }
+};
+
+// Counts erases per sector to show the wear leveling
+class CCountingStore: public CVEDLogRamStore {
+public:
+  std::vector<uint32_t> sectorErases;
+
+  CCountingStore(uint8_t *memory, uint16_t size, uint16_t sectorSize)
+  :CVEDLogRamStore(memory, size, sectorSize), sectorErases(size / sectorSize, 0) {}
+
+  virtual void erase(uint16_t sector) {
+    CVEDLogRamStore::erase(sector);
+    sectorErases[sector]++;
+  }
+};
+
+static void payloadFor(uint32_t n, uint8_t *payload, uint8_t length) {
+  for (uint8_t i = 0; i < length; i++) {
+    payload[i] = static_cast<uint8_t>(n * 31 + i);
+  }
+}
+
+// Pending records must be exactly first..first+count-1, oldest first
+static bool expectRecords(CVEDLog &log, uint32_t first, uint32_t count) {
+  if (log.pendingCount() != count) {
+    return false;
+  }
+  uint16_t cursor = log.first();
+  ved_log_record_t record;
+  uint8_t expected[VED_LOG_MAX_PAYLOAD];
+  for (uint32_t n = first; n < first + count; n++) {
+    if (!log.read(cursor, &record) || record.clock != n || record.length != PAYLOAD_SIZE) {
+      return false;
+    }
+    payloadFor(n, expected, PAYLOAD_SIZE);
+    if (memcmp(record.payload, expected, PAYLOAD_SIZE) != 0) {
+      return false;
+    }
+    log.next(&cursor);
+  }
+  return !log.read(cursor, &record);
+}
+
+static void append(CVEDLog &log, uint32_t n) {
+  uint8_t payload[PAYLOAD_SIZE];
+  payloadFor(n, payload, PAYLOAD_SIZE);
+  log.append(n, payload, PAYLOAD_SIZE);
+}
+
+static uint32_t capacityOf(const geometry_t &g) {
+  // One sector is always being refilled
+  return (g.size / g.sectorSize - 1) * ((g.sectorSize - 1) / (VED_LOG_HEADER_SIZE + PAYLOAD_SIZE));
+}
+
+static void verify(const geometry_t &g) {
+  std::vector<uint8_t> memory(g.size);
+  std::mt19937 rng(1);
+  const uint32_t capacity = capacityOf(g);
+
+  // Cold boot with garbage in memory
+  for (size_t i = 0; i < memory.size(); i++) {
+    memory[i] = rng();
+  }
+  CVEDLogRamStore store(memory.data(), g.size, g.sectorSize);
+  {
+    CVEDLog log(&store);
+    log.mount();
+    check(log.isEmpty(), "garbage mounts as an empty log");
+    for (uint32_t n = 0; n < capacity; n++) {
+      append(log, n);
+    }
+    check(expectRecords(log, 0, capacity), "records read back in order");
+    log.pop();
+    log.pop();
+    check(expectRecords(log, 2, capacity - 2), "pop removes the oldest");
+  }
+  {
+    CVEDLog log(&store);
+    log.mount();
+    check(expectRecords(log, 2, capacity - 2), "remount keeps pending records and order");
+
+    // Overflow drops the oldest
+    for (uint32_t n = capacity; n < capacity * 3; n++) {
+      append(log, n);
+    }
+    const uint32_t pending = log.pendingCount();
+    check(pending >= capacity && expectRecords(log, capacity * 3 - pending, pending), "overflow keeps the newest records");
+    check(log.getStats().dropped == capacity * 3 - 2 - pending, "dropped records are counted");
+    while (log.pop()) {}
+    ved_log_record_t record;
+    check(log.isEmpty() && !log.read(log.first(), &record), "drained");
+  }
+  {
+    CVEDLog log(&store);
+    log.mount();
+    check(log.isEmpty(), "remount after drain is empty");
+    for (uint32_t n = 100; n < 103; n++) {
+      append(log, n);
+    }
+  }
+  {
+    // Power lost in the middle of a write: the torn record is ignored, the sector is not written again
+    CVEDLog log(&store);
+    log.mount();
+    uint16_t cursor = log.first();
+    log.next(&cursor);
+    log.next(&cursor);
+    log.next(&cursor);
+    const uint8_t torn[4] = { VED_LOG_MAGIC, PAYLOAD_SIZE, VED_LOG_PENDING, 0x00 };
+    store.program(cursor, torn, sizeof(torn));
+  }
+  {
+    CVEDLog log(&store);
+    log.mount();
+    check(expectRecords(log, 100, 3), "torn write leaves earlier records intact");
+    append(log, 103);
+    const uint32_t pending = log.pendingCount();
+    check(pending > 1 && expectRecords(log, 104 - pending, pending), "appends continue after a torn write");
+  }
+}
+
+static void bench(const geometry_t &g) {
+  std::vector<uint8_t> memory(g.size, 0xFF);
+  CCountingStore store(memory.data(), g.size, g.sectorSize);
+  CVEDLog log(&store);
+  log.mount();
+  uint8_t payload[PAYLOAD_SIZE];
+  payloadFor(0, payload, PAYLOAD_SIZE);
+  const uint32_t capacity = capacityOf(g);
+
+  // Outage pattern: fill while the link is down, then drain everything
+  double appendSec = 0, drainSec = 0, mountSec = 0;
+  uint32_t appended = 0, drained = 0, mounts = 0;
+  ved_log_record_t record;
+  while (appended < BENCH_RECORDS) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < capacity; i++) {
+      log.append(appended++, payload, PAYLOAD_SIZE);
+    }
+    appendSec += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    CVEDLog remounted(&store);
+    remounted.mount();
+    mountSec += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    mounts++;
+
+    start = std::chrono::steady_clock::now();
+    while (log.read(log.first(), &record)) {
+      log.pop();
+      drained++;
+    }
+    drainSec += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  uint32_t minErases = UINT32_MAX, maxErases = 0;
+  for (size_t s = 0; s < store.sectorErases.size(); s++) {
+    minErases = store.sectorErases[s] < minErases ? store.sectorErases[s] : minErases;
+    maxErases = store.sectorErases[s] > maxErases ? store.sectorErases[s] : maxErases;
+  }
+  printf("%-24s %6u %6u %8u %9.1f %9.1f %9.1f %9.2f %6u-%u\n", g.name, g.size, g.sectorSize, capacity,
+    appendSec / appended * 1e9, drainSec / drained * 1e9, mountSec / mounts * 1e9,
+    1000.0 * store.getEraseCount() / appended, minErases, maxErases);
+  check(maxErases - minErases <= 1, "sectors wear evenly");
+}
+
+int main() {
+  for (size_t i = 0; i < sizeof(geometries) / sizeof(geometries[0]); i++) {
+    printf("%s\n", geometries[i].name);
+    verify(geometries[i]);
+  }
+
+  printf("\n%-24s %6s %6s %8s %9s %9s %9s %9s %8s\n", "store", "bytes", "sector", "records",
+    "append ns", "drain ns", "mount ns", "erase/1k", "wear");
+  for (size_t i = 0; i < sizeof(geometries) / sizeof(geometries[0]); i++) {
+    bench(geometries[i]);
+  }
+
+  return checkSummary();
+}
@@ -0,0 +1,253 @@
+// Burst parity checks and lossy channel comparison (env:native_parity)
+//
+//   pio run -e native_parity -t exec
+//
+// Checks that CRF24ParityDecoder rebuilds exactly the one payload of a burst that was lost, and
+// nothing when it can't, also through CRF24Decoder. Then runs wakes like CRF24Manager does
+// without acknowledgements: every TEXT frame brings the snapshots of SOURCES devices, they go out
+// in bursts of up to RF24_BURST_SIZE until more than MSGS_TO_TRANSMIT_BEFORE_DONE messages were
+// sent, with RF24_PARITY a parity after each burst of two or more counted as one of them. A record
+// arrives when any copy does or the parity brings it back. The channel drops packets at a mean
+// rate, independently or in bursts (Gilbert-Elliott, CHANNEL_BURST packets on average).
+// Exits non-zero when a check fails.
+
+#include <stdio.h>
+#include <string.h>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "NativeCheck.h"
+
+#include "RF24Parity.h"
+#include "RF24Decoder.h"
+
+#define PAYLOAD_SIZE 32       // Static payload size of the radio
+#define BURST_SIZE 3          // RF24_BURST_SIZE
+#define SIM_WAKES 20000
+#define CHANNEL_BURST 4.0     // Mean length of a loss burst in packets, bursty channel
+#define FRAME_GAP_PACKETS 50  // Channel steps between the bursts of two frames, a second apart
+
+class CLinePrint: public Print {
+public:
+  std::string text;
+  virtual size_t write(uint8_t c) { return write(&c, 1); }
+  virtual size_t write(const uint8_t *buffer, size_t size) {
+    text.append(reinterpret_cast<const char*>(buffer), size);
+    return size;
+  }
+};
+
+typedef struct {
+  uint8_t bytes[PAYLOAD_SIZE]; // Zero padded like a static payload
+  uint8_t length;
+} payload_t;
+
+static payload_t makePayload(std::mt19937 &rng, uint8_t length) {
+  payload_t p;
+  memset(p.bytes, 0, sizeof(p.bytes));
+  p.length = length;
+  for (uint8_t i = 0; i < length; i++) {
+    p.bytes[i] = rng();
+  }
+  p.bytes[0] = 0x10 + rng() % 0x60; // Not a parity, marker or packed id
+  p.bytes[length - 1] |= 1;         // Real last byte
+  return p;
+}
+
+static payload_t encode(const payload_t *members, uint8_t count) {
+  CRF24ParityEncoder encoder;
+  for (uint8_t i = 0; i < count; i++) {
+    encoder.add(members[i].bytes, members[i].length);
+  }
+  payload_t parity;
+  memset(parity.bytes, 0, sizeof(parity.bytes));
+  memcpy(parity.bytes, encoder.getBuffer(), encoder.getLength());
+  parity.length = encoder.getLength();
+  return parity;
+}
+
+static void verifyCodec() {
+  std::mt19937 rng(1);
+  payload_t members[3] = { makePayload(rng, 29), makePayload(rng, 20), makePayload(rng, 7) };
+  const payload_t parity = encode(members, 3);
+  check(parity.length == RF24_PARITY_HEADER_SIZE + 29 && parity.bytes[0] == MSG_PARITY_ID, "parity fits a payload");
+  uint8_t rebuilt[PAYLOAD_SIZE];
+
+  bool exact = true;
+  for (uint8_t lost = 0; lost < 3; lost++) {
+    CRF24ParityDecoder decoder;
+    for (uint8_t i = 0; i < 3; i++) {
+      if (i != lost) {
+        decoder.add(members[i].bytes, PAYLOAD_SIZE, 1000);
+      }
+    }
+    exact = exact && decoder.rebuild(parity.bytes, PAYLOAD_SIZE, 1002, rebuilt, sizeof(rebuilt))
+      && memcmp(rebuilt, members[lost].bytes, PAYLOAD_SIZE) == 0;
+  }
+  check(exact, "any one lost payload is rebuilt exactly");
+
+  CRF24ParityDecoder decoder;
+  for (uint8_t i = 0; i < 3; i++) {
+    decoder.add(members[i].bytes, PAYLOAD_SIZE, 1000);
+  }
+  check(!decoder.rebuild(parity.bytes, PAYLOAD_SIZE, 1001, rebuilt, sizeof(rebuilt)), "nothing to rebuild when all arrived");
+  decoder.add(members[0].bytes, PAYLOAD_SIZE, 2000);
+  check(!decoder.rebuild(parity.bytes, PAYLOAD_SIZE, 2001, rebuilt, sizeof(rebuilt)), "two lost can't be rebuilt");
+  decoder.add(members[0].bytes, PAYLOAD_SIZE, 3000);
+  decoder.add(members[1].bytes, PAYLOAD_SIZE, 3000);
+  check(!decoder.rebuild(parity.bytes, PAYLOAD_SIZE, 3000 + RF24_PARITY_WINDOW_MS + 1, rebuilt, sizeof(rebuilt)), "members from before the window");
+
+  // The parity of the last burst was lost, its members are still the newest but one
+  const payload_t next[3] = { makePayload(rng, 25), makePayload(rng, 25), makePayload(rng, 12) };
+  const payload_t nextParity = encode(next, 3);
+  for (uint8_t i = 0; i < 3; i++) {
+    decoder.add(members[i].bytes, PAYLOAD_SIZE, 4000);
+  }
+  decoder.add(next[0].bytes, PAYLOAD_SIZE, 4002);
+  decoder.add(next[2].bytes, PAYLOAD_SIZE, 4002);
+  check(decoder.rebuild(nextParity.bytes, PAYLOAD_SIZE, 4003, rebuilt, sizeof(rebuilt)) && memcmp(rebuilt, next[1].bytes, PAYLOAD_SIZE) == 0,
+    "rebuilt after a lost parity");
+
+  // Another node on the address sent in between, the check refuses the mix
+  const payload_t foreign = makePayload(rng, 18);
+  decoder.add(members[0].bytes, PAYLOAD_SIZE, 5000);
+  decoder.add(foreign.bytes, PAYLOAD_SIZE, 5000);
+  decoder.add(members[1].bytes, PAYLOAD_SIZE, 5001);
+  check(!decoder.rebuild(parity.bytes, PAYLOAD_SIZE, 5002, rebuilt, sizeof(rebuilt)), "foreign payload in the group");
+
+  CRF24ParityEncoder encoder;
+  check(!encoder.add(rebuilt, RF24_PARITY_MAX_MEMBER + 1), "too long for a member");
+
+  // Through the gateway decoder, the lost payload comes out once as if received
+  CLinePrint expected, out;
+  CRF24Decoder reference(&expected, 10000);
+  reference.decode(2, members[1].bytes, PAYLOAD_SIZE, 0);
+  CRF24Decoder gateway(&out, 10000);
+  gateway.decode(2, members[0].bytes, PAYLOAD_SIZE, 0);
+  gateway.decode(2, members[2].bytes, PAYLOAD_SIZE, 0);
+  const size_t before = out.text.size();
+  gateway.decode(2, parity.bytes, PAYLOAD_SIZE, 1);
+  check(gateway.getStats().rebuilt == 1 && out.text.substr(before) == expected.text, "decoder writes the rebuilt payload");
+  gateway.decode(2, members[1].bytes, PAYLOAD_SIZE, 10);
+  check(gateway.getStats().duplicates == 1, "a late copy is a duplicate of the rebuilt one");
+}
+
+// Gilbert-Elliott channel, good state loses nothing, bad state everything
+class CChannel {
+private:
+  std::mt19937 rng;
+  std::uniform_real_distribution<double> unit;
+  double enterBad, leaveBad;
+  bool bad;
+
+public:
+  CChannel(double loss, double burst, uint32_t seed): rng(seed), unit(0, 1), bad(false) {
+    leaveBad = 1 / burst;
+    enterBad = loss * leaveBad / (1 - loss);
+  }
+  void step() {
+    bad = bad ? unit(rng) >= leaveBad : unit(rng) < enterBad;
+  }
+  bool send() {
+    step();
+    return !bad;
+  }
+};
+
+typedef struct {
+  double delivered;   // Share of records through
+  double packets;     // Sent per record
+  uint32_t wrong;     // Rebuilt payloads that weren't sent
+} result_t;
+
+static result_t simulate(uint8_t sources, uint8_t messages, bool parity, double loss, double burst, uint32_t seed) {
+  std::mt19937 rng(seed);
+  CChannel channel(loss, burst, seed + 1);
+  CRF24ParityDecoder decoder;
+  result_t result = { 0, 0, 0 };
+  uint32_t now = 0;
+
+  for (uint32_t wake = 0; wake < SIM_WAKES; wake++) {
+    std::vector<payload_t> sent;
+    std::vector<uint8_t> sentSource;
+    std::vector<bool> through(sources, false);
+    uint8_t transmitted = 0;
+    while (transmitted <= messages) {
+      // Next frame, polled while the message budget lasts
+      payload_t burstPayloads[BURST_SIZE];
+      uint8_t burstSources[BURST_SIZE];
+      uint8_t count = 0;
+      for (uint8_t s = 0; s < sources && count < BURST_SIZE && transmitted + count <= messages; s++) {
+        burstPayloads[count] = makePayload(rng, 20 + rng() % 10);
+        burstSources[count++] = s;
+      }
+      for (uint8_t i = 0; i < count; i++) {
+        sent.push_back(burstPayloads[i]);
+        sentSource.push_back(burstSources[i]);
+        if (channel.send()) {
+          through[burstSources[i]] = true;
+          decoder.add(burstPayloads[i].bytes, PAYLOAD_SIZE, now);
+        }
+      }
+      transmitted += count;
+      result.packets += count;
+      if (parity && count > 1) {
+        const payload_t p = encode(burstPayloads, count);
+        transmitted++;
+        result.packets++;
+        uint8_t rebuilt[PAYLOAD_SIZE];
+        if (channel.send() && decoder.rebuild(p.bytes, PAYLOAD_SIZE, now, rebuilt, sizeof(rebuilt))) {
+          bool found = false;
+          for (size_t i = 0; i < sent.size(); i++) {
+            if (memcmp(rebuilt, sent[i].bytes, PAYLOAD_SIZE) == 0) {
+              through[sentSource[i]] = true;
+              found = true;
+            }
+          }
+          result.wrong += !found;
+        }
+      }
+      for (uint8_t g = 0; g < FRAME_GAP_PACKETS; g++) {
+        channel.step();
+      }
+      now += 1000;
+    }
+    for (uint8_t s = 0; s < sources; s++) {
+      result.delivered += through[s];
+    }
+    now += 300000;
+  }
+  const double records = static_cast<double>(SIM_WAKES) * sources;
+  result.delivered /= records;
+  result.packets /= records;
+  return result;
+}
+
+static void table(const char *name, double burst) {
+  printf("\n%s channel, %u wakes, record delivery (packets per record)\n", name, SIM_WAKES);
+  printf("%5s %7s %8s %20s %20s\n", "loss", "sources", "messages", "repeated", "parity");
+  const double losses[] = { 0.05, 0.1, 0.2, 0.3 };
+  for (double loss: losses) {
+    for (uint8_t sources = 2; sources <= 3; sources++) {
+      for (uint8_t messages = 2; messages <= 6; messages += 2) {
+        const result_t repeated = simulate(sources, messages, false, loss, burst, sources * 100 + messages);
+        const result_t parity = simulate(sources, messages, true, loss, burst, sources * 100 + messages);
+        printf("%4.0f%% %7u %8u %12.3f%% (%4.2f) %12.3f%% (%4.2f)\n", 100 * loss, sources, messages,
+          100 * repeated.delivered, repeated.packets, 100 * parity.delivered, parity.packets);
+        check(parity.wrong == 0, "no payload rebuilt that wasn't sent");
+        if (burst == 1 && loss <= 0.1) {
+          check(parity.delivered >= repeated.delivered, "parity delivers at least as much on an independent channel");
+        }
+      }
+    }
+  }
+}
+
+int main() {
+  printf("Burst parity\n");
+  verifyCodec();
+  table("Independent loss", 1);
+  table("Bursty loss", CHANNEL_BURST);
+  return checkSummary();
+}
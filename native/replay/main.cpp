@@ -0,0 +1,247 @@
+// Replays recorded VE.Direct streams through the parser and fuzzes them (env:native_replay)
+//
+//   pio run -e native_replay -t exec
+//   .pio/build/native_replay/program [seed] [file.ved ...]
+//
+// Capture files (.ved) hold the raw bytes read from the VE.Direct UART (19200 8N1), TEXT frames
+// and HEX messages exactly as they arrived, without any header. Without file arguments the corpus
+// in native/corpus is replayed.
+//
+// Every capture must parse without a checksum error. The fuzzer then mutates each capture and checks:
+//  - HEX messages inserted between any two bytes of TEXT frames leave every frame intact
+//  - a frame accepted after corruption is identical to a frame of the original capture,
+//    the additive checksum may let through at most a few multi-byte corruptions
+// Exits non-zero when a capture fails or an invariant is broken.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "NativeCheck.h"
+
+#include "VEDirectParser.h"
+#include "VEDirectHex.h"
+
+#define FUZZ_ROUNDS 2000
+#define FUZZ_FALSE_ACCEPT_PERMILLE 10
+#define REPLAY_BYTES (8UL << 20)
+
+static const char* const corpus[] = {
+  "native/corpus/MPPT.ved",
+  "native/corpus/MPPT_async_hex.ved",
+  "native/corpus/SmartShunt.ved",
+  "native/corpus/Inverter.ved"
+};
+
+// Same wiring as CVEDirectManager: TEXT frames to the handler, HEX bytes to the HEX engine
+class CReplayHandler: public IVEDFrameHandler, public IVEDHexHandler {
+
+public:
+  CVEDirectParser parser;
+  CVEDirectHex hex;
+  std::vector<std::string> frames;
+  bool keepFrames;
+
+  CReplayHandler(): parser(this), hex(this), keepFrames(true) {}
+
+  void feed(const std::string &bytes) {
+    for (size_t i = 0; i < bytes.size(); i++) {
+      parser.rxData(static_cast<uint8_t>(bytes[i]));
+    }
+  }
+
+  virtual void frameEndEvent(const CVEDFrame &frame) {
+    if (!keepFrames) {
+      return;
+    }
+    std::string fingerprint;
+    for (uint8_t l = 0; l < VED_LABEL_COUNT; l++) {
+      if (frame.has((VEDLabel)l)) {
+        fingerprint += VED_labelName(l);
+        fingerprint += '=';
+        fingerprint += frame.get((VEDLabel)l);
+        fingerprint += ';';
+      }
+    }
+    frames.push_back(fingerprint);
+  }
+  virtual bool hexRxEvent(uint8_t inbyte) { return hex.rxData(inbyte); }
+  virtual void hexWrite(const uint8_t *buffer, uint8_t length) {}
+};
+
+static bool readCapture(const char *path, std::string *bytes) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) {
+    return false;
+  }
+  char buffer[4096];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+    bytes->append(buffer, n);
+  }
+  fclose(f);
+  return true;
+}
+
+static std::string hexMessage(std::mt19937 &rng) {
+  // Async message of a random register, the way a device pushes value changes
+  uint8_t payload[5] = { static_cast<uint8_t>(rng()), static_cast<uint8_t>(rng()), 0, static_cast<uint8_t>(rng()), static_cast<uint8_t>(rng()) };
+  uint8_t buffer[32];
+  const uint8_t n = CVEDirectHex::encode(VED_HEX_RSP_ASYNC, payload, sizeof(payload), buffer);
+  return std::string(reinterpret_cast<char*>(buffer), n);
+}
+
+// Offsets a HEX message can't be inserted at: a checksum value, where ':' is data rather than the
+// start of a HEX message, and the inside of another HEX message, devices never nest them
+static std::set<size_t> protectedBytes(const std::string &bytes) {
+  std::set<size_t> offsets;
+  size_t pos = 0;
+  while ((pos = bytes.find("Checksum\t", pos)) != std::string::npos) {
+    pos += 9;
+    offsets.insert(pos);
+  }
+  pos = 0;
+  while ((pos = bytes.find(':', pos)) != std::string::npos) {
+    if (offsets.count(pos) > 0) {
+      pos++;
+      continue;
+    }
+    const size_t end = bytes.find('\n', pos);
+    for (pos++; pos <= end && pos < bytes.size(); pos++) {
+      offsets.insert(pos);
+    }
+  }
+  return offsets;
+}
+
+static void replay(const char *name, const std::string &capture) {
+  CReplayHandler handler;
+  handler.feed(capture);
+  const ved_parser_stats_t &stats = handler.parser.getStats();
+  printf("%-34s %8zu %8u %8u %8u %8u\n", name, capture.size(), stats.frames, stats.checksumErrors, stats.droppedRecords, stats.hexMessages);
+  check(stats.checksumErrors == 0 && stats.frames > 0, "capture parses cleanly");
+}
+
+static void fuzz(const char *name, const std::string &capture, const std::set<std::string> &baseline, size_t baselineFrames, std::mt19937 &rng) {
+  unsigned long accepted = 0, rejected = 0, falseAccepts = 0, hexLosses = 0;
+
+  for (int round = 0; round < FUZZ_ROUNDS; round++) {
+    std::string bytes = capture;
+    const int kind = round % 4;
+    switch(kind) {
+      case 0: { // Bit flip
+        const size_t pos = rng() % bytes.size();
+        bytes[pos] ^= 1 << (rng() % 8);
+        break;
+      }
+      case 1: { // Random byte values
+        for (int i = 1 + rng() % 4; i > 0; i--) {
+          bytes[rng() % bytes.size()] = static_cast<char>(rng());
+        }
+        break;
+      }
+      case 2: { // Dropped or repeated run, also stretches names and values past their buffers
+        const size_t pos = rng() % bytes.size();
+        const size_t len = 1 + rng() % 40;
+        if (rng() % 2) {
+          bytes.erase(pos, len);
+        } else {
+          bytes.insert(pos, bytes.substr(pos, len));
+        }
+        break;
+      }
+      case 3: { // Interleaved HEX, frames must survive
+        for (int i = 1 + rng() % 3; i > 0; i--) {
+          const std::set<size_t> taken = protectedBytes(bytes);
+          size_t pos;
+          do {
+            pos = rng() % bytes.size();
+          } while (taken.count(pos) > 0);
+          bytes.insert(pos, hexMessage(rng));
+        }
+        break;
+      }
+    }
+
+    CReplayHandler handler;
+    handler.feed(bytes);
+    for (size_t i = 0; i < handler.frames.size(); i++) {
+      if (baseline.count(handler.frames[i]) == 0) {
+        falseAccepts++;
+      }
+    }
+    accepted += handler.frames.size();
+    rejected += handler.parser.getStats().checksumErrors;
+    if (kind == 3 && handler.frames.size() != baselineFrames) {
+      hexLosses++;
+    }
+  }
+
+  printf("%-34s %8lu %8lu %8lu %8lu\n", name, accepted, rejected, falseAccepts, hexLosses);
+  check(hexLosses == 0, "no frames lost to interleaved HEX messages");
+  check(falseAccepts * 1000 <= FUZZ_ROUNDS * FUZZ_FALSE_ACCEPT_PERMILLE, "corrupted frames rejected");
+}
+
+static void throughput(const std::vector<std::string> &captures) {
+  std::string stream;
+  while (stream.size() < REPLAY_BYTES) {
+    for (size_t i = 0; i < captures.size(); i++) {
+      stream += captures[i];
+    }
+  }
+  CReplayHandler handler;
+  handler.keepFrames = false;
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  handler.feed(stream);
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  printf("\nReplayed %zu bytes, %u frames in %.3f s: %.2f MB/s\n", stream.size(), handler.parser.getStats().frames,
+    seconds, stream.size() / seconds / 1e6);
+}
+
+int main(int argc, char **argv) {
+  const unsigned long seed = argc > 1 ? strtoul(argv[1], NULL, 0) : 1;
+  std::vector<const char*> files;
+  for (int i = 2; i < argc; i++) {
+    files.push_back(argv[i]);
+  }
+  if (files.empty()) {
+    files.assign(corpus, corpus + sizeof(corpus) / sizeof(corpus[0]));
+  }
+
+  std::vector<std::string> captures;
+  std::vector<std::set<std::string> > baselines;
+  std::vector<size_t> baselineFrames;
+
+  printf("%-34s %8s %8s %8s %8s %8s\n", "replay", "bytes", "frames", "bad", "dropped", "hex");
+  for (size_t i = 0; i < files.size(); i++) {
+    std::string capture;
+    if (!readCapture(files[i], &capture) || capture.empty()) {
+      printf("%-34s\n", files[i]);
+      check(false, "capture can be read");
+      continue;
+    }
+    CReplayHandler handler;
+    handler.feed(capture);
+    captures.push_back(capture);
+    baselines.push_back(std::set<std::string>(handler.frames.begin(), handler.frames.end()));
+    baselineFrames.push_back(handler.frames.size());
+    replay(files[i], capture);
+  }
+
+  printf("\n%-34s %8s %8s %8s %8s   (seed %lu, %i rounds)\n", "fuzz", "accepted", "rejected", "false", "hexloss", seed, FUZZ_ROUNDS);
+  std::mt19937 rng(seed);
+  for (size_t i = 0; i < captures.size(); i++) {
+    fuzz(files[i], captures[i], baselines[i], baselineFrames[i], rng);
+  }
+
+  if (!captures.empty()) {
+    throughput(captures);
+  }
+
+  return checkSummary();
+}
@@ -0,0 +1,270 @@
+// Transmit slot checks and multi-node channel simulation (env:native_slots)
+//
+//   pio run -e native_slots -t exec
+//
+// Checks CRF24Slots, then simulates nodes that boot together and share RF24_CHANNEL for
+// SIM_CYCLES sleep intervals. Every wake a node sends SIM_BURSTS bursts of SIM_RECORDS payloads,
+// one burst per TEXT frame, and a record arrives when any of its copies does. Two packets that
+// overlap on air are both lost. Each node's sleep timer runs off by a random amount up to the
+// given ppm. The strategies compared:
+//
+//   fixed  sleep DEEP_SLEEP_INTERVAL_SEC after the wake, no listening, as before RF24_TX_SLOTS
+//   listen the same sleep, listen before a burst and back off when busy
+//   slots  wake in the slot and listen, never move
+//   move   the same, and move to another slot after a wake with a busy channel (RF24_TX_SLOTS)
+//
+// Exits non-zero when a check fails.
+
+#include <stdio.h>
+#include <algorithm>
+#include <queue>
+#include <random>
+#include <vector>
+
+#include "NativeCheck.h"
+
+#include "RF24Slots.h"
+
+#define INTERVAL_SEC 300      // DEEP_SLEEP_INTERVAL_SEC
+#define INTERVAL_MS (INTERVAL_SEC * 1000)
+#define SLOT_MS 5000          // RF24_SLOT_MS
+#define AIR_US 1300           // 32 byte payload at 250 kbps with preamble, address and CRC
+#define SENSE_US 200          // RF24_CARRIER_SENSE_US
+#define SENSE_HEARD 0.9       // Chance another node's carrier is above the RPD threshold
+#define BACKOFF_BASE_MS 100   // RF24_BACKOFF_BASE_MS
+#define BACKOFF_MAX_MS 5000
+#define MAX_RETRIES 10
+#define BOOT_SPREAD_MS 200    // Nodes powered up together
+#define SIM_CYCLES 500
+#define SIM_BURSTS 2
+#define SIM_RECORDS 3
+
+enum Strategy { FIXED, LISTEN, SLOTS, MOVE };
+
+typedef struct {
+  int64_t start;   // us
+  uint32_t record; // Global record number
+  bool lost;
+} packet_t;
+
+typedef struct {
+  int64_t at;      // us
+  uint32_t node;
+  uint8_t burst;
+  uint8_t retries;
+} event_t;
+
+struct Later {
+  bool operator()(const event_t &a, const event_t &b) const { return a.at > b.at; }
+};
+typedef std::priority_queue<event_t, std::vector<event_t>, Later> event_queue_t;
+
+typedef struct {
+  rf24_slot_state_t state;
+  CRF24Slots *slots;
+  double rate;       // Real duration of a nominal sleep ms
+  int64_t wakeUs;
+  uint64_t clockMs;  // What the node believes at wake
+  uint8_t pending;   // Bursts not done this wake
+  int64_t doneUs;
+  uint32_t firstRecord;
+} node_t;
+
+typedef struct {
+  double records;    // Share of records with a copy through
+  double packets;
+  uint32_t moves;
+  uint32_t busy;
+} result_t;
+
+static void verifySlots() {
+  rf24_slot_state_t state = { 0, 0, 0 };
+  CRF24Slots slots(&state, INTERVAL_SEC, SLOT_MS);
+  check(slots.getCount() == 60, "60 slots in 5 min");
+
+  slots.begin(0x12345678, -1);
+  check(state.intervalSec == INTERVAL_SEC && state.slot == CRF24Slots::slotOf(0x12345678, 60), "first slot from the device id");
+  state.slot = 17;
+  slots.begin(0x12345678, -1);
+  check(state.slot == 17, "valid retained slot is kept");
+  rf24_slot_state_t other = { 17, 0, 0 };
+  CRF24Slots reconfigured(&other, INTERVAL_SEC, SLOT_MS);
+  reconfigured.begin(0, 5);
+  check(other.slot == 5 && other.intervalSec == INTERVAL_SEC, "cleared state starts over, fixed slot");
+
+  // Interval set by the gateway, kept across wakes
+  reconfigured.setInterval(60);
+  check(other.intervalSec == 60 && reconfigured.getCount() == 12 && other.slot == 5, "shorter interval, fewer slots");
+  reconfigured.begin(0, 5);
+  check(reconfigured.getCount() == 12 && reconfigured.getSleepMs(0) == 60000 + 5 * SLOT_MS, "retained interval is kept");
+  reconfigured.setSlot(14);
+  check(other.slot == 2, "slot modulo the count");
+  reconfigured.setInterval(0);
+  check(other.intervalSec == INTERVAL_SEC && reconfigured.getCount() == 60, "0 goes back to the default");
+
+  // Neighbouring ids spread over the slots
+  uint32_t used[60] = { 0 };
+  for (uint32_t id = 0; id < 600; id++) {
+    used[CRF24Slots::slotOf(0xA4CF1200 + id, 60)]++;
+  }
+  check(*std::max_element(used, used + 60) < 25 && *std::min_element(used, used + 60) > 0, "consecutive ids spread");
+
+  // Sleep lands on the slot start, at least half an interval away
+  bool landed = true;
+  for (uint64_t clock = 0; clock < 3 * INTERVAL_MS; clock += 777) {
+    const uint32_t sleep = slots.getSleepMs(clock);
+    landed = landed && (clock + sleep) % INTERVAL_MS == 17 * SLOT_MS && sleep >= INTERVAL_MS / 2 && sleep < INTERVAL_MS * 3 / 2;
+  }
+  check(landed, "wake at the slot start");
+  check(slots.getSleepMs(17 * SLOT_MS + 2500) == INTERVAL_MS - 2500, "awake time doesn't shift the next wake");
+  const uint64_t late = 1000ULL * INTERVAL_MS * 12345 + 17 * SLOT_MS + 900; // Clock beyond 32 bit ms
+  check(slots.getSleepMs(late) == INTERVAL_MS - 900, "clock past 49 days");
+
+  check(!slots.endWake(12345) && state.slot == 17, "quiet wake keeps the slot");
+  bool moved = true;
+  for (uint32_t r = 0; r < 1000; r++) {
+    const uint8_t before = state.slot;
+    slots.reportBusy();
+    moved = moved && slots.endWake(r * 7919) && state.slot != before && state.slot < 60;
+  }
+  check(moved && state.moves == 255, "busy wake moves to another slot, moves saturate");
+}
+
+static void startWake(node_t &n, uint32_t id, event_queue_t &events, std::mt19937 &rng, uint32_t &records) {
+  std::uniform_int_distribution<int> ready(300, 1100); // Temperature and first frame
+  n.pending = SIM_BURSTS;
+  n.doneUs = n.wakeUs;
+  n.firstRecord = records;
+  records += SIM_RECORDS;
+  const int64_t first = n.wakeUs + ready(rng) * 1000LL;
+  for (uint8_t b = 0; b < SIM_BURSTS; b++) {
+    event_t e = { first + b * 1000000LL, id, b, 0 };
+    events.push(e);
+  }
+}
+
+static result_t simulate(uint32_t nodeCount, Strategy strategy, double ppm, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> drift(-ppm, ppm);
+  std::uniform_real_distribution<double> unit(0, 1);
+  event_queue_t events;
+  std::vector<node_t> nodes(nodeCount);
+  std::vector<packet_t> air;
+  uint32_t records = 0;
+  result_t result = { 0, 0, 0, 0 };
+  const int64_t endUs = static_cast<int64_t>(SIM_CYCLES) * INTERVAL_MS * 1000;
+
+  for (uint32_t i = 0; i < nodeCount; i++) {
+    node_t &n = nodes[i];
+    n.state.intervalSec = 0;
+    n.slots = new CRF24Slots(&n.state, INTERVAL_SEC, SLOT_MS);
+    n.slots->begin(rng(), -1);
+    n.rate = 1 + drift(rng) / 1e6;
+    n.wakeUs = static_cast<int64_t>(unit(rng) * BOOT_SPREAD_MS * 1000);
+    n.clockMs = 0;
+    startWake(n, i, events, rng, records);
+  }
+
+  while (!events.empty()) {
+    event_t e = events.top();
+    events.pop();
+    node_t &n = nodes[e.node];
+
+    // Listens, a packet on air during the sense time counts when loud enough
+    bool busy = false;
+    if (strategy != FIXED) {
+      for (size_t p = air.size(); p-- > 0 && air[p].start > e.at - (SIM_RECORDS + 1) * AIR_US;) {
+        if (air[p].start + AIR_US > e.at && air[p].start < e.at + SENSE_US && unit(rng) < SENSE_HEARD) {
+          busy = true;
+          break;
+        }
+      }
+    }
+    if (busy) {
+      result.busy++;
+      if (strategy == MOVE) {
+        n.slots->reportBusy();
+      }
+      if (++e.retries <= MAX_RETRIES) {
+        uint32_t backoff = static_cast<uint32_t>(BACKOFF_BASE_MS) << (e.retries - 1);
+        backoff = std::min<uint32_t>(backoff, BACKOFF_MAX_MS);
+        backoff = backoff / 2 + rng() % (backoff / 2 + 1);
+        e.at += static_cast<int64_t>(backoff) * 1000;
+        events.push(e);
+        continue;
+      }
+    } else {
+      for (uint8_t r = 0; r < SIM_RECORDS; r++) {
+        packet_t p = { e.at + SENSE_US + r * AIR_US, n.firstRecord + r, false };
+        air.push_back(p);
+      }
+    }
+    n.doneUs = std::max(n.doneUs, e.at + SENSE_US + SIM_RECORDS * AIR_US);
+    if (--n.pending > 0) {
+      continue;
+    }
+
+    // Wake over, the node's clock counts the awake time right and the sleep by its own timer
+    const int64_t awakeMs = (n.doneUs - n.wakeUs) / 1000 + 100;
+    uint32_t sleepMs = INTERVAL_MS;
+    if (strategy >= SLOTS) {
+      if (n.slots->endWake(rng())) {
+        result.moves++;
+      }
+      sleepMs = n.slots->getSleepMs(n.clockMs + awakeMs);
+    }
+    n.clockMs += awakeMs + sleepMs;
+    n.wakeUs += awakeMs * 1000 + static_cast<int64_t>(sleepMs * 1000.0 * n.rate);
+    if (n.wakeUs < endUs) {
+      startWake(n, e.node, events, rng, records);
+    }
+  }
+
+  // Overlapping packets are both lost, air is nearly sorted already
+  std::sort(air.begin(), air.end(), [](const packet_t &a, const packet_t &b) { return a.start < b.start; });
+  for (size_t p = 1; p < air.size(); p++) {
+    if (air[p].start < air[p - 1].start + AIR_US) {
+      air[p].lost = air[p - 1].lost = true;
+    }
+  }
+  std::vector<bool> delivered(records, false);
+  uint32_t packets = 0;
+  for (const packet_t &p: air) {
+    if (!p.lost) {
+      delivered[p.record] = true;
+      packets++;
+    }
+  }
+  // Records whose bursts gave up after MAX_RETRIES count as lost
+  result.records = static_cast<double>(std::count(delivered.begin(), delivered.end(), true)) / records;
+  result.packets = static_cast<double>(packets) / (static_cast<double>(records) / SIM_RECORDS * SIM_BURSTS * SIM_RECORDS);
+  for (node_t &n: nodes) {
+    delete n.slots;
+  }
+  return result;
+}
+
+static void table(double ppm) {
+  printf("\nSleep timers off by up to %.0f ppm, %u cycles, record delivery (packet delivery)\n", ppm, SIM_CYCLES);
+  printf("%6s %18s %18s %18s %18s %8s\n", "nodes", "fixed", "listen", "slots", "move", "moves");
+  const uint32_t counts[] = { 2, 4, 8, 16, 32, 48, 64, 96, 128 };
+  for (uint32_t nodes: counts) {
+    const result_t fixed = simulate(nodes, FIXED, ppm, nodes);
+    const result_t listen = simulate(nodes, LISTEN, ppm, nodes);
+    const result_t slots = simulate(nodes, SLOTS, ppm, nodes);
+    const result_t move = simulate(nodes, MOVE, ppm, nodes);
+    printf("%6u %10.2f%% (%3.0f%%) %10.2f%% (%3.0f%%) %10.2f%% (%3.0f%%) %10.2f%% (%3.0f%%) %8u\n", nodes,
+      100 * fixed.records, 100 * fixed.packets, 100 * listen.records, 100 * listen.packets, 100 * slots.records, 100 * slots.packets, 100 * move.records, 100 * move.packets, move.moves);
+    if (nodes <= 16) {
+      check(move.records >= fixed.records && move.records > 0.99, "slots deliver at least as much as fixed sleeps");
+    }
+  }
+}
+
+int main() {
+  printf("Transmit slots, %u ms interval, %u ms slots\n", INTERVAL_MS, SLOT_MS);
+  verifySlots();
+  table(20);    // Crystal, SAMD21 RTC
+  table(2000);  // RC oscillator, ESP deep sleep timer
+  return checkSummary();
+}
@@ -0,0 +1,237 @@
+// Event trace decoder and self check (env:native_trace)
+//
+//   pio run -e native_trace -t exec
+//   .pio/build/native_trace/program capture.txt
+//
+// With a file argument ("-" for stdin) decodes the EVENT_dump() output found in a serial capture,
+// other lines are skipped. Without one, records events through the firmware's EventTrace.cpp,
+// decodes its dump and checks order, overflow and formatting, then compares the cost of an
+// event with the snprintf() the log call it replaces would do. Exits non-zero when a check fails.
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+
+#include "NativeCheck.h"
+
+#include "EventTrace.h"
+
+#define BENCH_EVENTS 2000000
+
+// Collects the dump as the serial port would carry it
+class CStringPrint: public Print {
+public:
+  std::string text;
+  virtual size_t write(uint8_t c) { text += static_cast<char>(c); return 1; }
+};
+
+// Expands the %a %b %c %A %B %C placeholders of an event format
+static std::string format(const trace_event_t &e) {
+  std::string out;
+  const char *f = EVENT_format(e.id);
+  char value[16];
+  while (*f) {
+    if (f[0] != '%' || f[1] == 0) {
+      out += *f++;
+      continue;
+    }
+    switch (f[1]) {
+      case 'a': snprintf(value, sizeof(value), "%u", e.a); break;
+      case 'b': snprintf(value, sizeof(value), "%u", e.b); break;
+      case 'c': snprintf(value, sizeof(value), "%lu", static_cast<unsigned long>(e.c)); break;
+      case 'A': snprintf(value, sizeof(value), "%02x", e.a); break;
+      case 'B': snprintf(value, sizeof(value), "%04x", e.b); break;
+      case 'C': snprintf(value, sizeof(value), "%ld", static_cast<long>(static_cast<int32_t>(e.c))); break;
+      default: snprintf(value, sizeof(value), "%%%c", f[1]); break;
+    }
+    out += value;
+    f += 2;
+  }
+  return out;
+}
+
+static int hexDigit(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// Record line to event, false for any other line
+static bool parseRecord(const char *line, trace_event_t *e) {
+  const size_t prefix = strlen(EVENT_DUMP_RECORD);
+  if (strncmp(line, EVENT_DUMP_RECORD, prefix) != 0) {
+    return false;
+  }
+  uint8_t *bytes = reinterpret_cast<uint8_t*>(e);
+  line += prefix;
+  for (size_t i = 0; i < sizeof(trace_event_t); i++) {
+    const int hi = hexDigit(line[2 * i]);
+    const int lo = hi < 0 ? -1 : hexDigit(line[2 * i + 1]);
+    if (lo < 0) {
+      return false;
+    }
+    bytes[i] = static_cast<uint8_t>(hi << 4 | lo);
+  }
+  return true;
+}
+
+// Decodes every dump in the text, one line per event, times relative to the first event of a dump
+static uint32_t decode(const std::string &text, FILE *out) {
+  uint32_t events = 0;
+  uint32_t origin = 0;
+  bool first = true;
+  size_t start = 0;
+  while (start < text.size()) {
+    size_t end = text.find('\n', start);
+    if (end == std::string::npos) {
+      end = text.size();
+    }
+    const std::string line = text.substr(start, end - start);
+    start = end + 1;
+
+    unsigned count;
+    unsigned long dropped;
+    trace_event_t e;
+    if (sscanf(line.c_str(), EVENT_DUMP_HEADER " %u %lu", &count, &dropped) == 2) {
+      if (out != NULL) {
+        fprintf(out, "-- %u events%s", count, dropped > 0 ? "" : "\n");
+        if (dropped > 0) {
+          fprintf(out, ", %lu older ones overwritten\n", dropped);
+        }
+      }
+      first = true;
+    } else if (parseRecord(line.c_str(), &e)) {
+      if (first) {
+        origin = e.us;
+        first = false;
+      }
+      if (out != NULL) {
+        fprintf(out, "%10.3f ms  %-14s %s\n", (e.us - origin) / 1000.0, EVENT_name(e.id), format(e).c_str());
+      }
+      events++;
+    }
+  }
+  return events;
+}
+
+static void verify() {
+  CStringPrint empty;
+  EVENT_dump(&empty);
+  check(empty.text == EVENT_DUMP_HEADER " 0 0\r\n", "empty dump is a bare header");
+
+  // More than the ring holds, the oldest are dropped
+  const uint16_t total = EVENT_TRACE_SIZE + 36;
+  for (uint16_t i = 0; i < total; i++) {
+    TRACE_EVENT(QUEUED, i & 0xFF, 0xA057, i);
+  }
+  check(EVENT_count() == EVENT_TRACE_SIZE, "ring keeps EVENT_TRACE_SIZE events");
+  check(EVENT_dropped() == total - EVENT_TRACE_SIZE, "overwritten events are counted");
+
+  CStringPrint dump;
+  EVENT_dump(&dump);
+  check(EVENT_count() == 0 && EVENT_dropped() == 0, "dump empties the ring");
+  char header[32];
+  snprintf(header, sizeof(header), EVENT_DUMP_HEADER " %u %u\r\n", EVENT_TRACE_SIZE, total - EVENT_TRACE_SIZE);
+  check(dump.text.compare(0, strlen(header), header) == 0, "header holds count and dropped");
+  check(decode(dump.text, NULL) == EVENT_TRACE_SIZE, "every record decodes");
+
+  // Oldest first, in order, with rising timestamps
+  size_t start = dump.text.find('\n') + 1;
+  uint32_t expected = total - EVENT_TRACE_SIZE;
+  uint32_t lastUs = 0;
+  bool ordered = true;
+  trace_event_t e;
+  while (start < dump.text.size() && parseRecord(dump.text.c_str() + start, &e)) {
+    ordered = ordered && e.id == EVENT_QUEUED && e.c == expected && e.b == 0xA057 && e.us >= lastUs;
+    lastUs = e.us;
+    expected++;
+    start = dump.text.find('\n', start) + 1;
+  }
+  check(ordered && expected == total, "records come out oldest first");
+
+  // Formats and the signed argument
+  CStringPrint one;
+  TRACE_EVENT(PROBE, 1, true, -1250);
+  TRACE_EVENT(HEX_PID, 1, 0xA057, 0);
+  EVENT_dump(&one);
+  start = one.text.find('\n') + 1;
+  check(parseRecord(one.text.c_str() + start, &e) && format(e) == "probe=1 ok=1 centi_C=-1250", "signed argument decodes");
+  start = one.text.find('\n', start) + 1;
+  check(parseRecord(one.text.c_str() + start, &e) && format(e) == "pid=a057 class=1", "hex argument decodes");
+
+  // Garbage and log lines around the dump are skipped
+  check(decode("[N] Log line\r\n#EVT 12zz\r\n" + one.text + "#EVT0 x\r\n", NULL) == 2, "other lines are skipped");
+
+  // Events above the level are dropped at compile time, arguments not evaluated
+  #if EVENT_TRACE_LEVEL < LOG_LEVEL_VERBOSE
+    int evaluated = 0;
+    TRACE_EVENT(POLL, evaluated++, 0, 0);
+    check(evaluated == 0 && EVENT_count() == 0, "filtered event costs nothing");
+  #endif
+}
+
+static void bench() {
+  CStringPrint sink;
+  EVENT_dump(&sink);
+
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < BENCH_EVENTS; i++) {
+    TRACE_EVENT(FRAME, 1, 0xA057, i);
+  }
+  const double eventNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / BENCH_EVENTS;
+
+  // What the log call it replaced did before anything reached the serial port
+  char line[96];
+  volatile size_t length = 0;
+  t0 = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < BENCH_EVENTS; i++) {
+    length += snprintf(line, sizeof(line), "Preparing event for PID '%s'(%x) with %i values and sensor temp %.2fC", "0xA057", 0xA057, static_cast<int>(i & 0x1F), 21.5);
+  }
+  const double logNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / BENCH_EVENTS;
+
+  t0 = std::chrono::steady_clock::now();
+  const uint32_t dumps = BENCH_EVENTS / EVENT_TRACE_SIZE / 16;
+  for (uint32_t d = 0; d < dumps; d++) {
+    for (uint16_t i = 0; i < EVENT_TRACE_SIZE; i++) {
+      TRACE_EVENT(FRAME, 1, 0xA057, i);
+    }
+    sink.text.clear();
+    EVENT_dump(&sink);
+  }
+  const double dumpNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / (dumps * EVENT_TRACE_SIZE);
+
+  printf("\n%-28s %10s\n", "", "ns/event");
+  printf("%-28s %10.1f\n", "TRACE_EVENT", eventNs);
+  printf("%-28s %10.1f\n", "snprintf of the log line", logNs);
+  printf("%-28s %10.1f\n", "TRACE_EVENT + dump", dumpNs);
+  printf("%u bytes per event, %u in the ring, %u per dumped line\n", static_cast<unsigned>(sizeof(trace_event_t)),
+    static_cast<unsigned>(sizeof(trace_event_t) * EVENT_TRACE_SIZE), static_cast<unsigned>(strlen(EVENT_DUMP_RECORD) + 2 * sizeof(trace_event_t) + 2));
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1) {
+    FILE *in = strcmp(argv[1], "-") == 0 ? stdin : fopen(argv[1], "rb");
+    if (in == NULL) {
+      fprintf(stderr, "Can't open %s\n", argv[1]);
+      return 1;
+    }
+    std::string text;
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+      text.append(buffer, n);
+    }
+    if (in != stdin) {
+      fclose(in);
+    }
+    return decode(text, stdout) > 0 ? 0 : 1;
+  }
+
+  printf("Event trace, %u events, level %u\n", static_cast<unsigned>(EVENT_COUNT), static_cast<unsigned>(EVENT_TRACE_LEVEL));
+  verify();
+  bench();
+
+  return checkSummary();
+}
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <stdint.h>
+
+#define MANAGER_IDLE_FOREVER UINT32_MAX
+
 class CBaseManager {
 public:
   virtual void loop() {};
@@ -8,4 +12,6 @@ public:
   virtual const bool isRebootNeeded() { return false; }
   virtual const bool isJobDone() { return false; }
   virtual const bool isError() { return false; }
+  // Milliseconds until loop() has something to do again, 0 - run it now
+  virtual const uint32_t getIdleMs() { return 0; }
 };
@@ -0,0 +1,137 @@
+#include <Arduino.h>
+
+#include "Configuration.h"
+
+#ifdef BATTERY_SENSOR
+
+#include "BatterySampler.h"
+
+#if defined(SEEED_XIAO_M0)
+  #include "wiring_private.h"
+  static_assert(BATTERY_OVERSAMPLE_BITS >= 1 && BATTERY_OVERSAMPLE_BITS <= 4, "The ADC averages 4 to 256 samples");
+  // Above 16 samples the ADC shifts the sum down on its own to fit 16 bits
+  #define BATTERY_ADJRES (BATTERY_OVERSAMPLE_BITS <= 2 ? BATTERY_OVERSAMPLE_BITS : 4 - BATTERY_OVERSAMPLE_BITS)
+
+  static void syncADC() {
+    while (ADC->STATUS.bit.SYNCBUSY == 1);
+  }
+#endif
+
+#define BATTERY_FILTER_SCALE_BITS 8 // Fraction bits of the filtered value
+
+CBatterySampler::CBatterySampler(uint8_t pin)
+:pin(pin), sum(0), count(0), converting(false), filtered(0), raw(0), seeded(false), tsUpdated(0), tsNext(0) {
+}
+
+void CBatterySampler::begin() {
+  #if defined(SEEED_XIAO_M0)
+    analogReadResolution(12);
+    pinPeripheral(pin, PIO_ANALOG);
+  #else
+    pinMode(pin, INPUT);
+  #endif
+  powerUp();
+}
+
+void CBatterySampler::powerUp() {
+  #if defined(SEEED_XIAO_M0)
+    if (converting) {
+      syncADC();
+      ADC->CTRLA.bit.ENABLE = 0;
+      syncADC();
+    }
+  #endif
+  sum = 0;
+  count = 0;
+  converting = false;
+  seeded = false;
+  tsNext = millis();
+}
+
+uint32_t CBatterySampler::getIdleMs() const {
+  if (converting) {
+    return BATTERY_SAMPLE_MS;
+  }
+  const unsigned long now = millis();
+  return static_cast<long>(tsNext - now) > 0 ? tsNext - now : 0;
+}
+
+bool CBatterySampler::loop() {
+  const unsigned long now = millis();
+  #if defined(SEEED_XIAO_M0)
+    if (!converting) {
+      if (static_cast<long>(tsNext - now) > 0) {
+        return false;
+      }
+      // The whole window is one hardware averaged conversion, analogRead() would wait it out
+      syncADC();
+      ADC->INPUTCTRL.bit.MUXPOS = g_APinDescription[pin].ulADCChannelNumber;
+      ADC->AVGCTRL.reg = ADC_AVGCTRL_SAMPLENUM(2 * BATTERY_OVERSAMPLE_BITS) | ADC_AVGCTRL_ADJRES(BATTERY_ADJRES);
+      syncADC();
+      ADC->CTRLB.bit.RESSEL = ADC_CTRLB_RESSEL_16BIT_Val;
+      syncADC();
+      ADC->CTRLA.bit.ENABLE = 1;
+      syncADC();
+      ADC->INTFLAG.reg = ADC_INTFLAG_RESRDY;
+      ADC->SWTRIG.bit.START = 1;
+      converting = true;
+      count = 0; // The first result after switching the input is thrown away
+      return false;
+    }
+    if (ADC->INTFLAG.bit.RESRDY == 0) {
+      return false;
+    }
+    const uint16_t result = ADC->RESULT.reg;
+    ADC->INTFLAG.reg = ADC_INTFLAG_RESRDY;
+    if (count++ == 0) {
+      syncADC();
+      ADC->SWTRIG.bit.START = 1;
+      return false;
+    }
+    // Leave the ADC as analogRead() expects it
+    syncADC();
+    ADC->CTRLA.bit.ENABLE = 0;
+    syncADC();
+    ADC->AVGCTRL.reg = 0;
+    ADC->CTRLB.bit.RESSEL = ADC_CTRLB_RESSEL_12BIT_Val;
+    syncADC();
+    converting = false;
+    count = 0;
+    tsNext = now + BATTERY_REFRESH_MS;
+    addWindow(result);
+    return true;
+  #else
+    if (static_cast<long>(tsNext - now) > 0) {
+      return false;
+    }
+    sum += analogRead(pin);
+    if (++count < BATTERY_SAMPLES) {
+      tsNext = now + BATTERY_SAMPLE_MS;
+      return false;
+    }
+    const uint32_t decimated = sum >> BATTERY_OVERSAMPLE_BITS;
+    sum = 0;
+    count = 0;
+    tsNext = now + BATTERY_REFRESH_MS;
+    addWindow(decimated);
+    return true;
+  #endif
+}
+
+void CBatterySampler::addWindow(uint32_t decimated) {
+  raw = decimated;
+  const int32_t scaled = static_cast<int32_t>(decimated) << BATTERY_FILTER_SCALE_BITS;
+  if (!seeded) {
+    filtered = scaled;
+    seeded = true;
+  } else {
+    filtered += (scaled - filtered) / (1 << BATTERY_FILTER_SHIFT);
+  }
+  tsUpdated = millis();
+}
+
+float CBatterySampler::getReading() const {
+  return static_cast<float>(filtered) / (1UL << (BATTERY_FILTER_SCALE_BITS + BATTERY_OVERSAMPLE_BITS));
+}
+
+#endif
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+
+#define BATTERY_SAMPLES (1UL << (2 * BATTERY_OVERSAMPLE_BITS)) // 4^n samples per n extra bits
+
+// Samples the battery divider in the background of the main loop, oversampled and decimated, and
+// keeps a low-pass filtered value so reading the voltage never waits on the ADC.
+//
+// Every BATTERY_REFRESH_MS a window of BATTERY_SAMPLES samples is summed and shifted down by
+// BATTERY_OVERSAMPLE_BITS, which gains that many bits over a single reading as long as the divider
+// noise dithers it by an LSB or so, the MPPT next to it sees to that. SAMD21 sums the window in
+// the ADC itself (AVGCTRL), the loop only starts a conversion and picks up the result once it's
+// ready. Other platforms take one analogRead per loop pass, BATTERY_SAMPLE_MS apart, ESP8266 WiFi
+// doesn't like it any closer. Each decimated value goes through an exponential filter.
+class CBatterySampler {
+
+private:
+  uint8_t pin;
+  uint32_t sum;
+  uint16_t count;       // Samples in the window so far
+  bool converting;      // SAMD21, a hardware averaged conversion is running
+  int32_t filtered;     // Decimated units << BATTERY_FILTER_SCALE_BITS
+  uint16_t raw;         // Last decimated value, BATTERY_OVERSAMPLE_BITS above the ADC resolution
+  bool seeded;
+  unsigned long tsUpdated;
+  unsigned long tsNext;
+
+  void addWindow(uint32_t decimated);
+
+public:
+  CBatterySampler(uint8_t pin);
+
+  void begin();
+  // Takes the next sample when it's due, true when a window completed and the value was updated
+  bool loop();
+  // Until the next sample is due
+  uint32_t getIdleMs() const;
+  // Starts a window right away, the first one after sleep replaces the filtered value
+  void powerUp();
+
+  bool hasValue() const { return seeded; }
+  unsigned long getUpdatedMs() const { return tsUpdated; }
+  uint16_t getRaw() const { return raw; }
+  // Filtered, in ADC units of a single reading
+  float getReading() const;
+};
@@ -10,6 +10,10 @@ uint32_t CONFIG_getDeviceId() {
     }
   #elif ESP8266
     chipId = ESP.getChipId();
+  #elif SEEED_XIAO_M0
+    // 128 bit serial number of the SAMD21, folded
+    chipId = *reinterpret_cast<volatile uint32_t*>(0x0080A00C) ^ *reinterpret_cast<volatile uint32_t*>(0x0080A040)
+      ^ *reinterpret_cast<volatile uint32_t*>(0x0080A044) ^ *reinterpret_cast<volatile uint32_t*>(0x0080A048);
   #endif
 
   return chipId;
@@ -20,6 +24,64 @@ unsigned long CONFIG_getUpTime() {
   return millis() - tMillisUp;
 }
 
+#define RETAINED_MAGIC 0x5EDA7A00
+
+bool CONFIG_retainedRestore(void *data, size_t size, uint8_t block) {
+  #if defined(ESP8266)
+    uint32_t magic = 0;
+    if (!ESP.rtcUserMemoryRead(block, &magic, sizeof(magic)) || magic != (RETAINED_MAGIC ^ size)) {
+      return false; // Cold boot, RTC user memory holds garbage
+    }
+    return ESP.rtcUserMemoryRead(block + 1, static_cast<uint32_t*>(data), size);
+  #else
+    return true;
+  #endif
+}
+
+void CONFIG_retainedSave(const void *data, size_t size, uint8_t block) {
+  #if defined(ESP8266)
+    const uint32_t magic = RETAINED_MAGIC ^ size;
+    ESP.rtcUserMemoryWrite(block, const_cast<uint32_t*>(&magic), sizeof(magic));
+    ESP.rtcUserMemoryWrite(block + 1, static_cast<uint32_t*>(const_cast<void*>(data)), size);
+  #endif
+}
+
+typedef struct retained_clock_t {
+  uint32_t sec;
+  uint16_t ms;    // Kept apart from sec, so sleeps add up to the ms without wrapping after 49 days
+} retained_clock_t;
+
+static RETAINED retained_clock_t clockBase = { 0, 0 }; // Clock at the last boot or wake
+static bool clockRestored = false;
+static_assert(RETAINED_BLOCK_CLOCK + RETAINED_BLOCKS_FOR(retained_clock_t) <= RETAINED_BLOCK_SLOTS, "Clock overlaps the next retained block");
+
+uint64_t CONFIG_getClockMs() {
+  if (!clockRestored) {
+    clockRestored = true;
+    if (!CONFIG_retainedRestore(&clockBase, sizeof(clockBase), RETAINED_BLOCK_CLOCK)) {
+      clockBase.sec = 0;
+      clockBase.ms = 0;
+    }
+  }
+  return static_cast<uint64_t>(clockBase.sec) * 1000 + clockBase.ms + CONFIG_getUpTime();
+}
+
+uint32_t CONFIG_getClock() {
+  return CONFIG_getClockMs() / 1000;
+}
+
+void CONFIG_sleepClock(uint32_t ms) {
+  #if defined(SEEED_XIAO_M0)
+    CONFIG_getClockMs();
+    const uint64_t base = static_cast<uint64_t>(clockBase.sec) * 1000 + clockBase.ms + ms; // Wakes where it left off, millis() keeps the awake time
+  #else
+    const uint64_t base = CONFIG_getClockMs() + ms; // Wakes through a reset
+  #endif
+  clockBase.sec = base / 1000;
+  clockBase.ms = base % 1000;
+  CONFIG_retainedSave(&clockBase, sizeof(clockBase), RETAINED_BLOCK_CLOCK);
+}
+
 static bool isIntLEDOn = false;
 void intLEDOn() {
   #if (defined(SEEED_XIAO_M0) || defined(ESP8266))
@@ -21,12 +21,77 @@
 
 #define RADIO_RF24
 #ifdef RADIO_RF24
-  #define MSGS_TO_TRANSMIT_BEFORE_DONE  4 // Number of messages to transmit before declaring job done
+  #define MSGS_TO_TRANSMIT_BEFORE_DONE  4 // Number of messages to transmit before declaring job done, without RF24_ACK_MODE
   #define RF24_CHANNEL 76
   #define RF24_DATA_RATE RF24_250KBPS
   #define RF24_PA_LEVEL RF24_PA_HIGH
   #define RF24_ADDRESS "3STUS" // MPPT charger
   //#define RF24_ADDRESS "4STUS" // Battery monitor
+  #define RF24_BURST_SIZE 3 // Messages queued into the 3 level TX FIFO back to back, 1 - one blocking write per message
+  #define RF24_BURST_GAP_MS 0 // Pause between bursts, for receivers that can't drain their RX FIFO in time
+  #define RF24_BACKOFF_BASE_MS 100 // First retry after a failed burst, doubles with every further attempt
+  #define RF24_BACKOFF_MAX_MS 5000
+  //#define RF24_TX_SLOTS // Wake in a slot of the sleep interval of its own instead of a fixed time after the last wake, see RF24Slots.h
+  #ifdef RF24_TX_SLOTS
+    #define RF24_SLOT_MS 5000 // The awake time plus a guard for the drift between node timers, 60 slots in 5 min
+    //#define RF24_SLOT 7 // Fixed slot instead of one derived from the device id
+    #define RF24_CARRIER_SENSE_US 200 // Listening before each burst, a busy channel counts as a failed attempt
+  #endif
+  //#define RF24_PARITY // Follow every burst with the XOR of its payloads, the receiver rebuilds any one lost from it (RF24Parity.h), without RF24_ACK_MODE
+  //#define RF24_ACK_MODE // Each record is sent until the gateway acknowledges it, and ACK payloads carry commands (RF24Command.h), the gateway has to run in this mode too
+  #ifdef RF24_ACK_MODE
+    #define RF24_ACK_DELAY 5 // Auto retransmit delay in steps of 250 us, 1500 us fits the longest ACK payload at 250 kbps
+    #define RF24_ACK_RETRIES 15 // Auto retransmits of a packet before the write fails and the node backs off
+    #define RF24_ACK_QUIET_MS 1500 // Done once everything was acknowledged and no new device showed up for this long, a TEXT frame comes every second
+  #endif
+#endif
+
+// Receiver build, STUS_GATEWAY is set by the *_gateway environments
+#ifdef STUS_GATEWAY
+  #define GATEWAY_ADDRESSES { "3STUS", "4STUS" } // Up to 5 node addresses that differ in the first character only
+  #define GATEWAY_DEDUPE_MS 10000 // Repeated sends of a payload within this window are dropped
+  #define GATEWAY_SERIAL_BAUD 921600
+  #ifdef RF24_ACK_MODE
+    #define GATEWAY_COMMAND_SEC 900 // Commands read from serial go out with the ACKs of their pipe for this long
+  #endif
+#endif
+
+#define VED_RX_BUFFER_SIZE 1024 // Bytes buffered between the VE.Direct UART and the parser, power of two, several TEXT frames
+//#define VED_HEX_QUERY_ON_WAKE // Read the needed registers over VE.Direct HEX right after wake instead of waiting for a TEXT frame
+
+//#define VED_PACKED_PAYLOAD // Pack several device snapshots per radio frame (VEDirectPacked.h), the receiver has to support it
+//#define VED_AGGREGATE // Send min/mean/max of V, I, P and the integrated Wh/Ah per device (VEDirectAggregate.h), the receiver has to support it
+#ifdef VED_AGGREGATE
+  #define VED_AGGREGATE_WINDOW_MS 3000 // Shortest window reported, within one awake period. With RF24_ACK_MODE a wake lasts until each device sent one
+#endif
+//#define VED_LOG // Keep what the radio could not deliver across sleep and resend it once the link is back, see VEDirectLog.h, the receiver has to support it
+#ifdef VED_LOG
+  #define VED_LOG_DRAIN_PER_WAKE 6 // Backlog messages sent per wake on top of the current data, markers included
+  #if defined(ESP32)
+    #define VED_LOG_SIZE 2048 // RTC slow memory
+    #define VED_LOG_SECTOR_SIZE 256
+  #elif defined(ESP8266)
+    // The rest of the RTC user memory. A sector holds one record of up to 42 bytes and the one
+    // ahead of the head is kept erased, so only the last 2 undelivered payloads survive here.
+    #define VED_LOG_SIZE 132
+    #define VED_LOG_SECTOR_SIZE 44
+  #else
+    #define VED_LOG_SIZE 4096 // Program flash, 16 rows
+  #endif
+#endif
+//#define VED_REGISTRY_STORE // Keep PIDs added at runtime in EEPROM (ESP) or a flash row (XIAO), see VEDirectRegistry.h
+//#define VED_REGISTRY_LEARN // Add unknown PIDs whose frames look like a supported device class
+#ifdef VED_REGISTRY_STORE
+  #define VED_REGISTRY_EEPROM_ADDRESS 0
+#endif
+#define VED_DEADBAND_FILTER // Only transmit records that changed, see VEDirectDeadband.h
+#ifdef VED_DEADBAND_FILTER
+  #define VED_DEADBAND_MV 50
+  #define VED_DEADBAND_MA 100
+  #define VED_DEADBAND_MAH 100
+  #define VED_DEADBAND_PERMILLE 10
+  #define VED_DEADBAND_W 5
+  #define VED_DEADBAND_HEARTBEAT_SEC 1800 // Send unchanged records at least every 30 min
 #endif
 
 //#define BATTERY_SENSOR  // ADC A0 using 0-3.3v voltage divider
@@ -41,15 +106,27 @@
   #else
     #define BATTERY_SENSOR_ADC_PIN  0
   #endif
+  #define BATTERY_OVERSAMPLE_BITS 2 // 16 samples per reading for 2 more bits, see BatterySampler.h
+  #define BATTERY_SAMPLE_MS 5 // Between samples of a window without hardware averaging
+  #define BATTERY_REFRESH_MS 1000 // Between windows
+  #define BATTERY_FILTER_SHIFT 2 // Each window moves the filtered value 1/4 of the way
 
 #endif
 
 #define TEMP_SENSOR_DS18B20
 //#define TEMP_SENSOR_BME280
 //#define TEMP_SENSOR_DHT
+#ifdef TEMP_SENSOR_DS18B20
+  #define TEMP_SENSOR_RESOLUTION 12 // 9-12 bits, conversion takes 94, 188, 375 or 750 ms
+  // Probe index, in ROM address order, for the chassis of each VE.Direct PID. Others use probe 0.
+  //#define TEMP_PROBE_PIDS { { 0xA057, 0 }, { 0xA2FA, 1 }, { 0xA389, 2 } }
+#endif
 #ifdef TEMP_SENSOR_DHT
   #define TEMP_SENSOR_DHT_TYPE   DHT22
 #endif
+#if defined(TEMP_SENSOR_DS18B20) || defined(TEMP_SENSOR_BME280) || defined(TEMP_SENSOR_DHT)
+  #define TEMP_SENSOR_WAIT_MS 1000 // Decoded frames wait this long after wake for a first reading, then go out without one
+#endif
 #ifdef TEMP_SENSOR_BME280
   #define BME_SEALEVELPRESSURE_HPA (1013.25)
   #define BME_I2C_ID 0x76
@@ -66,12 +143,50 @@
 
 #define DEEP_SLEEP_INTERVAL_SEC 300 // 5 min default, 0 - disabled
 #define DEEP_SLEEP_MIN_AWAKE_MS 500 // Minimum time to remain awake after smooth boot before sleeping again
+#if defined(ESP32)
+  #define DEEP_SLEEP_MAX_SEC 4294 // ESP.deepSleep() takes uint32_t microseconds
+#elif defined(ESP8266)
+  #define DEEP_SLEEP_MAX_SEC 10800 // ESP.deepSleepMax() is about 3.5 h, less on some chips
+#else
+  #define DEEP_SLEEP_MAX_SEC 65535 // The retained interval is 16 bit seconds
+#endif
 #define BATTERY_VOLTS_DIVIDER 217.55
 
 #define INTERNAL_LED_PIN LED_BUILTIN
 
+// Data that has to survive deep sleep. ESP32 keeps it in RTC slow memory and SAMD standby keeps
+// all of RAM, ESP8266 has no such section and copies it to RTC user memory (CONFIG_retained*).
+#if defined(ESP32)
+  #define RETAINED RTC_DATA_ATTR
+#else
+  #define RETAINED
+#endif
+// RTC user memory offsets in 4 byte blocks, a magic word followed by the data
+#define RETAINED_BLOCK_CLOCK     0
+#define RETAINED_BLOCK_SLOTS     3
+#define RETAINED_BLOCK_DEADBAND  5
+#define RETAINED_BLOCK_TRACE     61
+#define RETAINED_BLOCK_PROBES    84
+#define RETAINED_BLOCK_LOG       94
+#define RETAINED_BLOCKS          128
+#define RETAINED_BLOCKS_FOR(type) (1 + (sizeof(type) + 3) / 4)
+
+//#define PHASE_TRACE_MESSAGE // Send the wake cycle phase timing (PhaseTrace.h) once per wake
+#ifndef EVENT_TRACE_LEVEL
+  #define EVENT_TRACE_LEVEL LOG_LEVEL_SILENT // Record hot path events up to this level (EventTrace.h) and dump them over serial before sleep
+#endif
+#define EVENT_TRACE_SIZE 64 // Records kept between dumps, power of two, 12 bytes each
+
 uint32_t CONFIG_getDeviceId();
 unsigned long CONFIG_getUpTime();
+// Seconds since power on including time spent in deep sleep
+uint32_t CONFIG_getClock();
+uint64_t CONFIG_getClockMs();
+// Accounts for the deep sleep about to start
+void CONFIG_sleepClock(uint32_t ms);
+
+bool CONFIG_retainedRestore(void *data, size_t size, uint8_t block);
+void CONFIG_retainedSave(const void *data, size_t size, uint8_t block);
 
 void intLEDOn();
 void intLEDOff();
@@ -0,0 +1,80 @@
+#include <Arduino.h>
+#include <OneWire.h>
+
+#include "DS18B20Bus.h"
+
+#define DS18B20_CMD_CONVERT 0x44
+#define DS18B20_CMD_WRITE_SCRATCHPAD 0x4E
+#define DS18B20_CMD_READ_SCRATCHPAD 0xBE
+
+CDS18B20Bus::CDS18B20Bus(OneWire *oneWire, ds18b20_roms_t *roms)
+:oneWire(oneWire), roms(roms), resolution(12) {
+  for (uint8_t i = 0; i < DS18B20_MAX_PROBES; i++) {
+    temperature[i] = 0;
+    valid[i] = false;
+  }
+}
+
+uint8_t CDS18B20Bus::begin(uint8_t resolution) {
+  this->resolution = resolution;
+  if (roms->count > 0 && roms->count <= DS18B20_MAX_PROBES) {
+    return roms->count; // Warm wake, the probes kept their configuration too
+  }
+
+  roms->count = 0;
+  uint8_t rom[8];
+  oneWire->reset_search();
+  while (roms->count < DS18B20_MAX_PROBES && oneWire->search(rom)) {
+    if (rom[0] != DS18B20_FAMILY || OneWire::crc8(rom, 7) != rom[7]) {
+      continue;
+    }
+    // Insertion sort, so probe indexes stay put as long as the same probes are attached
+    uint8_t i = roms->count++;
+    while (i > 0 && memcmp(roms->rom[i - 1], rom, 8) > 0) {
+      memcpy(roms->rom[i], roms->rom[i - 1], 8);
+      i--;
+    }
+    memcpy(roms->rom[i], rom, 8);
+  }
+
+  // Alarm thresholds unused, resolution in bits 5-6 of the configuration register
+  oneWire->reset();
+  oneWire->skip();
+  oneWire->write(DS18B20_CMD_WRITE_SCRATCHPAD);
+  oneWire->write(0);
+  oneWire->write(0);
+  oneWire->write(((resolution - 9) << 5) | 0x1F);
+  return roms->count;
+}
+
+void CDS18B20Bus::requestConversion() {
+  oneWire->reset();
+  oneWire->skip();
+  oneWire->write(DS18B20_CMD_CONVERT);
+}
+
+bool CDS18B20Bus::isConversionComplete() {
+  return oneWire->read_bit() == 1;
+}
+
+bool CDS18B20Bus::read(uint8_t index) {
+  if (index >= roms->count) {
+    return false;
+  }
+  uint8_t scratchpad[9];
+  valid[index] = false;
+  if (!oneWire->reset()) {
+    return false;
+  }
+  oneWire->select(roms->rom[index]);
+  oneWire->write(DS18B20_CMD_READ_SCRATCHPAD);
+  oneWire->read_bytes(scratchpad, sizeof(scratchpad));
+  if (OneWire::crc8(scratchpad, 8) != scratchpad[8]) {
+    return false;
+  }
+  // Undefined low bits below 12 bit resolution
+  const int16_t raw = static_cast<int16_t>(scratchpad[1] << 8 | scratchpad[0]) & ~((1 << (12 - resolution)) - 1);
+  temperature[index] = raw / 16.0f;
+  valid[index] = true;
+  return true;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <OneWire.h>
+
+#define DS18B20_MAX_PROBES 4
+#define DS18B20_FAMILY 0x28
+
+// ROM addresses found on the bus, kept across deep sleep so a warm wake skips the search
+typedef struct ds18b20_roms_t {
+  uint8_t count;
+  uint8_t rom[DS18B20_MAX_PROBES][8];
+} ds18b20_roms_t;
+
+// Several DS18B20 probes on one 1-Wire bus. A single skip ROM command starts the conversion of
+// all of them at once, the scratchpads are then read one probe at a time.
+class CDS18B20Bus {
+
+private:
+  OneWire *oneWire;
+  ds18b20_roms_t *roms;
+  uint8_t resolution;
+  float temperature[DS18B20_MAX_PROBES];
+  bool valid[DS18B20_MAX_PROBES];
+
+public:
+  CDS18B20Bus(OneWire *oneWire, ds18b20_roms_t *roms);
+
+  // Enumerates the probes in ROM order unless roms already holds them, returns how many
+  uint8_t begin(uint8_t resolution);
+  // Broadcasts Convert T to every probe
+  void requestConversion();
+  // The bus reads 1 once the slowest probe finished, needs externally powered probes
+  bool isConversionComplete();
+  // Reads the scratchpad of one probe, false on a missing probe or CRC error
+  bool read(uint8_t index);
+  // Makes the next begin() search the bus again
+  void forget() { roms->count = 0; }
+
+  uint8_t getCount() const { return roms->count; }
+  const uint8_t* getAddress(uint8_t index) const { return roms->rom[index]; }
+  float getTemperature(uint8_t index) const { return temperature[index]; }
+  bool isValid(uint8_t index) const { return index < roms->count && valid[index]; }
+};
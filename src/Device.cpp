@@ -3,9 +3,15 @@
 #include <ArduinoLog.h>
 
 #include "Device.h"
+#include "EventTrace.h"
 
 #include <Wire.h>
 
+#ifdef TEMP_SENSOR_DS18B20
+  static RETAINED ds18b20_roms_t probeRoms;
+  static_assert(RETAINED_BLOCK_PROBES + RETAINED_BLOCKS_FOR(ds18b20_roms_t) <= RETAINED_BLOCK_LOG, "Probe addresses overlap the next retained block");
+#endif
+
 CDevice::CDevice() {
 
   tMillisUp = millis();
@@ -13,29 +19,38 @@ CDevice::CDevice() {
   sensorReady = false;
 
   tLastReading = 0;
+  tsNextPoll = 0;
+  hasReading = false;
 #ifdef TEMP_SENSOR_DS18B20
   pinMode(TEMP_SENSOR_PIN, INPUT);
   oneWire = new OneWire(TEMP_SENSOR_PIN);
-  DeviceAddress da;
-  ds18b20 = new DS18B20(oneWire);
-  ds18b20->setConfig(DS18B20_CRC);
-  ds18b20->begin();
-
-  ds18b20->getAddress(da);
-  String addr = "";
-  for (uint8_t i = 0; i < 8; i++) {
-    if (da[i] < 16) {
-      addr += String("o");
+  if (!CONFIG_retainedRestore(&probeRoms, sizeof(probeRoms), RETAINED_BLOCK_PROBES)) {
+    probeRoms.count = 0;
+  }
+  const bool warm = probeRoms.count > 0;
+  bus = new CDS18B20Bus(oneWire, &probeRoms);
+  bus->begin(TEMP_SENSOR_RESOLUTION);
+  bus->requestConversion(); // All probes at once
+  probeRead = bus->getCount();
+  readFailed = false;
+  CONFIG_retainedSave(&probeRoms, sizeof(probeRoms), RETAINED_BLOCK_PROBES);
+
+  for (uint8_t p = 0; p < bus->getCount(); p++) {
+    String addr = "";
+    for (uint8_t i = 0; i < 8; i++) {
+      if (bus->getAddress(p)[i] < 16) {
+        addr += String("0");
+      }
+      addr += String(bus->getAddress(p)[i], HEX);
     }
-    addr += String(da[i], HEX);
+    Log.noticeln(F("DS18B20 probe %i at address: %s%s"), p, addr.c_str(), warm ? " (retained)" : "");
+  }
+  if (bus->getCount() == 0) {
+    Log.warningln(F("No DS18B20 probe found"));
   }
-  Log.noticeln(F("DS18B20 sensor at address: %s"), addr.c_str());
-  
-  ds18b20->setResolution(12);
-  ds18b20->requestTemperatures();
 
   sensorReady = true;
-  tMillisTemp = 0;
+  tMillisTemp = millis();
 #endif
 #ifdef TEMP_SENSOR_BME280
   _bme = new Adafruit_BME280();
@@ -63,10 +78,8 @@ CDevice::CDevice() {
   Log.noticeln(F("DHT sensor min delay %i"), minDelayMs);
 #endif
 #ifdef BATTERY_SENSOR
-  #if SEEED_XIAO_M0
-    analogReadResolution(12);
-  #endif
-  pinMode(BATTERY_SENSOR_ADC_PIN, INPUT);
+  battery = new CBatterySampler(BATTERY_SENSOR_ADC_PIN);
+  battery->begin();
 #endif
 
   Log.infoln(F("Device initialized"));
@@ -74,39 +87,113 @@ CDevice::CDevice() {
 
 CDevice::~CDevice() { 
 #ifdef TEMP_SENSOR_DS18B20
-  delete ds18b20;
+  delete bus;
+  delete oneWire;
 #endif
 #ifdef TEMP_SENSOR_BME280
   delete _bme;
 #endif
 #ifdef TEMP_SENSOR_DHT
   delete _dht;
+#endif
+#ifdef BATTERY_SENSOR
+  delete battery;
 #endif
   Log.noticeln(F("Device destroyed"));
 }
 
+uint32_t CDevice::getReadingDelay() {
+  #if defined(TEMP_SENSOR_DHT)
+    return minDelayMs;
+  #elif defined(TEMP_SENSOR_DS18B20)
+    return DS18B20_CONVERSION_MS - SENSOR_POLL_MS; // Polled from just before the conversion should end
+  #else
+    return 500;
+  #endif
+}
+
+const uint32_t CDevice::getIdleMs() {
+  const unsigned long now = millis();
+  const uint32_t elapsed = now - tMillisTemp;
+  uint32_t idle;
+  if (elapsed <= getReadingDelay()) {
+    idle = getReadingDelay() - elapsed + 1;
+  } else {
+    idle = static_cast<long>(tsNextPoll - now) > 0 ? tsNextPoll - now : 0;
+  }
+  #ifdef BATTERY_SENSOR
+    if (battery->getIdleMs() < idle) {
+      idle = battery->getIdleMs();
+    }
+  #endif
+  return idle;
+}
+
+void CDevice::powerDown() {
+  #ifdef TEMP_SENSOR_DS18B20
+    if (readFailed) {
+      // Search the bus again on the next wake, a probe may have been replaced
+      bus->forget();
+      CONFIG_retainedSave(&probeRoms, sizeof(probeRoms), RETAINED_BLOCK_PROBES);
+    }
+  #endif
+}
+
+void CDevice::powerUp() {
+  hasReading = false;
+  tMillisTemp = millis();
+  tsNextPoll = 0;
+  #ifdef BATTERY_SENSOR
+    battery->powerUp();
+  #endif
+  #ifdef TEMP_SENSOR_DS18B20
+    if (bus->getCount() == 0) {
+      bus->begin(TEMP_SENSOR_RESOLUTION);
+    }
+    readFailed = false;
+    bus->requestConversion();
+    probeRead = bus->getCount();
+  #endif
+}
+
 void CDevice::loop() {
 
-  uint32_t delay = 500;
-  #ifdef TEMP_SENSOR_DHT
-    delay = minDelayMs;
+  #ifdef BATTERY_SENSOR
+    if (battery->loop()) {
+      TRACE_EVENT(BATTERY, 0, battery->getRaw(), static_cast<uint32_t>(battery->getReading() / BATTERY_VOLTS_DIVIDER * 1000));
+    }
   #endif
 
+  const uint32_t delay = getReadingDelay();
+
   if (!sensorReady && millis() - tMillisTemp > delay) {
     sensorReady = true;
   }
 
   if (sensorReady && millis() - tMillisTemp > delay) {
     #ifdef TEMP_SENSOR_DS18B20
-      if (ds18b20->isConversionComplete()) {
-        _temperature = ds18b20->getTempC();
-        ds18b20->setResolution(12);
-        ds18b20->requestTemperatures();
-        tLastReading = millis();
-        Log.traceln(F("DS18B20 temp: %FC %FF"), _temperature, _temperature*1.8+32);
-        tMillisTemp = millis();
+      if (bus->getCount() == 0) {
+        tMillisTemp = millis(); // No probe, nothing to wait for
+      } else if (probeRead < bus->getCount()) {
+        // One scratchpad per pass, reading every probe at once would hold up the main loop
+        const bool ok = bus->read(probeRead);
+        TRACE_EVENT(PROBE, probeRead, ok, static_cast<int32_t>(bus->getTemperature(probeRead) * 100));
+        if (!ok) {
+          Log.warningln(F("DS18B20 probe %i read failed"), probeRead);
+          readFailed = true;
+        }
+        if (++probeRead == bus->getCount()) {
+          tLastReading = millis();
+          hasReading = true;
+          bus->requestConversion();
+          tMillisTemp = millis();
+        }
+        tsNextPoll = 0;
+      } else if (bus->isConversionComplete()) {
+        probeRead = 0;
+        tsNextPoll = 0;
       } else {
-        //Log.infoln(F("DS18B20 conversion not complete"));
+        tsNextPoll = millis() + SENSOR_POLL_MS;
       }
     #endif
     #ifdef TEMP_SENSOR_BME280
@@ -114,6 +201,8 @@ void CDevice::loop() {
       _humidity = _bme->readHumidity();
       _baro_pressure = _bme->readPressure();
       tLastReading = millis();
+      hasReading = true;
+      tsNextPoll = millis() + delay;
     #endif
     #ifdef TEMP_SENSOR_DHT
       if (millis() - tLastReading > minDelayMs) {
@@ -126,6 +215,7 @@ void CDevice::loop() {
           goodRead = false;
         } else {
           _temperature = event.temperature;
+          hasReading = true;
           Log.noticeln(F("DHT temp: %FC %FF"), _temperature, _temperature*1.8+32);
         }
         // humidity
@@ -141,6 +231,7 @@ void CDevice::loop() {
         
         tLastReading = millis();
       }
+      tsNextPoll = tLastReading + minDelayMs + 1;
     #endif
   }
 
@@ -148,17 +239,30 @@ void CDevice::loop() {
 
 #if defined(TEMP_SENSOR_DS18B20) || defined(TEMP_SENSOR_DHT) || defined(TEMP_SENSOR_BME280)
 float CDevice::getTemperature(bool *current) {
+  #ifdef TEMP_SENSOR_DS18B20
+    return getTemperature(static_cast<uint8_t>(0), current);
+  #else
+    if (current != NULL) { 
+      *current = hasReading && millis() - tLastReading < STALE_READING_AGE_MS; 
+    }
+    return _temperature;
+  #endif
+}
+#endif
+
+#ifdef TEMP_SENSOR_DS18B20
+float CDevice::getTemperature(uint8_t index, bool *current) {
   if (current != NULL) { 
-    *current = millis() - tLastReading < STALE_READING_AGE_MS; 
+    *current = hasReading && bus->isValid(index) && millis() - tLastReading < STALE_READING_AGE_MS; 
   }
-  return _temperature;
+  return bus->getTemperature(index < DS18B20_MAX_PROBES ? index : 0);
 }
 #endif
 
 #if defined(TEMP_SENSOR_DHT) || defined(TEMP_SENSOR_BME280)
 float CDevice::getHumidity(bool *current) {
   if (current != NULL) { 
-    *current = millis() - tLastReading < STALE_READING_AGE_MS; 
+    *current = hasReading && millis() - tLastReading < STALE_READING_AGE_MS; 
   }
   return _humidity;
 }
@@ -167,19 +271,19 @@ float CDevice::getHumidity(bool *current) {
 #if defined(TEMP_SENSOR_BME280)
 float CDevice::getBaroPressure(bool *current) {
   if (current != NULL) { 
-    *current = millis() - tLastReading < STALE_READING_AGE_MS; 
+    *current = hasReading && millis() - tLastReading < STALE_READING_AGE_MS; 
   }
   return _baro_pressure;
 }
 #endif
 
 #ifdef BATTERY_SENSOR
-float CDevice::getBatteryVoltage(bool *current) {  
-  if (current != NULL) { *current = true; } 
-  int vi = analogRead(BATTERY_SENSOR_ADC_PIN);
-  float v = (float)vi/BATTERY_VOLTS_DIVIDER;
-  Log.verboseln(F("Battery voltage raw: %i volts: %D"), vi, v);
-  return v; 
+float CDevice::getBatteryVoltage(bool *current) {
+  // Sampled in loop(), this only reads the filtered value
+  if (current != NULL) {
+    *current = battery->hasValue() && millis() - battery->getUpdatedMs() < STALE_READING_AGE_MS;
+  }
+  return battery->getReading() / BATTERY_VOLTS_DIVIDER;
 }
 #endif
 
@@ -3,10 +3,11 @@
 #include <functional>
 #include "Configuration.h"
 #include "SensorProvider.h"
+#include "BaseManager.h"
 
 #ifdef TEMP_SENSOR_DS18B20
   #include <OneWire.h>
-  #include <DS18B20.h>
+  #include "DS18B20Bus.h"
 #endif
 #ifdef TEMP_SENSOR_BME280
   #include <Adafruit_Sensor.h>
@@ -16,21 +17,38 @@
   #include <DHT.h>
   #include <DHT_U.h>
 #endif
+#ifdef BATTERY_SENSOR
+  #include "BatterySampler.h"
+#endif
 
 #define STALE_READING_AGE_MS 10000 // 10 sec
+#define SENSOR_POLL_MS 10 // Between checks for a finished conversion
+#ifdef TEMP_SENSOR_DS18B20
+  #define DS18B20_CONVERSION_MS (750 >> (12 - TEMP_SENSOR_RESOLUTION))
+#endif
 
-class CDevice: public ISensorProvider {
+class CDevice: public CBaseManager, public ISensorProvider {
 
 public:
 	CDevice();
   ~CDevice();
-  void loop();
+  // CBaseManager
+  virtual void loop();
+  virtual const uint32_t getIdleMs();
+  // Before sleep, forgets the probe addresses if a probe failed
+  virtual void powerDown();
+  // Starts a new conversion, the reading from before sleep no longer counts
+  virtual void powerUp();
 
   virtual bool isSensorReady() { return sensorReady; };
 
 #if defined(TEMP_SENSOR_DS18B20) || defined(TEMP_SENSOR_DHT) || defined(TEMP_SENSOR_BME280)
   virtual float getTemperature(bool *current);
 #endif
+#ifdef TEMP_SENSOR_DS18B20
+  virtual uint8_t getTemperatureCount() { return bus->getCount() > 0 ? bus->getCount() : 1; }
+  virtual float getTemperature(uint8_t index, bool *current);
+#endif
 #if defined(TEMP_SENSOR_BME280) || defined(TEMP_SENSOR_DHT) || defined(TEMP_SENSOR_BME280)
   virtual float getHumidity(bool *current);
 #endif
@@ -44,14 +62,20 @@ public:
 private:
   unsigned long tMillisUp;
 
+  uint32_t getReadingDelay();
+
   unsigned long tMillisTemp;
   unsigned long tLastReading;
+  unsigned long tsNextPoll;
   bool sensorReady;
+  bool hasReading;
   
   float _temperature;
 #ifdef TEMP_SENSOR_DS18B20
   OneWire *oneWire;
-  DS18B20 *ds18b20;
+  CDS18B20Bus *bus;
+  uint8_t probeRead;  // Next scratchpad to read after a conversion, count while converting
+  bool readFailed;
 #endif
 #ifdef TEMP_SENSOR_BME280
   float _humidity, _baro_pressure;
@@ -62,5 +86,8 @@ private:
   DHT_Unified *_dht;
   unsigned long minDelayMs;
 #endif
+#ifdef BATTERY_SENSOR
+  CBatterySampler *battery;
+#endif
 
 };
\ No newline at end of file
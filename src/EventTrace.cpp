@@ -0,0 +1,90 @@
+#include <Arduino.h>
+#include <stdio.h>
+
+#include "EventTrace.h"
+
+static_assert(sizeof(trace_event_t) == 12, "Dump format assumes 12 byte records");
+
+#define EVENT_TRACE_NAME(name, level, format) #name,
+static const char* const eventNames[EVENT_COUNT] = {
+  EVENT_TRACE_EVENTS(EVENT_TRACE_NAME)
+};
+#undef EVENT_TRACE_NAME
+
+#define EVENT_TRACE_FORMAT(name, level, format) format,
+static const char* const eventFormats[EVENT_COUNT] = {
+  EVENT_TRACE_EVENTS(EVENT_TRACE_FORMAT)
+};
+#undef EVENT_TRACE_FORMAT
+
+#if EVENT_TRACE_LEVEL > LOG_LEVEL_SILENT
+
+static_assert((EVENT_TRACE_SIZE & (EVENT_TRACE_SIZE - 1)) == 0, "EVENT_TRACE_SIZE has to be a power of two");
+
+static trace_event_t events[EVENT_TRACE_SIZE];
+static uint16_t eventNext = 0;
+static uint16_t eventCount = 0;   // Since the last dump, the ring keeps the newest
+static uint32_t eventDropped = 0;
+
+void EVENT_record(uint8_t id, uint8_t a, uint16_t b, uint32_t c) {
+  trace_event_t &e = events[eventNext];
+  e.us = micros();
+  e.id = id;
+  e.a = a;
+  e.b = b;
+  e.c = c;
+  eventNext = (eventNext + 1) & (EVENT_TRACE_SIZE - 1);
+  if (eventCount < EVENT_TRACE_SIZE) {
+    eventCount++;
+  } else {
+    eventDropped++;
+  }
+}
+
+uint16_t EVENT_count() {
+  return eventCount;
+}
+
+uint32_t EVENT_dropped() {
+  return eventDropped;
+}
+
+void EVENT_dump(Print *out) {
+  static const char hex[] = "0123456789abcdef";
+  char line[sizeof(EVENT_DUMP_RECORD) + 2 * sizeof(trace_event_t) + 2];
+  const int n = snprintf(line, sizeof(line), EVENT_DUMP_HEADER " %u %lu\r\n", eventCount, static_cast<unsigned long>(eventDropped));
+  out->write(reinterpret_cast<const uint8_t*>(line), n);
+
+  memcpy(line, EVENT_DUMP_RECORD, sizeof(EVENT_DUMP_RECORD) - 1);
+  for (uint16_t i = 0; i < eventCount; i++) {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t*>(&events[(eventNext - eventCount + i) & (EVENT_TRACE_SIZE - 1)]);
+    char *p = line + sizeof(EVENT_DUMP_RECORD) - 1;
+    for (uint8_t b = 0; b < sizeof(trace_event_t); b++) {
+      *p++ = hex[bytes[b] >> 4];
+      *p++ = hex[bytes[b] & 0x0F];
+    }
+    *p++ = '\r';
+    *p++ = '\n';
+    out->write(reinterpret_cast<const uint8_t*>(line), p - line);
+  }
+  eventCount = 0;
+  eventDropped = 0;
+}
+
+#else
+
+// Every event is filtered out, kept for builds without optimization that still reference it
+void EVENT_record(uint8_t id, uint8_t a, uint16_t b, uint32_t c) {}
+void EVENT_dump(Print *out) {}
+uint16_t EVENT_count() { return 0; }
+uint32_t EVENT_dropped() { return 0; }
+
+#endif
+
+const char* EVENT_name(uint8_t id) {
+  return id < EVENT_COUNT ? eventNames[id] : "?";
+}
+
+const char* EVENT_format(uint8_t id) {
+  return id < EVENT_COUNT ? eventFormats[id] : "";
+}
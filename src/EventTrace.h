@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "Configuration.h"
+
+// Binary event trace for the hot paths, in place of formatted log calls.
+//
+// TRACE_EVENT() stores a fixed size record with the event id, micros() and up to three integer
+// arguments into a RAM ring, nothing is formatted on the node. Events above EVENT_TRACE_LEVEL
+// are removed at compile time together with their argument expressions. EVENT_dump() writes the
+// ring as text lines that can share the serial port with the log:
+//
+//   #EVT0 <records> <dropped>     header, version 0, dropped records were overwritten
+//   #EVT <24 hex digits>          one record, the bytes of trace_event_t in memory order
+//
+// native/trace decodes a captured dump with the formats below. Format placeholders: %a %b %c
+// the arguments in decimal, %A %B hex, %C the third one signed.
+//
+// Records are written from the main loop only, not from interrupts.
+
+#define EVENT_TRACE_EVENTS(X) \
+  X(FRAME,          LOG_LEVEL_TRACE,   "pid=%B class=%a values=%c") \
+  X(SUPPLEMENTAL,   LOG_LEVEL_TRACE,   "pid=%B values=%c") \
+  X(HEX_PID,        LOG_LEVEL_TRACE,   "pid=%B class=%a") \
+  X(HEX_REGISTER,   LOG_LEVEL_TRACE,   "reg=%B failed status=%a") \
+  X(HEX_SNAPSHOT,   LOG_LEVEL_TRACE,   "pid=%B registers=%c") \
+  X(QUEUED,         LOG_LEVEL_TRACE,   "pid=%B pending=%a coalesced=%c") \
+  X(SUPPRESSED,     LOG_LEVEL_TRACE,   "pid=%B class=%a") \
+  X(MESSAGE,        LOG_LEVEL_TRACE,   "pid=%B class=%a") \
+  X(PACKED,         LOG_LEVEL_TRACE,   "records=%a bytes=%c") \
+  X(POLL,           LOG_LEVEL_VERBOSE, "id=%A length=%c") \
+  X(TX,             LOG_LEVEL_NOTICE,  "messages=%a total=%b us=%c") \
+  X(TX_RETRY,       LOG_LEVEL_NOTICE,  "attempt=%a backoff_ms=%c") \
+  X(TX_FAIL,        LOG_LEVEL_WARNING, "retries=%a") \
+  X(TX_BUSY,        LOG_LEVEL_NOTICE,  "slot=%a attempt=%b") \
+  X(SLOT,           LOG_LEVEL_NOTICE,  "slot=%a moves=%b sleep_ms=%c") \
+  X(PROBE,          LOG_LEVEL_TRACE,   "probe=%a ok=%b centi_C=%C") \
+  X(BATTERY,        LOG_LEVEL_VERBOSE, "raw=%b mV=%c") \
+  X(COMMAND,        LOG_LEVEL_NOTICE,  "command=%a seq=%b value=%c")
+
+#define EVENT_TRACE_ENUM(name, level, format) EVENT_##name,
+enum TraceEvent : uint8_t {
+  EVENT_TRACE_EVENTS(EVENT_TRACE_ENUM)
+  EVENT_COUNT
+};
+#undef EVENT_TRACE_ENUM
+
+#define EVENT_TRACE_LEVELS(name, level, format) EVENT_LEVEL_##name = level,
+enum TraceEventLevel : uint8_t {
+  EVENT_TRACE_EVENTS(EVENT_TRACE_LEVELS)
+};
+#undef EVENT_TRACE_LEVELS
+
+typedef struct trace_event_t {
+  uint32_t us;    // micros()
+  uint8_t id;
+  uint8_t a;
+  uint16_t b;
+  uint32_t c;
+} trace_event_t;
+
+#define EVENT_DUMP_HEADER "#EVT0"
+#define EVENT_DUMP_RECORD "#EVT "
+
+// A constant condition, the compiler drops filtered events without evaluating their arguments
+#define TRACE_EVENT(name, a, b, c) do { \
+    if (EVENT_LEVEL_##name <= EVENT_TRACE_LEVEL) { \
+      EVENT_record(EVENT_##name, static_cast<uint8_t>(a), static_cast<uint16_t>(b), static_cast<uint32_t>(c)); \
+    } \
+  } while (0)
+
+void EVENT_record(uint8_t id, uint8_t a, uint16_t b, uint32_t c);
+// Writes the records since the last dump, oldest first, and empties the ring
+void EVENT_dump(Print *out);
+uint16_t EVENT_count();
+uint32_t EVENT_dropped();
+
+const char* EVENT_name(uint8_t id);
+const char* EVENT_format(uint8_t id);
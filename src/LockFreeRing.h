@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Single producer / single consumer ring buffer of fixed, power of two capacity.
+// The producer (an interrupt or driver callback) only moves head, the consumer only
+// moves tail, so neither side needs to disable interrupts.
+template <typename T, uint16_t SIZE>
+class CLockFreeRing {
+
+  static_assert(SIZE >= 2 && (SIZE & (SIZE - 1)) == 0, "CLockFreeRing size must be a power of two");
+
+private:
+  T buffer[SIZE];
+  volatile uint16_t head;
+  volatile uint16_t tail;
+  volatile uint32_t overflows;
+
+public:
+  CLockFreeRing(): head(0), tail(0), overflows(0) {}
+
+  // Producer side, returns false and counts the loss when full
+  bool push(const T &item) {
+    const uint16_t h = head;
+    if (static_cast<uint16_t>(h - tail) >= SIZE) {
+      overflows++;
+      return false;
+    }
+    buffer[h & (SIZE - 1)] = item;
+    __sync_synchronize();
+    head = h + 1;
+    return true;
+  }
+
+  // Consumer side, copies up to max items out and returns how many
+  uint16_t pop(T *out, uint16_t max) {
+    const uint16_t t = tail;
+    uint16_t n = static_cast<uint16_t>(head - t);
+    if (n > max) {
+      n = max;
+    }
+    for (uint16_t i = 0; i < n; i++) {
+      out[i] = buffer[(t + i) & (SIZE - 1)];
+    }
+    __sync_synchronize();
+    tail = t + n;
+    return n;
+  }
+
+  bool pop(T *out) { return pop(out, 1) == 1; }
+
+  // Consumer side, copies the oldest item without removing it
+  bool peek(T *out) const {
+    if (isEmpty()) {
+      return false;
+    }
+    *out = buffer[tail & (SIZE - 1)];
+    return true;
+  }
+
+  // Consumer side, drops everything queued
+  void clear() { tail = head; }
+
+  uint16_t size() const { return static_cast<uint16_t>(head - tail); }
+  bool isEmpty() const { return head == tail; }
+  bool isFull() const { return size() >= SIZE; }
+  static uint16_t capacity() { return SIZE; }
+  uint32_t getOverflows() const { return overflows; }
+};
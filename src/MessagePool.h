@@ -0,0 +1,56 @@
+#pragma once
+
+#include <RF24Message.h>
+#include <RF24Message_VED_MPPT.h>
+#include <RF24Message_VED_INV.h>
+#include <RF24Message_VED_BATT.h>
+#include <RF24Message_VED_BATT_SUP.h>
+#include "RF24Message_VED_PACKED.h"
+#include "RF24Message_PHASES.h"
+#include "RF24Message_VED_AGG.h"
+#include "RF24Message_LOG.h"
+
+#include "ObjectPool.h"
+
+// Messages are materialized from the outbox when polled, so a type only ever has
+// the one being transmitted and the next one polled alive
+#define MESSAGE_POOL_SLOTS 2
+#define MESSAGE_POOL_ERROR_SLOTS 2
+#define MESSAGE_POOL_LOG_SLOTS 3 // A whole burst of backlog
+
+// Statically allocated storage for every radio message type the VE.Direct path creates
+class CMessagePool {
+
+private:
+  CObjectPool<CRF24Message, MESSAGE_POOL_ERROR_SLOTS> uvthp;
+  CObjectPool<CRF24Message_VED_MPPT, MESSAGE_POOL_SLOTS> mppt;
+  CObjectPool<CRF24Message_VED_INV, MESSAGE_POOL_SLOTS> inv;
+  CObjectPool<CRF24Message_VED_BATT, MESSAGE_POOL_SLOTS> batt;
+  CObjectPool<CRF24Message_VED_BATT_SUP, MESSAGE_POOL_SLOTS> battSup;
+  CObjectPool<CRF24Message_VED_PACKED, MESSAGE_POOL_SLOTS> packed;
+  CObjectPool<CRF24Message_PHASES, 1> phases;
+  CObjectPool<CRF24Message_VED_AGG, MESSAGE_POOL_SLOTS> aggregates;
+  CObjectPool<CRF24Message_LOG, MESSAGE_POOL_LOG_SLOTS> logs;
+
+public:
+  // NULL when the slots of that type are exhausted
+  CBaseMessage* create(const r24_message_uvthp_t &msg) { return uvthp.create(0, msg); }
+  CBaseMessage* create(const r24_message_ved_mppt_t &msg) { return mppt.create(0, msg); }
+  CBaseMessage* create(const r24_message_ved_inv_t &msg) { return inv.create(0, msg); }
+  CBaseMessage* create(const r24_message_ved_batt_t &msg) { return batt.create(0, msg); }
+  CBaseMessage* create(const r24_message_ved_batt_sup_t &msg) { return battSup.create(0, msg); }
+  CBaseMessage* create(const CVEDPackedWriter &writer) { return packed.create(0, writer); }
+  CBaseMessage* create(const trace_state_t &stats) { return phases.create(0, stats); }
+  CBaseMessage* create(const ved_aggregate_t &aggregate) { return aggregates.create(0, aggregate); }
+  CBaseMessage* create(const r24_message_log_marker_t &marker) { return logs.create(0, marker); }
+  CBaseMessage* create(const ved_log_record_t &record) { return logs.create(0, record); }
+
+  // The message if it came from the store-and-forward log, NULL otherwise
+  CRF24Message_LOG* findLog(CBaseMessage *msg) { return logs.find(msg); }
+
+  // Returns a message to its pool, false if it was not allocated here
+  bool release(CBaseMessage *msg) {
+    return uvthp.destroy(msg) || mppt.destroy(msg) || inv.destroy(msg) || batt.destroy(msg) || battSup.destroy(msg) || packed.destroy(msg)
+      || phases.destroy(msg) || aggregates.destroy(msg) || logs.destroy(msg);
+  }
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+#include <new>
+#include <utility>
+
+// Fixed number of statically allocated slots for objects of one type
+template <typename T, uint8_t N>
+class CObjectPool {
+
+  static_assert(N > 0 && N <= 32, "CObjectPool supports 1 to 32 slots");
+
+private:
+  alignas(T) uint8_t storage[N][sizeof(T)];
+  uint32_t used;
+
+  T* slot(uint8_t i) { return reinterpret_cast<T*>(storage[i]); }
+
+public:
+  CObjectPool(): used(0) {}
+
+  // Constructs an object in a free slot, NULL when all slots are taken
+  template <typename... Args>
+  T* create(Args&&... args) {
+    for (uint8_t i = 0; i < N; i++) {
+      if (!(used & (1UL << i))) {
+        used |= 1UL << i;
+        return new (storage[i]) T(std::forward<Args>(args)...);
+      }
+    }
+    return NULL;
+  }
+
+  // Destroys the object if it lives in this pool, given a pointer to it or to one of its bases
+  template <typename B>
+  bool destroy(B *obj) {
+    for (uint8_t i = 0; i < N; i++) {
+      if ((used & (1UL << i)) && static_cast<B*>(slot(i)) == obj) {
+        slot(i)->~T();
+        used &= ~(1UL << i);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // The object if it lives in this pool, NULL otherwise
+  template <typename B>
+  T* find(B *obj) {
+    for (uint8_t i = 0; i < N; i++) {
+      if ((used & (1UL << i)) && static_cast<B*>(slot(i)) == obj) {
+        return slot(i);
+      }
+    }
+    return NULL;
+  }
+
+  uint8_t available() const {
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < N; i++) {
+      if (!(used & (1UL << i))) { n++; }
+    }
+    return n;
+  }
+  static uint8_t capacity() { return N; }
+};
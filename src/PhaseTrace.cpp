@@ -0,0 +1,88 @@
+#include <Arduino.h>
+#include <ArduinoLog.h>
+
+#include "Configuration.h"
+#include "PhaseTrace.h"
+
+#define TRACE_NOT_REACHED 0xFFFF
+
+static_assert(RETAINED_BLOCK_TRACE + RETAINED_BLOCKS_FOR(trace_state_t) <= RETAINED_BLOCK_PROBES, "Phase trace overlaps the next retained block");
+
+static RETAINED trace_state_t traceState;
+static unsigned long traceOrigin = 0;
+static uint16_t traceMarks[PHASE_COUNT];
+
+static const char* const phaseNames[PHASE_COUNT] = {
+  "setup", "first byte", "first frame", "first queued", "first tx", "last tx", "sleep"
+};
+
+void TRACE_begin(unsigned long origin) {
+  static bool restored = false;
+  if (!restored) {
+    restored = true;
+    if (!CONFIG_retainedRestore(&traceState, sizeof(traceState), RETAINED_BLOCK_TRACE)) {
+      memset(&traceState, 0, sizeof(traceState));
+    }
+  }
+  traceOrigin = origin;
+  for (uint8_t p = 0; p < PHASE_COUNT; p++) {
+    traceMarks[p] = TRACE_NOT_REACHED;
+  }
+}
+
+void TRACE_mark(TracePhase phase) {
+  if (traceMarks[phase] == TRACE_NOT_REACHED || phase == PHASE_LAST_TX) {
+    const unsigned long ms = millis() - traceOrigin;
+    traceMarks[phase] = ms < TRACE_NOT_REACHED ? ms : TRACE_NOT_REACHED - 1;
+  }
+}
+
+void TRACE_end() {
+  TRACE_mark(PHASE_SLEEP);
+  traceState.cycles++;
+  for (uint8_t p = 0; p < PHASE_COUNT; p++) {
+    const uint16_t ms = traceMarks[p];
+    if (ms == TRACE_NOT_REACHED) {
+      continue;
+    }
+    trace_phase_stats_t &stats = traceState.phases[p];
+    if (stats.count == 0 || ms < stats.min) {
+      stats.min = ms;
+    }
+    if (ms > stats.max) {
+      stats.max = ms;
+    }
+    if (stats.count == UINT16_MAX) {
+      // Keep the average meaningful on long running nodes
+      stats.sum /= 2;
+      stats.count /= 2;
+    }
+    stats.sum += ms;
+    stats.count++;
+  }
+  CONFIG_retainedSave(&traceState, sizeof(traceState), RETAINED_BLOCK_TRACE);
+}
+
+uint16_t TRACE_get(TracePhase phase) {
+  return traceMarks[phase];
+}
+
+const trace_state_t& TRACE_getStats() {
+  return traceState;
+}
+
+const char* TRACE_phaseName(uint8_t phase) {
+  return phase < PHASE_COUNT ? phaseNames[phase] : "?";
+}
+
+void TRACE_log() {
+  if (Log.getLevel() < LOG_LEVEL_NOTICE) {
+    return;
+  }
+  Log.noticeln(F("Phase timing over %u cycles (ms): now min avg max"), traceState.cycles);
+  for (uint8_t p = 0; p < PHASE_COUNT; p++) {
+    const trace_phase_stats_t &stats = traceState.phases[p];
+    Log.noticeln(F("  %s: %u %u %u %u"), phaseNames[p], traceMarks[p], stats.min,
+      stats.count > 0 ? stats.sum / stats.count : 0, stats.max);
+  }
+}
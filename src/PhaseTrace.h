@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+
+// Milestones of one wake cycle, timed from reset or wake
+enum TracePhase : uint8_t {
+  PHASE_SETUP,          // setup() done
+  PHASE_FIRST_BYTE,     // First VE.Direct byte parsed
+  PHASE_FIRST_FRAME,    // First frame with a valid checksum
+  PHASE_FIRST_QUEUED,   // First snapshot in the outbox
+  PHASE_FIRST_TX,       // First successful radio burst
+  PHASE_LAST_TX,
+  PHASE_SLEEP,          // Entering deep sleep
+  PHASE_COUNT
+};
+
+typedef struct trace_phase_stats_t {
+  uint16_t min;   // ms
+  uint16_t max;
+  uint32_t sum;
+  uint16_t count; // Cycles that reached the phase
+} trace_phase_stats_t;
+
+// Kept in retained memory across deep sleep
+typedef struct trace_state_t {
+  trace_phase_stats_t phases[PHASE_COUNT];
+  uint16_t cycles;
+} trace_state_t;
+
+// Starts a cycle, origin is the millis() value phases are measured from
+void TRACE_begin(unsigned long origin);
+// Records the first time a phase is reached in this cycle, PHASE_LAST_TX the latest
+void TRACE_mark(TracePhase phase);
+// Marks PHASE_SLEEP and folds this cycle into the retained statistics
+void TRACE_end();
+
+// ms from the cycle origin, 0xFFFF when not reached
+uint16_t TRACE_get(TracePhase phase);
+const trace_state_t& TRACE_getStats();
+const char* TRACE_phaseName(uint8_t phase);
+void TRACE_log();
@@ -0,0 +1,86 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "RF24Command.h"
+
+static const char* const commandNames[RF24_COMMAND_COUNT] = { "?", "SLEEP", "SLOT", "RESEND" };
+
+const char* RF24_commandName(uint8_t command) {
+  return command < RF24_COMMAND_COUNT ? commandNames[command] : commandNames[0];
+}
+
+// Next space separated word, NULL at the end of the line
+static const char* nextWord(const char *p) {
+  while (*p != '\0' && *p != ' ') {
+    p++;
+  }
+  while (*p == ' ') {
+    p++;
+  }
+  return *p == '\0' || *p == '\r' || *p == '\n' ? NULL : p;
+}
+
+static bool isWord(const char *p, const char *word) {
+  const size_t length = strlen(word);
+  return strncmp(p, word, length) == 0 && (p[length] == ' ' || p[length] == '\0' || p[length] == '\r' || p[length] == '\n');
+}
+
+bool RF24_parseCommand(const char *line, uint8_t *pipe, r24_command_t *command) {
+  while (*line == ' ') {
+    line++;
+  }
+  if (!isWord(line, "CMD")) {
+    return false;
+  }
+  const char *p = nextWord(line);
+  char *end;
+  if (p == NULL) {
+    return false;
+  }
+  const unsigned long pipeValue = strtoul(p, &end, 10);
+  if (end == p || pipeValue < 1 || pipeValue > 5 || (p = nextWord(p)) == NULL) {
+    return false; // Pipe 0 is the node's own ACK pipe, never a reading pipe of the gateway
+  }
+  const unsigned long target = strtoul(p, &end, 16);
+  if (end == p || (p = nextWord(p)) == NULL) {
+    return false;
+  }
+
+  memset(command, 0, sizeof(*command));
+  command->id = MSG_COMMAND_ID;
+  command->target = target;
+  for (uint8_t c = RF24_COMMAND_SLEEP; c < RF24_COMMAND_COUNT; c++) {
+    if (isWord(p, commandNames[c])) {
+      command->command = c;
+    }
+  }
+  const char *value = nextWord(p);
+  switch (command->command) {
+    case RF24_COMMAND_SLEEP:
+    case RF24_COMMAND_SLOT:
+      if (value == NULL) {
+        return false;
+      }
+      command->value = strtoul(value, &end, 10);
+      if (end == value || (command->command == RF24_COMMAND_SLEEP && command->value > 0xFFFF)) {
+        return false;
+      }
+      break;
+    case RF24_COMMAND_RESEND:
+      break;
+    default:
+      return false;
+  }
+  *pipe = pipeValue;
+  return true;
+}
+
+bool RF24_readCommand(const void *payload, uint8_t size, uint32_t deviceId, r24_command_t *command) {
+  if (size < sizeof(*command)) {
+    return false;
+  }
+  memcpy(command, payload, sizeof(*command));
+  return command->id == MSG_COMMAND_ID && command->seq != 0
+    && command->command >= RF24_COMMAND_SLEEP && command->command < RF24_COMMAND_COUNT
+    && (command->target == RF24_COMMAND_TARGET_ANY || command->target == deviceId);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+
+// Downlink commands, carried from the gateway to the nodes in ACK payloads (RF24_ACK_MODE).
+//
+// The gateway loads a command into the ACK of the next packet received on the pipe of the node
+// and keeps doing so for GATEWAY_COMMAND_SEC, long enough for a few wakes of the target. Nodes
+// sharing an address take ACKs meant for each other, so a command names the device id it is for,
+// 0 for every node on the pipe. A node ignores repeats of the last seq it applied. ESP nodes
+// forget it in deep sleep and apply a command again in a later wake, which changes nothing.
+//
+// Over serial the gateway takes one command per line:
+//
+//   CMD <pipe> <target hex> SLEEP <seconds>   sleep interval, 0 for DEEP_SLEEP_INTERVAL_SEC, longer than
+//                                             the node's DEEP_SLEEP_MAX_SEC (2/3 of it with slots) is ignored
+//   CMD <pipe> <target hex> SLOT <slot>       transmit slot, see RF24Slots.h
+//   CMD <pipe> <target hex> RESEND            send every record again, changed or not
+
+#define MSG_COMMAND_ID 0xC1
+#define RF24_COMMAND_TARGET_ANY 0
+
+enum RF24Command : uint8_t {
+  RF24_COMMAND_SLEEP = 1,
+  RF24_COMMAND_SLOT,
+  RF24_COMMAND_RESEND,
+  RF24_COMMAND_COUNT
+};
+
+typedef struct r24_command_t {
+  uint8_t id;       // MSG_COMMAND_ID
+  uint8_t seq;      // Never 0
+  uint8_t command;  // RF24Command
+  uint32_t target;  // CONFIG_getDeviceId() of the node, RF24_COMMAND_TARGET_ANY
+  uint32_t value;
+} __attribute__((packed)) r24_command_t;
+
+const char* RF24_commandName(uint8_t command);
+// Parses a serial command line, seq is left to the caller
+bool RF24_parseCommand(const char *line, uint8_t *pipe, r24_command_t *command);
+// Validates an ACK payload and checks that it's meant for deviceId
+bool RF24_readCommand(const void *payload, uint8_t size, uint32_t deviceId, r24_command_t *command);
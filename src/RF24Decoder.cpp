@@ -0,0 +1,421 @@
+#include <math.h>
+#include <string.h>
+
+#include "RF24Decoder.h"
+#include "VEDirectPacked.h"
+#include "RF24Message_VED_AGG.h"
+#include "RF24Message_PHASES.h"
+#include "RF24Message_LOG.h"
+#include "RF24Parity.h"
+
+#define STATUS_SIZE 22 // id, uptime, voltage, temperature, humidity, pressure, error
+
+static const char* const classNames[VED_CLASS_COUNT] = { "NONE", "MPPT", "INV", "BATT", "BATT_SUP" };
+
+static uint8_t fieldSize(VEDFieldType type) {
+  switch (type) {
+    case VED_FIELD_F32: return 4;
+    case VED_FIELD_U16:
+    case VED_FIELD_I16: return 2;
+    default: return 1;
+  }
+}
+
+static float readFloat(const uint8_t *p) {
+  float value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static int32_t roundToInt(float value) {
+  return static_cast<int32_t>(value < 0 ? value - 0.5f : value + 0.5f);
+}
+
+CRF24Decoder::CRF24Decoder(Print *out, uint32_t dedupeMs)
+:out(out), dedupeMs(dedupeMs), layoutCount(0), length(0) {
+  memset(seen, 0, sizeof(seen));
+  memset(replays, 0, sizeof(replays));
+  memset(&stats, 0, sizeof(stats));
+}
+
+bool CRF24Decoder::addLayout(uint8_t id, uint8_t deviceClass, bool temperature) {
+  if (layoutCount == RF24_DECODER_LAYOUTS || deviceClass >= VED_CLASS_COUNT) {
+    return false;
+  }
+  layouts[layoutCount].id = id;
+  layouts[layoutCount].deviceClass = deviceClass;
+  layouts[layoutCount].temperature = temperature;
+  layoutCount++;
+  return true;
+}
+
+const CRF24Decoder::layout_t* CRF24Decoder::findLayout(uint8_t id) const {
+  for (uint8_t i = 0; i < layoutCount; i++) {
+    if (layouts[i].id == id) {
+      return &layouts[i];
+    }
+  }
+  return NULL;
+}
+
+// Open addressing on the payload hash, entries older than the window count as free
+bool CRF24Decoder::isDuplicate(uint8_t pipe, const uint8_t *payload, uint8_t size, uint32_t now) {
+  uint32_t hash = 2166136261u ^ pipe;
+  for (uint8_t i = 0; i < size; i++) {
+    hash = (hash ^ payload[i]) * 16777619u;
+  }
+  hash |= 1; // 0 marks a never used slot
+
+  // Goes into the first free slot, or else replaces the oldest one in reach
+  seen_t *slot = NULL;
+  bool slotLive = true;
+  for (uint8_t probe = 0; probe < RF24_DECODER_DEDUPE_PROBES; probe++) {
+    seen_t &entry = seen[(hash + probe) & (RF24_DECODER_DEDUPE_SLOTS - 1)];
+    const bool live = entry.hash != 0 && now - entry.ms <= dedupeMs;
+    if (live && entry.hash == hash) {
+      return true;
+    }
+    if (!live && slotLive) {
+      slot = &entry;
+      slotLive = false;
+    } else if (live && slotLive && (slot == NULL || now - entry.ms > now - slot->ms)) {
+      slot = &entry;
+    }
+  }
+  slot->hash = hash;
+  slot->ms = now;
+  return false;
+}
+
+bool CRF24Decoder::decode(uint8_t pipe, const uint8_t *payload, uint8_t size, uint32_t now) {
+  stats.payloads++;
+  if (size == 0 || pipe >= RF24_DECODER_PIPES) {
+    return false;
+  }
+  if (payload[0] == MSG_PARITY_ID) {
+    // Brings back one payload of the burst that was lost, if one was
+    uint8_t rebuilt[RF24_DECODER_PAYLOAD_SIZE];
+    if (!parity[pipe].rebuild(payload, size, now, rebuilt, sizeof(rebuilt))) {
+      return false;
+    }
+    stats.rebuilt++;
+    return decodePayload(pipe, rebuilt, sizeof(rebuilt), now);
+  }
+  parity[pipe].add(payload, size, now);
+  return decodePayload(pipe, payload, size, now);
+}
+
+bool CRF24Decoder::decodePayload(uint8_t pipe, const uint8_t *payload, uint8_t size, uint32_t now) {
+  if (isDuplicate(pipe, payload, size, now)) {
+    stats.duplicates++;
+    return false;
+  }
+
+  // Resent from the node's log, announced by its last marker
+  replay_t *replay = NULL;
+  if (replays[pipe].left > 0 && payload[0] != MSG_LOG_MARKER_ID) {
+    replays[pipe].left--;
+    replay = &replays[pipe];
+    stats.replays++;
+  }
+
+  const uint8_t id = payload[0];
+  const layout_t *layout = findLayout(id);
+  if (layout != NULL) {
+    return layout->deviceClass == VED_CLASS_NONE ? decodeStatus(pipe, payload, size) : decodeFixed(pipe, *layout, payload, size, replay);
+  }
+  if ((id & 0xF0) == VED_PACKED_ID) {
+    return decodePacked(pipe, payload, size, replay);
+  }
+  switch (id) {
+    case MSG_VED_AGG_ID: return decodeAggregate(pipe, payload, size);
+    case MSG_PHASE_TRACE_ID: return decodePhases(pipe, payload, size);
+    case MSG_LOG_MARKER_ID: return decodeMarker(pipe, payload, size);
+  }
+  decodeRaw(pipe, payload, size);
+  return true;
+}
+
+bool CRF24Decoder::decodeFixed(uint8_t pipe, const layout_t &layout, const uint8_t *payload, uint8_t size, const replay_t *replay) {
+  const VEDSchema *schema = VED_schema(layout.deviceClass);
+  ved_snapshot_t snapshot;
+  snapshot.deviceClass = layout.deviceClass;
+  snapshot.pid = 0; // Not carried by the fixed layouts
+  snapshot.present = static_cast<uint16_t>((1 << schema->count) - 1);
+
+  uint8_t offset = 1;
+  for (uint8_t f = 0; f < schema->count; f++) {
+    const VEDFieldSpec &spec = schema->fields[f];
+    if (offset + fieldSize(spec.type) > size) {
+      stats.malformed++;
+      return false;
+    }
+    const uint8_t *p = payload + offset;
+    switch (spec.type) {
+      case VED_FIELD_F32: snapshot.raw[f] = roundToInt(readFloat(p) / spec.scale); break;
+      case VED_FIELD_U8: snapshot.raw[f] = p[0]; break;
+      case VED_FIELD_I8: snapshot.raw[f] = static_cast<int8_t>(p[0]); break;
+      case VED_FIELD_U16: snapshot.raw[f] = static_cast<uint16_t>(p[0] | (p[1] << 8)); break;
+      case VED_FIELD_I16: snapshot.raw[f] = static_cast<int16_t>(p[0] | (p[1] << 8)); break;
+    }
+    if (spec.type != VED_FIELD_F32 && spec.scale != 1) {
+      snapshot.raw[f] = roundToInt(snapshot.raw[f] / spec.scale);
+    }
+    offset += fieldSize(spec.type);
+  }
+  const float temperature = layout.temperature && offset + 4 <= size ? readFloat(payload + offset) : NAN;
+  writeSnapshot(pipe, snapshot, temperature, replay);
+  return true;
+}
+
+bool CRF24Decoder::decodeStatus(uint8_t pipe, const uint8_t *payload, uint8_t size) {
+  if (size < STATUS_SIZE) {
+    stats.malformed++;
+    return false;
+  }
+  uint32_t uptime;
+  memcpy(&uptime, payload + 1, sizeof(uptime));
+  const float voltage = readFloat(payload + 5);
+  const float temperature = readFloat(payload + 9);
+  const float humidity = readFloat(payload + 13);
+  const float pressure = readFloat(payload + 17);
+
+  begin(pipe, "STATUS");
+  put(" up=");
+  putUnsigned(uptime);
+  if (!isnan(voltage)) {
+    putField("mV", roundToInt(voltage * 1000));
+  }
+  if (!isnan(temperature)) {
+    putField("t", roundToInt(temperature * 10));
+  }
+  if (!isnan(humidity)) {
+    putField("rh", roundToInt(humidity * 10));
+  }
+  if (!isnan(pressure)) {
+    putField("hpa", roundToInt(pressure * 10));
+  }
+  putField("err", payload[21]);
+  end();
+  return true;
+}
+
+bool CRF24Decoder::decodePacked(uint8_t pipe, const uint8_t *payload, uint8_t size, const replay_t *replay) {
+  CVEDPackedReader reader(payload, size);
+  if (!reader.isValid()) {
+    decodeRaw(pipe, payload, size); // Another version
+    return true;
+  }
+  ved_snapshot_t snapshot;
+  bool any = false;
+  while (reader.next(&snapshot)) {
+    writeSnapshot(pipe, snapshot, reader.getTemperature(), replay);
+    any = true;
+  }
+  if (!reader.isValid()) {
+    stats.malformed++;
+  }
+  return any;
+}
+
+bool CRF24Decoder::decodeAggregate(uint8_t pipe, const uint8_t *payload, uint8_t size) {
+  r24_message_ved_agg_t msg;
+  if (size < sizeof(msg)) {
+    stats.malformed++;
+    return false;
+  }
+  memcpy(&msg, payload, sizeof(msg));
+  int16_t v[3], i[3], p[3];
+  memcpy(v, msg.v, sizeof(v));
+  memcpy(i, msg.i, sizeof(i));
+  memcpy(p, msg.p, sizeof(p));
+
+  begin(pipe, "AGG");
+  put(" pid=");
+  putHex(msg.pid, 4);
+  putField("n", msg.samples);
+  putField("s", msg.seconds);
+  putTriple("V", v, 10);
+  putTriple("I", i, 10);
+  putTriple("P", p, 1);
+  putField("mWh", msg.energy);
+  putField("mAh", msg.charge);
+  end();
+  return true;
+}
+
+bool CRF24Decoder::decodePhases(uint8_t pipe, const uint8_t *payload, uint8_t size) {
+  r24_message_phase_trace_t msg;
+  if (size < sizeof(msg)) {
+    stats.malformed++;
+    return false;
+  }
+  memcpy(&msg, payload, sizeof(msg));
+  uint16_t avg[PHASE_COUNT], max[PHASE_COUNT];
+  memcpy(avg, msg.avg, sizeof(avg));
+  memcpy(max, msg.max, sizeof(max));
+
+  begin(pipe, "PHASES");
+  putField("cycles", msg.cycles);
+  put(" avg=");
+  for (uint8_t p = 0; p < PHASE_COUNT; p++) {
+    if (p > 0) {
+      put(',');
+    }
+    putUnsigned(avg[p]);
+  }
+  put(" max=");
+  for (uint8_t p = 0; p < PHASE_COUNT; p++) {
+    if (p > 0) {
+      put(',');
+    }
+    putUnsigned(max[p]);
+  }
+  end();
+  return true;
+}
+
+bool CRF24Decoder::decodeMarker(uint8_t pipe, const uint8_t *payload, uint8_t size) {
+  r24_message_log_marker_t marker;
+  if (size < sizeof(marker)) {
+    stats.malformed++;
+    return false;
+  }
+  memcpy(&marker, payload, sizeof(marker));
+  replays[pipe].left = marker.count;
+  replays[pipe].age = marker.age;
+
+  begin(pipe, "LOG");
+  if (marker.age != MSG_LOG_AGE_UNKNOWN) {
+    putField("age", marker.age);
+  }
+  putField("count", marker.count);
+  end();
+  return true;
+}
+
+void CRF24Decoder::decodeRaw(uint8_t pipe, const uint8_t *payload, uint8_t size) {
+  stats.unknown++;
+  while (size > 1 && payload[size - 1] == 0) {
+    size--; // Padding of the static payload size
+  }
+  begin(pipe, "RAW");
+  put(' ');
+  for (uint8_t i = 0; i < size; i++) {
+    putHex(payload[i], 2);
+  }
+  end();
+}
+
+void CRF24Decoder::writeCommand(uint8_t pipe, const r24_command_t &command) {
+  begin(pipe, "CMD");
+  putField("seq", command.seq);
+  put(" target=");
+  putHex(command.target, 8);
+  put(' ');
+  put(RF24_commandName(command.command));
+  if (command.command != RF24_COMMAND_RESEND) {
+    put('=');
+    putUnsigned(command.value);
+  }
+  end();
+}
+
+void CRF24Decoder::writeSnapshot(uint8_t pipe, const ved_snapshot_t &snapshot, float temperature, const replay_t *replay) {
+  const VEDSchema *schema = VED_schema(snapshot.deviceClass);
+  begin(pipe, classNames[snapshot.deviceClass]);
+  if (snapshot.pid != 0) {
+    put(" pid=");
+    putHex(snapshot.pid, 4);
+  }
+  if (!isnan(temperature)) {
+    putField("t", roundToInt(temperature * 10));
+  }
+  for (uint8_t f = 0; f < schema->count; f++) {
+    if (snapshot.present & (1 << f)) {
+      putField(VED_labelName(schema->fields[f].label), snapshot.raw[f]);
+    }
+  }
+  if (replay != NULL) {
+    if (replay->age != MSG_LOG_AGE_UNKNOWN) {
+      putField("age", replay->age);
+    } else {
+      put(" age=?");
+    }
+  }
+  end();
+}
+
+void CRF24Decoder::begin(uint8_t pipe, const char *type) {
+  length = 0;
+  putUnsigned(pipe);
+  put(' ');
+  put(type);
+}
+
+void CRF24Decoder::put(const char *text) {
+  while (*text && length < RF24_DECODER_LINE_SIZE - 2) {
+    line[length++] = *text++;
+  }
+}
+
+void CRF24Decoder::put(char c) {
+  if (length < RF24_DECODER_LINE_SIZE - 2) {
+    line[length++] = c;
+  }
+}
+
+void CRF24Decoder::putUnsigned(uint32_t value) {
+  char digits[10];
+  uint8_t n = 0;
+  do {
+    digits[n++] = '0' + value % 10;
+    value /= 10;
+  } while (value > 0);
+  while (n > 0) {
+    put(digits[--n]);
+  }
+}
+
+void CRF24Decoder::putSigned(int32_t value) {
+  if (value < 0) {
+    put('-');
+    putUnsigned(static_cast<uint32_t>(-(value + 1)) + 1);
+  } else {
+    putUnsigned(value);
+  }
+}
+
+void CRF24Decoder::putHex(uint32_t value, uint8_t digits) {
+  static const char hex[] = "0123456789abcdef";
+  while (digits > 0) {
+    digits--;
+    put(hex[(value >> (4 * digits)) & 0x0F]);
+  }
+}
+
+void CRF24Decoder::putField(const char *name, int32_t value) {
+  put(' ');
+  put(name);
+  put('=');
+  putSigned(value);
+}
+
+void CRF24Decoder::putTriple(const char *name, const int16_t *values, int32_t scale) {
+  put(' ');
+  put(name);
+  put('=');
+  for (uint8_t i = 0; i < 3; i++) {
+    if (i > 0) {
+      put(',');
+    }
+    putSigned(values[i] * scale);
+  }
+}
+
+// Whole lines only, a line cut at RF24_DECODER_LINE_SIZE still ends with its newline
+void CRF24Decoder::end() {
+  line[length++] = '\n';
+  out->write(reinterpret_cast<const uint8_t*>(line), length);
+  stats.lines++;
+}
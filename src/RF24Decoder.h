@@ -0,0 +1,113 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "VEDirectSchema.h"
+#include "RF24Command.h"
+#include "RF24Parity.h"
+
+// Receiving side of the radio messages, turns payloads from any number of nodes into text lines.
+//
+// Every payload becomes one line per record, fields separated by spaces, integers only:
+//
+//   <pipe> MPPT|INV|BATT|BATT_SUP pid=<hex> [t=<0.1C>] <label>=<TEXT protocol value>... [age=<s>]
+//   <pipe> STATUS up=<ms> [mV=<>] [t=<0.1C>] [rh=<0.1%>] [hpa=<0.1hPa>] err=<>
+//   <pipe> AGG pid=<hex> n=<samples> s=<window> V=<min>,<mean>,<max> I=... P=... mWh=<> mAh=<>
+//   <pipe> PHASES cycles=<> avg=<ms>,... max=<ms>,...
+//   <pipe> LOG [age=<s>] count=<>
+//   <pipe> RAW <hex>
+//   <pipe> CMD seq=<> target=<hex> SLEEP=<s>|SLOT=<>|RESEND   command armed for the ACKs, see RF24Command.h
+//
+// Values of the fixed layout, packed and replayed messages are all in TEXT protocol units, so a
+// record reads the same whatever format carried it. Records resent from a node's log, the count
+// payloads after its LOG marker, end with the age of the marker. Nodes send every payload several
+// times, a payload seen on the same pipe within the dedupe window is dropped. A parity payload
+// writes nothing itself, but the lines of the one payload of its burst that was lost, if any.
+//
+// The fixed layouts of the stus-rf24-commons messages follow the device schema: the message id,
+// the schema fields in order with their field type, then an optional float temperature. Their ids
+// are registered with addLayout(), so the decoder itself builds without the commons library.
+
+#define RF24_DECODER_PIPES 6
+#define RF24_DECODER_LAYOUTS 8
+#define RF24_DECODER_DEDUPE_SLOTS 2048 // Power of two, distinct payloads remembered within the window, a saturated radio brings ~2000 in 10 s
+#define RF24_DECODER_DEDUPE_PROBES 16
+#define RF24_DECODER_LINE_SIZE 192
+#define RF24_DECODER_PAYLOAD_SIZE 32
+
+typedef struct rf24_decoder_stats_t {
+  uint32_t payloads;
+  uint32_t lines;
+  uint32_t duplicates;
+  uint32_t replays;
+  uint32_t unknown;     // Sent as RAW
+  uint32_t malformed;   // Packed payloads that didn't parse to the end
+  uint32_t rebuilt;     // Lost payloads brought back from a parity (RF24Parity.h)
+} rf24_decoder_stats_t;
+
+class CRF24Decoder {
+
+private:
+  typedef struct {
+    uint8_t id;
+    uint8_t deviceClass;  // VED_CLASS_NONE for the status message
+    bool temperature;
+  } layout_t;
+
+  typedef struct {
+    uint32_t hash;
+    uint32_t ms;
+  } seen_t;
+
+  typedef struct {
+    uint8_t left;         // Replayed payloads still to come after the last marker
+    uint32_t age;
+  } replay_t;
+
+  Print *out;
+  uint32_t dedupeMs;
+  layout_t layouts[RF24_DECODER_LAYOUTS];
+  uint8_t layoutCount;
+  seen_t seen[RF24_DECODER_DEDUPE_SLOTS];
+  replay_t replays[RF24_DECODER_PIPES];
+  CRF24ParityDecoder parity[RF24_DECODER_PIPES];
+  rf24_decoder_stats_t stats;
+
+  char line[RF24_DECODER_LINE_SIZE];
+  uint8_t length;
+
+  bool isDuplicate(uint8_t pipe, const uint8_t *payload, uint8_t size, uint32_t now);
+  bool decodePayload(uint8_t pipe, const uint8_t *payload, uint8_t size, uint32_t now);
+  const layout_t* findLayout(uint8_t id) const;
+
+  bool decodeFixed(uint8_t pipe, const layout_t &layout, const uint8_t *payload, uint8_t size, const replay_t *replay);
+  bool decodeStatus(uint8_t pipe, const uint8_t *payload, uint8_t size);
+  bool decodePacked(uint8_t pipe, const uint8_t *payload, uint8_t size, const replay_t *replay);
+  bool decodeAggregate(uint8_t pipe, const uint8_t *payload, uint8_t size);
+  bool decodePhases(uint8_t pipe, const uint8_t *payload, uint8_t size);
+  bool decodeMarker(uint8_t pipe, const uint8_t *payload, uint8_t size);
+  void decodeRaw(uint8_t pipe, const uint8_t *payload, uint8_t size);
+  void writeSnapshot(uint8_t pipe, const ved_snapshot_t &snapshot, float temperature, const replay_t *replay);
+
+  void begin(uint8_t pipe, const char *type);
+  void put(const char *text);
+  void put(char c);
+  void putUnsigned(uint32_t value);
+  void putSigned(int32_t value);
+  void putHex(uint32_t value, uint8_t digits);
+  void putField(const char *name, int32_t value);
+  void putTriple(const char *name, const int16_t *values, int32_t scale);
+  void end();
+
+public:
+  CRF24Decoder(Print *out, uint32_t dedupeMs);
+
+  // Fixed layout message id of a device class, VED_CLASS_NONE for the status (UVTHP) message
+  bool addLayout(uint8_t id, uint8_t deviceClass, bool temperature);
+  // Writes the lines of a payload received on pipe, false when nothing was written
+  bool decode(uint8_t pipe, const uint8_t *payload, uint8_t size, uint32_t now);
+  // Writes the line of a downlink command the gateway took
+  void writeCommand(uint8_t pipe, const r24_command_t &command);
+
+  const rf24_decoder_stats_t& getStats() const { return stats; }
+};
@@ -0,0 +1,212 @@
+#include <Arduino.h>
+#include <SPI.h>
+#include <RF24.h>
+#include <nRF24L01.h>
+#include <ArduinoLog.h>
+
+#include "Configuration.h"
+
+#ifdef STUS_GATEWAY
+
+#include <RF24Message.h>
+#include <RF24Message_VED_MPPT.h>
+#include <RF24Message_VED_INV.h>
+#include <RF24Message_VED_BATT.h>
+#include <RF24Message_VED_BATT_SUP.h>
+
+#include "RF24Gateway.h"
+#include "RF24Command.h"
+
+#if defined(ESP32)
+  #define CE_PIN  GPIO_NUM_22
+  #define CSN_PIN GPIO_NUM_21
+#elif defined(ESP8266)
+  #define CE_PIN  D4
+  #define CSN_PIN D8
+#elif defined(SEEED_XIAO_M0)
+  #define CE_PIN  D2
+  #define CSN_PIN D3
+#endif
+
+static const char* const gatewayAddresses[] = GATEWAY_ADDRESSES;
+#define GATEWAY_ADDRESS_COUNT (sizeof(gatewayAddresses) / sizeof(gatewayAddresses[0]))
+static_assert(GATEWAY_ADDRESS_COUNT >= 1 && GATEWAY_ADDRESS_COUNT <= 5, "GATEWAY_ADDRESSES takes 1 to 5 addresses, pipe 0 stays free");
+
+// CRF24Decoder::decodeFixed() reads the commons messages packed in schema order: the id, the
+// fields back to back, then the temperature where the layout has one. Padding or another member
+// changes the size, and brace initializing a message from values of the schema types in that
+// order stops compiling once a member changes type, which pins down every offset.
+static_assert(sizeof(r24_message_ved_mppt_t) == 1 + 4 * 4 + 4 * 1 + 2 * 2 + 4, "MPPT message no longer matches the schema");
+static_assert(sizeof(r24_message_ved_inv_t) == 1 + 4 * 4 + 5 * 1 + 4, "Inverter message no longer matches the schema");
+static_assert(sizeof(r24_message_ved_batt_t) == 1 + 3 * 4 + 2 + 4 + 2 * 2 + 1, "Battery message no longer matches the schema");
+static_assert(sizeof(r24_message_ved_batt_sup_t) == 1 + 4 + 2 + 4 * 4 + 4, "Battery history message no longer matches the schema");
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic error "-Wnarrowing" // GCC only warns about narrowing a variable by default
+template<typename Message, typename... Fields>
+static void checkLayout(Fields... fields) {
+  const Message message { fields... };
+  (void)message;
+}
+#pragma GCC diagnostic pop
+
+CRF24Gateway::CRF24Gateway(Print *out, Stream *in)
+:decoder(out, GATEWAY_DEDUPE_MS), in(in), error(false), tMillisStats(millis())
+#ifdef RF24_ACK_MODE
+  , commandSeq(0), commandLength(0)
+#endif
+{
+  #ifdef RF24_ACK_MODE
+    memset(commands, 0, sizeof(commands));
+  #endif
+  // Fixed layouts of the commons messages, the schema gives their fields
+  checkLayout<r24_message_ved_mppt_t>(uint8_t(), float(), float(), float(), float(),
+    uint8_t(), uint8_t(), uint8_t(), uint8_t(), uint16_t(), uint16_t(), float());
+  checkLayout<r24_message_ved_inv_t>(uint8_t(), float(), float(), float(), float(),
+    uint8_t(), int8_t(), uint8_t(), uint8_t(), uint8_t(), float());
+  checkLayout<r24_message_ved_batt_t>(uint8_t(), float(), float(), float(), int16_t(),
+    float(), uint16_t(), uint16_t(), uint8_t());
+  checkLayout<r24_message_ved_batt_sup_t>(uint8_t(), float(), uint16_t(), float(), float(), float(), float(), float());
+  decoder.addLayout(MSG_UVTHP_ID, VED_CLASS_NONE, false);
+  decoder.addLayout(MSG_VED_MPPT_ID, VED_CLASS_MPPT, true);
+  decoder.addLayout(MSG_VED_INV_ID, VED_CLASS_INV, true);
+  decoder.addLayout(MSG_VED_BATT_ID, VED_CLASS_BATT, false);
+  decoder.addLayout(MSG_VED_BATT_SUP_ID, VED_CLASS_BATT_SUP, true);
+
+  radio = new RF24(CE_PIN, CSN_PIN);
+  if (!radio->begin()) {
+    Log.errorln(F("Failed to initialize RF24 radio"));
+    error = true;
+    return;
+  }
+
+  // Same settings as the nodes, see CRF24Manager
+  radio->setAddressWidth(5);
+  radio->setDataRate(RF24_DATA_RATE);
+  radio->setPALevel(RF24_PA_LEVEL);
+  radio->setChannel(RF24_CHANNEL);
+  radio->setPayloadSize(RF24_DECODER_PAYLOAD_SIZE);
+  #ifdef RF24_ACK_MODE
+    radio->setAutoAck(true);
+    radio->enableDynamicPayloads();
+    radio->enableAckPayload();
+  #else
+    radio->setAutoAck(false);
+  #endif
+  for (uint8_t i = 0; i < GATEWAY_ADDRESS_COUNT; i++) {
+    uint8_t addr[6];
+    memcpy(addr, gatewayAddresses[i], 6);
+    radio->openReadingPipe(i + 1, addr);
+  }
+  radio->startListening();
+  Log.infoln(F("Gateway listening on %i addresses"), GATEWAY_ADDRESS_COUNT);
+}
+
+CRF24Gateway::~CRF24Gateway() {
+  radio->stopListening();
+  delete radio;
+}
+
+void CRF24Gateway::loop() {
+  if (error) {
+    return;
+  }
+  // Drains the 3 level RX FIFO, the radio keeps receiving while the lines go out
+  uint8_t pipe;
+  while (radio->available(&pipe)) {
+    uint8_t payload[RF24_DECODER_PAYLOAD_SIZE];
+    #ifdef RF24_ACK_MODE
+      const uint8_t size = radio->getDynamicPayloadSize(); // 0 after a corrupt length, the RX FIFO is flushed then
+      if (size == 0) {
+        continue;
+      }
+      if (pipe < RF24_DECODER_PIPES && commands[pipe].loaded) {
+        commands[pipe].loaded = false; // Went out with the ACK of this packet
+      }
+    #else
+      const uint8_t size = sizeof(payload);
+    #endif
+    radio->read(payload, size);
+    decoder.decode(pipe, payload, size, millis());
+  }
+
+  #ifdef RF24_ACK_MODE
+    readCommandLine();
+    loadCommands();
+  #endif
+
+  if (millis() - tMillisStats > 60000) {
+    tMillisStats = millis();
+    const rf24_decoder_stats_t &stats = decoder.getStats();
+    Log.noticeln(F("Payloads=%u lines=%u duplicates=%u replays=%u rebuilt=%u unknown=%u malformed=%u"), stats.payloads, stats.lines,
+      stats.duplicates, stats.replays, stats.rebuilt, stats.unknown, stats.malformed);
+  }
+}
+
+#ifdef RF24_ACK_MODE
+void CRF24Gateway::readCommandLine() {
+  while (in->available() > 0) {
+    const char c = in->read();
+    if (c != '\n') {
+      if (commandLength < GATEWAY_COMMAND_LINE_SIZE - 1) {
+        commandLine[commandLength++] = c;
+      }
+      continue;
+    }
+    commandLine[commandLength] = '\0';
+    commandLength = 0;
+    uint8_t pipe;
+    r24_command_t command;
+    if (!RF24_parseCommand(commandLine, &pipe, &command) || pipe > GATEWAY_ADDRESS_COUNT) {
+      Log.warningln(F("Invalid command: %s"), commandLine);
+      continue;
+    }
+    armCommand(pipe, command);
+  }
+}
+
+// Replaces the command of the pipe, it's repeated with every ACK there until GATEWAY_COMMAND_SEC passed
+void CRF24Gateway::armCommand(uint8_t pipe, r24_command_t &command) {
+  if (++commandSeq == 0) {
+    commandSeq = 1;
+  }
+  command.seq = commandSeq;
+  if (commands[pipe].loaded) {
+    unloadCommands();
+  }
+  commands[pipe].command = command;
+  commands[pipe].tsArmed = millis();
+  commands[pipe].active = true;
+  decoder.writeCommand(pipe, command);
+  loadCommands();
+}
+
+void CRF24Gateway::loadCommands() {
+  for (uint8_t pipe = 0; pipe < RF24_DECODER_PIPES; pipe++) {
+    armed_t &armed = commands[pipe];
+    if (armed.active && millis() - armed.tsArmed > GATEWAY_COMMAND_SEC * 1000UL) {
+      armed.active = false;
+      if (armed.loaded) {
+        unloadCommands();
+      }
+    }
+  }
+  for (uint8_t pipe = 0; pipe < RF24_DECODER_PIPES; pipe++) {
+    armed_t &armed = commands[pipe];
+    // The TX FIFO holds 3 payloads for all pipes, the others get in as ACKs make room
+    if (armed.active && !armed.loaded && radio->writeAckPayload(pipe, &armed.command, sizeof(armed.command))) {
+      armed.loaded = true;
+    }
+  }
+}
+
+// Single payloads can't be taken back from the TX FIFO, the others are loaded again
+void CRF24Gateway::unloadCommands() {
+  radio->flush_tx();
+  for (uint8_t pipe = 0; pipe < RF24_DECODER_PIPES; pipe++) {
+    commands[pipe].loaded = false;
+  }
+}
+#endif
+
+#endif
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <RF24.h>
+
+#include "Configuration.h"
+#include "BaseManager.h"
+#include "RF24Decoder.h"
+
+#define GATEWAY_COMMAND_LINE_SIZE 48
+
+// Receiver build (STUS_GATEWAY): listens to the node addresses in GATEWAY_ADDRESSES and streams
+// every decoded message as a text line, see RF24Decoder.h. With RF24_ACK_MODE it acknowledges
+// the packets and takes command lines from serial, which go out to the nodes in the ACK payloads
+// of their pipe (RF24Command.h).
+class CRF24Gateway: public CBaseManager {
+
+private:
+  RF24 *radio;
+  CRF24Decoder decoder;
+  Stream *in;
+  bool error;
+  unsigned long tMillisStats;
+
+  #ifdef RF24_ACK_MODE
+    typedef struct {
+      r24_command_t command;
+      unsigned long tsArmed;
+      bool active;
+      bool loaded;    // In the TX FIFO, goes out with the next ACK on the pipe
+    } armed_t;
+
+    armed_t commands[RF24_DECODER_PIPES];
+    uint8_t commandSeq;
+    char commandLine[GATEWAY_COMMAND_LINE_SIZE];
+    uint8_t commandLength;
+
+    void readCommandLine();
+    void armCommand(uint8_t pipe, r24_command_t &command);
+    void loadCommands();
+    void unloadCommands();
+  #endif
+
+public:
+  CRF24Gateway(Print *out, Stream *in);
+  virtual ~CRF24Gateway();
+
+  // CBaseManager
+  virtual void loop();
+  virtual const bool isError() { return error; }
+  virtual const uint32_t getIdleMs() { return 0; }
+
+  const rf24_decoder_stats_t& getStats() const { return decoder.getStats(); }
+};
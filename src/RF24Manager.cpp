@@ -6,6 +6,9 @@
 
 #include "RF24Manager.h"
 #include "Configuration.h"
+#include "PhaseTrace.h"
+#include "EventTrace.h"
+#include "RF24Parity.h"
 
 
 #if defined(ESP32)
@@ -21,12 +24,37 @@
 
 #ifdef RADIO_RF24
   #define MAX_RETRIES_BEFORE_DONE 10
+  static_assert(RF24_BURST_SIZE >= 1 && RF24_BURST_SIZE <= RF24_TX_FIFO_DEPTH, "RF24_BURST_SIZE must fit the TX FIFO");
 #else
   #define MAX_RETRIES_BEFORE_DONE 1
 #endif
 
+#ifndef RF24_SLOT
+  #define RF24_SLOT -1
+#endif
+#ifndef RF24_SLOT_MS
+  #define RF24_SLOT_MS 0 // A single slot, only the sleep interval is kept
+#endif
+
+#ifdef RF24_TX_SLOTS
+  #define RF24_MAX_INTERVAL_SEC (DEEP_SLEEP_MAX_SEC * 2UL / 3) // The way to the own slot sleeps up to 1.5 intervals
+#else
+  #define RF24_MAX_INTERVAL_SEC ((uint32_t)DEEP_SLEEP_MAX_SEC)
+#endif
+static_assert(DEEP_SLEEP_INTERVAL_SEC <= RF24_MAX_INTERVAL_SEC, "DEEP_SLEEP_INTERVAL_SEC is longer than the platform sleeps");
+static RETAINED rf24_slot_state_t slotState;
+static_assert(RETAINED_BLOCK_SLOTS + RETAINED_BLOCKS_FOR(rf24_slot_state_t) <= RETAINED_BLOCK_DEADBAND, "Slot state overlaps the next retained block");
+
 CRF24Manager::CRF24Manager(IVEDMessageProvider *vedProvider)
-:vedProvider(vedProvider), jobDone(false), transmittedCount(0), tsLastTransmit(0) {  
+:tMillis(0), tsLastTransmit(0), tsRetryAt(0), tsFirstPacket(0), tsLastPacket(0), retries(0), error(false), state(TX_COLLECT), burstCount(0),
+  vedProvider(vedProvider), jobDone(false), transmittedCount(0), commandSeq(0), slots(&slotState, DEEP_SLEEP_INTERVAL_SEC, RF24_SLOT_MS) {
+
+  if (!CONFIG_retainedRestore(&slotState, sizeof(slotState), RETAINED_BLOCK_SLOTS)) {
+    slotState.intervalSec = 0;
+  }
+  slots.begin(CONFIG_getDeviceId(), RF24_SLOT);
+  CONFIG_retainedSave(&slotState, sizeof(slotState), RETAINED_BLOCK_SLOTS);
+
   radio = new RF24(CE_PIN, CSN_PIN);
   
   if (!radio->begin()) {
@@ -47,8 +75,16 @@ CRF24Manager::CRF24Manager(IVEDMessageProvider *vedProvider)
   radio->setPALevel(RF24_PA_LEVEL);
   radio->setChannel(RF24_CHANNEL);
   radio->setPayloadSize(maxMessageSize);
-  radio->setRetries(15, 15);
-  radio->setAutoAck(false);
+  #ifdef RF24_ACK_MODE
+    // Pipe 0 takes the ACKs, openWritingPipe() gives it the address
+    radio->setRetries(RF24_ACK_DELAY, RF24_ACK_RETRIES);
+    radio->setAutoAck(true);
+    radio->enableDynamicPayloads();
+    radio->enableAckPayload();
+  #else
+    radio->setRetries(15, 15);
+    radio->setAutoAck(false);
+  #endif
   radio->openWritingPipe(addr);
   radio->stopListening();
   
@@ -87,49 +123,265 @@ void CRF24Manager::loop() {
     return;
   }
 
-  if (millis() - tsLastTransmit < 100) {
-    // Allow slower 8266s to catch up
+  if (state == TX_BACKOFF) {
+    if (static_cast<long>(millis() - tsRetryAt) >= 0) {
+      transmitBurst();
+    }
     return;
   }
 
-  // Take measurement
-  CBaseMessage *msg = vedProvider->pollMessage();
-  if (msg != NULL) { 
-    if (Log.getLevel() >= LOG_LEVEL_VERBOSE) {
-      Log.verboseln(F("Msg: %s"), msg->getString().c_str());
-    }
-    if (radio->write(msg->getMessageBuffer(), msg->getMessageLength(), true)) {
-      tMillis = millis();
-      tsLastTransmit = millis();
-      Log.noticeln(F("Transmitted message %i/%i: %s"), transmittedCount, MSGS_TO_TRANSMIT_BEFORE_DONE, msg->getString().c_str());
-      if (++transmittedCount > MSGS_TO_TRANSMIT_BEFORE_DONE) {
-        jobDone = true;
-      }
-    } else {
-      if (++retries > MAX_RETRIES_BEFORE_DONE) {
-        // Lost cause
-        Log.warningln(F("Failed to transmit after %i retries"), retries);
-        jobDone = true;
-      } else {
-        // Retry
-        uint16_t backoffDelaySec = 100 * retries * retries;  // Exp back off with each attempt
-        Log.noticeln(F("RF24 transmit error, will try again for attempt %i after %i seconds"), retries, backoffDelaySec);
-        delay(backoffDelaySec);
-        intLEDBlink(50);
-      }
+  if (RF24_BURST_GAP_MS > 0 && millis() - tsLastTransmit < RF24_BURST_GAP_MS) {
+    // Allow slower receivers to catch up
+    return;
+  }
+
+  // Collect what is ready, up to the depth of the TX FIFO
+  while (burstCount < RF24_BURST_SIZE && !isRepetitionDone()) {
+    CBaseMessage *msg = vedProvider->pollMessage();
+    if (msg == NULL) {
+      break;
     }
-    delete msg;
+    TRACE_EVENT(POLL, *static_cast<const uint8_t*>(msg->getMessageBuffer()), 0, msg->getMessageLength());
+    burst[burstCount++] = msg;
+  }
+
+  if (burstCount > 0) { 
+    transmitBurst();
+  } else if (isDelivered()) {
+    Log.noticeln(F("Nothing left worth transmitting after %i messages"), transmittedCount);
+    jobDone = true;
   } else if (millis() - tMillis > 5000) {
     tMillis = millis();
     Log.warningln("No VE.Direct message for over 5sec");
   }
 }
 
+const uint32_t CRF24Manager::getIdleMs() {
+  if (isJobDone()) {
+    return MANAGER_IDLE_FOREVER;
+  }
+  const unsigned long now = millis();
+  if (state == TX_BACKOFF) {
+    return static_cast<long>(tsRetryAt - now) > 0 ? tsRetryAt - now : 0;
+  }
+  if (RF24_BURST_GAP_MS > 0 && now - tsLastTransmit < RF24_BURST_GAP_MS) {
+    return RF24_BURST_GAP_MS - (now - tsLastTransmit);
+  }
+  if (burstCount > 0 || vedProvider->hasMessage() || isDelivered()) {
+    return 0;
+  }
+  #ifdef RF24_ACK_MODE
+    return RF24_ACK_QUIET_MS / 10; // The provider's quiet time runs out without a message
+  #else
+    // Waiting for the provider, wakes again for the missing message warning
+    return now - tMillis < 5000 ? 5000 - (now - tMillis) : 0;
+  #endif
+}
+
+bool CRF24Manager::isRepetitionDone() {
+  #ifdef RF24_ACK_MODE
+    return false; // Records are polled until acked, then no more
+  #else
+    return getLiveCount() > MSGS_TO_TRANSMIT_BEFORE_DONE;
+  #endif
+}
+
+bool CRF24Manager::isDelivered() {
+  #ifdef RF24_ACK_MODE
+    return vedProvider->isAllDelivered();
+  #else
+    return getLiveCount() + vedProvider->getSuppressedCount() > MSGS_TO_TRANSMIT_BEFORE_DONE;
+  #endif
+}
+
+bool CRF24Manager::isChannelBusy() {
+  #ifdef RF24_TX_SLOTS
+    // Received power above -64 dBm while listening, another node in or drifted into the slot
+    radio->startListening();
+    delayMicroseconds(RF24_CARRIER_SENSE_US);
+    const bool busy = radio->testRPD();
+    radio->stopListening();
+    if (busy) {
+      TRACE_EVENT(TX_BUSY, slots.getSlot(), retries + 1, 0);
+      slots.reportBusy();
+    }
+    return busy;
+  #else
+    return false;
+  #endif
+}
+
+void CRF24Manager::transmitBurst() {
+  const unsigned long tsStart = micros();
+  uint8_t sent = 0;
+  uint8_t overhead = 0; // Parity packets, each takes the air time of a message
+  bool ok = !isChannelBusy(); // Backs off like a failed burst
+  if (ok) {
+    #ifdef RF24_ACK_MODE
+      // One write per message, the radio retransmits it until acked, the first one lost ends the burst
+      while (sent < burstCount && radio->write(burst[sent]->getMessageBuffer(), burst[sent]->getMessageLength())) {
+        sent++;
+        readAcks();
+      }
+      ok = sent == burstCount;
+    #elif RF24_BURST_SIZE > 1
+      // Payloads go out while the next ones are still being clocked into the FIFO
+      #ifdef RF24_PARITY
+        CRF24ParityEncoder parity;
+        bool covered = true;
+      #endif
+      for (uint8_t i = 0; i < burstCount; i++) {
+        ok = radio->writeFast(burst[i]->getMessageBuffer(), burst[i]->getMessageLength(), true) && ok;
+        #ifdef RF24_PARITY
+          covered = parity.add(burst[i]->getMessageBuffer(), burst[i]->getMessageLength()) && covered;
+        #endif
+      }
+      #ifdef RF24_PARITY
+        if (covered && burstCount > 1) {
+          ok = radio->writeFast(parity.getBuffer(), parity.getLength(), true) && ok;
+          overhead = 1;
+        }
+      #endif
+      ok = radio->txStandBy() && ok;
+      sent = ok ? burstCount : 0;
+    #else
+      ok = radio->write(burst[0]->getMessageBuffer(), burst[0]->getMessageLength(), true);
+      sent = ok ? burstCount : 0;
+    #endif
+  }
+  if (tsFirstPacket == 0) {
+    tsFirstPacket = tsStart;
+  }
+  tsLastPacket = micros();
+
+  if (sent > 0) {
+    tMillis = millis();
+    tsLastTransmit = millis();
+    TRACE_EVENT(TX, sent, transmittedCount + sent, tsLastPacket - tsStart);
+    TRACE_mark(PHASE_FIRST_TX);
+    TRACE_mark(PHASE_LAST_TX);
+    transmittedCount += sent + overhead;
+    releaseBurst(sent);
+  }
+  if (ok) {
+    state = TX_COLLECT;
+    if (isRepetitionDone()) {
+      Log.noticeln(F("Transmitted %i messages in %u us"), transmittedCount, getTransmitTime());
+      jobDone = true;
+    }
+    return;
+  }
+
+  if (++retries > MAX_RETRIES_BEFORE_DONE) {
+    // Lost cause
+    Log.warningln(F("Failed to transmit after %i retries"), retries);
+    TRACE_EVENT(TX_FAIL, retries, 0, 0);
+    failBurst();
+    jobDone = true;
+    return;
+  }
+
+  // Exponential back off with each attempt, half of it jittered so nodes that collided spread apart
+  uint32_t backoff = static_cast<uint32_t>(RF24_BACKOFF_BASE_MS) << (retries - 1);
+  if (backoff > RF24_BACKOFF_MAX_MS) {
+    backoff = RF24_BACKOFF_MAX_MS;
+  }
+  backoff = backoff / 2 + random(backoff / 2 + 1);
+  TRACE_EVENT(TX_RETRY, retries, 0, backoff);
+  tsRetryAt = millis() + backoff;
+  state = TX_BACKOFF;
+  intLEDOff(); // Back on with the next main loop, a short blink
+}
+
+void CRF24Manager::releaseBurst(uint8_t count) {
+  for (uint8_t i = 0; i < count; i++) {
+    vedProvider->releaseMessage(burst[i]);
+  }
+  for (uint8_t i = count; i < burstCount; i++) {
+    burst[i - count] = burst[i];
+  }
+  burstCount -= count;
+}
+
+void CRF24Manager::readAcks() {
+  #ifdef RF24_ACK_MODE
+    const uint32_t deviceId = CONFIG_getDeviceId();
+    while (radio->available()) {
+      uint8_t payload[32];
+      const uint8_t size = radio->getDynamicPayloadSize(); // 0 after a corrupt length, the RX FIFO is flushed then
+      if (size == 0) {
+        break;
+      }
+      radio->read(payload, size);
+      r24_command_t command;
+      if (RF24_readCommand(payload, size, deviceId, &command) && command.seq != commandSeq) {
+        commandSeq = command.seq; // The gateway repeats it with later ACKs
+        applyCommand(command);
+      }
+    }
+  #endif
+}
+
+void CRF24Manager::applyCommand(const r24_command_t &command) {
+  TRACE_EVENT(COMMAND, command.command, command.seq, command.value);
+  switch (command.command) {
+    case RF24_COMMAND_SLEEP:
+      if (command.value > RF24_MAX_INTERVAL_SEC) {
+        Log.warningln(F("Ignored sleep interval of %u sec, longer than %u sec"), command.value, RF24_MAX_INTERVAL_SEC);
+        break;
+      }
+      slots.setInterval(command.value);
+      CONFIG_retainedSave(&slotState, sizeof(slotState), RETAINED_BLOCK_SLOTS);
+      Log.noticeln(F("Sleep interval set to %u sec, slot %u"), slotState.intervalSec, slots.getSlot());
+      break;
+    case RF24_COMMAND_SLOT:
+      slots.setSlot(command.value);
+      CONFIG_retainedSave(&slotState, sizeof(slotState), RETAINED_BLOCK_SLOTS);
+      Log.noticeln(F("Moved to slot %u"), slots.getSlot());
+      break;
+    default:
+      if (!vedProvider->commandEvent(command.command, command.value)) {
+        Log.warningln(F("Ignored command %i"), command.command);
+      }
+  }
+}
+
+uint8_t CRF24Manager::getLiveCount() {
+  const int live = transmittedCount + burstCount - vedProvider->getBacklogCount();
+  return live > 0 ? live : 0;
+}
+
+void CRF24Manager::failBurst() {
+  for (uint8_t i = 0; i < burstCount; i++) {
+    vedProvider->failedMessage(burst[i]);
+  }
+  burstCount = 0;
+}
+
 void CRF24Manager::powerDown() {
   jobDone = true;
+  failBurst(); // Only left over while backing off
+  state = TX_COLLECT;
   #ifdef RADIO_RF24
     radio->powerDown();
   #endif
+  #ifdef RF24_TX_SLOTS
+    if (slots.endWake(random(0x7FFFFFFF))) {
+      Log.noticeln(F("Channel busy in slot, moving to slot %u"), slots.getSlot());
+    }
+    CONFIG_retainedSave(&slotState, sizeof(slotState), RETAINED_BLOCK_SLOTS);
+  #endif
+}
+
+uint32_t CRF24Manager::getSleepMs() {
+  #ifdef RF24_TX_SLOTS
+    uint32_t ms = slots.getSleepMs(CONFIG_getClockMs());
+    TRACE_EVENT(SLOT, slots.getSlot(), slotState.moves, ms);
+  #else
+    uint32_t ms = slots.getIntervalMs();
+  #endif
+  // An interval retained from an older build can still be too long for the platform
+  return ms < DEEP_SLEEP_MAX_SEC * 1000UL ? ms : DEEP_SLEEP_MAX_SEC * 1000UL;
 }
 
 void CRF24Manager::powerUp() {
@@ -137,6 +389,7 @@ void CRF24Manager::powerUp() {
   tMillis = millis();
   retries = 0;
   transmittedCount = 0;
+  tsFirstPacket = tsLastPacket = 0;
   #ifdef RADIO_RF24
     radio->powerUp();
   #endif
@@ -2,21 +2,55 @@
 
 #include <RF24.h>
 
+#include "Configuration.h"
 #include "BaseManager.h"
 #include "VEDMessageProvider.h"
+#include "RF24Slots.h"
+#include "RF24Command.h"
+
+#define RF24_TX_FIFO_DEPTH 3
 
 class CRF24Manager: public CBaseManager {
 
 private:
-  unsigned long tMillis, tsLastTransmit;
+  enum TransmitState {
+    TX_COLLECT,   // Polling the provider for the next burst
+    TX_BACKOFF    // Burst failed, resent once tsRetryAt passed
+  };
+
+  unsigned long tMillis, tsLastTransmit, tsRetryAt;
+  unsigned long tsFirstPacket, tsLastPacket; // micros()
   uint8_t retries;
   bool error;
+  TransmitState state;
+
+  CBaseMessage *burst[RF24_TX_FIFO_DEPTH];
+  uint8_t burstCount;
 
   RF24 *radio;
 
   IVEDMessageProvider *vedProvider;
   bool jobDone;
   uint8_t transmittedCount;
+  uint8_t commandSeq;     // Of the last command applied
+
+  CRF24Slots slots;
+
+  // Listens before a burst, only with RF24_TX_SLOTS
+  bool isChannelBusy();
+  void transmitBurst();
+  // Releases the first count messages of the burst, the rest move up
+  void releaseBurst(uint8_t count);
+  void failBurst();
+  // Commands in the ACK payloads received, only with RF24_ACK_MODE
+  void readAcks();
+  void applyCommand(const r24_command_t &command);
+  // Without acknowledgements, sent MSGS_TO_TRANSMIT_BEFORE_DONE times what there is
+  bool isRepetitionDone();
+  // Nothing left to send this wake
+  bool isDelivered();
+  // Messages with current data sent or queued since power up, backlog resent from earlier wakes excluded
+  uint8_t getLiveCount();
     
 public:
 	CRF24Manager(IVEDMessageProvider *vedProvider);
@@ -28,4 +62,11 @@ public:
   virtual void powerUp();
   virtual const bool isJobDone() { return jobDone; }
   virtual const bool isError() { return error; }
+  virtual const uint32_t getIdleMs();
+
+  // Until the next wake, in this node's slot with RF24_TX_SLOTS, valid after powerDown(). The
+  // gateway can change the interval (RF24Command.h).
+  uint32_t getSleepMs();
+  // Microseconds from the first to the last packet sent since power up
+  unsigned long getTransmitTime() const { return tsLastPacket - tsFirstPacket; }
 };
@@ -0,0 +1,22 @@
+#include <Arduino.h>
+
+#include "RF24Message_LOG.h"
+
+CRF24Message_LOG::CRF24Message_LOG(uint8_t pipe, const r24_message_log_marker_t &marker)
+:CBaseMessage(pipe), length(sizeof(marker)), replay(false) {
+  memcpy(buffer, &marker, sizeof(marker));
+}
+
+CRF24Message_LOG::CRF24Message_LOG(uint8_t pipe, const ved_log_record_t &record)
+:CBaseMessage(pipe), length(record.length), replay(true) {
+  memcpy(buffer, record.payload, record.length);
+}
+
+const String CRF24Message_LOG::getString() {
+  if (replay) {
+    return String("LOG replay ID=") + String(buffer[0], HEX) + String(" ") + String(length) + String(" bytes");
+  }
+  r24_message_log_marker_t marker;
+  memcpy(&marker, buffer, sizeof(marker));
+  return String("LOG age=") + String(marker.age) + String("s count=") + String(marker.count);
+}
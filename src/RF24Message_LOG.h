@@ -0,0 +1,35 @@
+#pragma once
+
+#include "BaseMessage.h"
+#include "VEDirectLog.h"
+
+#define MSG_LOG_MARKER_ID 0xB3
+#define MSG_LOG_AGE_UNKNOWN 0xFFFFFFFF
+
+// Precedes payloads resent from the store-and-forward log, they are count radio payloads
+// exactly as they failed to go out age seconds ago
+typedef struct r24_message_log_marker_t {
+  uint8_t id;
+  uint32_t age;   // MSG_LOG_AGE_UNKNOWN when logged before a power loss
+  uint8_t count;
+} __attribute__((packed)) r24_message_log_marker_t;
+
+// Backlog marker or a payload resent from the log, see VEDirectLog.h
+class CRF24Message_LOG: public CBaseMessage {
+
+private:
+  uint8_t buffer[VED_LOG_MAX_PAYLOAD];
+  uint8_t length;
+  bool replay;
+
+public:
+  CRF24Message_LOG(uint8_t pipe, const r24_message_log_marker_t &marker);
+  CRF24Message_LOG(uint8_t pipe, const ved_log_record_t &record);
+
+  // A logged payload rather than a marker
+  bool isReplay() const { return replay; }
+
+  virtual const void* getMessageBuffer() { return buffer; }
+  virtual const uint8_t getMessageLength() { return length; }
+  virtual const String getString();
+};
@@ -0,0 +1,28 @@
+#include <Arduino.h>
+
+#include "RF24Message_PHASES.h"
+
+static_assert(sizeof(r24_message_phase_trace_t) <= 32, "Phase trace message exceeds the radio payload");
+
+CRF24Message_PHASES::CRF24Message_PHASES(uint8_t pipe, const r24_message_phase_trace_t &msg)
+:CBaseMessage(pipe), msg(msg) {
+}
+
+CRF24Message_PHASES::CRF24Message_PHASES(uint8_t pipe, const trace_state_t &stats)
+:CBaseMessage(pipe) {
+  msg.id = MSG_PHASE_TRACE_ID;
+  msg.cycles = stats.cycles;
+  for (uint8_t p = 0; p < PHASE_COUNT; p++) {
+    const trace_phase_stats_t &phase = stats.phases[p];
+    msg.avg[p] = phase.count > 0 ? phase.sum / phase.count : 0;
+    msg.max[p] = phase.max;
+  }
+}
+
+const String CRF24Message_PHASES::getString() {
+  String s = String("PHASES cycles=") + String(msg.cycles);
+  for (uint8_t p = 0; p < PHASE_COUNT; p++) {
+    s += String(" ") + String(TRACE_phaseName(p)) + String("=") + String(msg.avg[p]) + String("/") + String(msg.max[p]);
+  }
+  return s;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "BaseMessage.h"
+#include "PhaseTrace.h"
+
+#define MSG_PHASE_TRACE_ID 0xB1
+
+typedef struct r24_message_phase_trace_t {
+  uint8_t id;
+  uint16_t cycles;
+  uint16_t avg[PHASE_COUNT];  // ms from reset or wake
+  uint16_t max[PHASE_COUNT];
+} __attribute__((packed)) r24_message_phase_trace_t;
+
+// Wake cycle timing statistics of this node, see PhaseTrace.h
+class CRF24Message_PHASES: public CBaseMessage {
+
+private:
+  r24_message_phase_trace_t msg;
+
+public:
+  CRF24Message_PHASES(uint8_t pipe, const r24_message_phase_trace_t &msg);
+  CRF24Message_PHASES(uint8_t pipe, const trace_state_t &stats);
+
+  virtual const void* getMessageBuffer() { return &msg; }
+  virtual const uint8_t getMessageLength() { return sizeof(msg); }
+  virtual const String getString();
+};
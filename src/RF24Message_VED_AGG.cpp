@@ -0,0 +1,46 @@
+#include <Arduino.h>
+
+#include "RF24Message_VED_AGG.h"
+
+static_assert(sizeof(r24_message_ved_agg_t) <= 32, "Aggregate message exceeds the radio payload");
+
+static int16_t clamp16(int32_t value) {
+  return value > INT16_MAX ? INT16_MAX : (value < INT16_MIN ? INT16_MIN : value);
+}
+
+// Through a copy, the packed fields may be unaligned and Cortex-M0 faults on unaligned stores
+static void packStat(void *out, const ved_stat_t &stat, uint16_t samples, int32_t scale) {
+  const int16_t values[3] = {
+    clamp16(stat.min / scale),
+    clamp16(CVEDAggregator::mean(stat, samples) / scale),
+    clamp16(stat.max / scale)
+  };
+  memcpy(out, values, sizeof(values));
+}
+
+CRF24Message_VED_AGG::CRF24Message_VED_AGG(uint8_t pipe, const r24_message_ved_agg_t &msg)
+:CBaseMessage(pipe), msg(msg) {
+}
+
+CRF24Message_VED_AGG::CRF24Message_VED_AGG(uint8_t pipe, const ved_aggregate_t &aggregate)
+:CBaseMessage(pipe) {
+  msg.id = MSG_VED_AGG_ID;
+  msg.pid = aggregate.pid;
+  msg.samples = aggregate.samples > UINT8_MAX ? UINT8_MAX : aggregate.samples;
+  const uint32_t seconds = (aggregate.lastMs - aggregate.firstMs + 500) / 1000;
+  msg.seconds = seconds > UINT16_MAX ? UINT16_MAX : seconds;
+  packStat(msg.v, aggregate.voltage, aggregate.samples, 10);
+  packStat(msg.i, aggregate.current, aggregate.samples, 10);
+  packStat(msg.p, aggregate.power, aggregate.samples, 1);
+  msg.energy = CVEDAggregator::energyMWh(aggregate);
+  msg.charge = CVEDAggregator::chargeMAh(aggregate);
+}
+
+const String CRF24Message_VED_AGG::getString() {
+  String s = String("AGG PID=") + String(msg.pid, HEX) + String(" n=") + String(msg.samples) + String(" t=") + String(msg.seconds) + String("s");
+  s += String(" V=") + String(msg.v[0] / 100.0) + String("/") + String(msg.v[1] / 100.0) + String("/") + String(msg.v[2] / 100.0);
+  s += String(" I=") + String(msg.i[0] / 100.0) + String("/") + String(msg.i[1] / 100.0) + String("/") + String(msg.i[2] / 100.0);
+  s += String(" P=") + String(msg.p[0]) + String("/") + String(msg.p[1]) + String("/") + String(msg.p[2]);
+  s += String(" E=") + String(msg.energy) + String("mWh Q=") + String(msg.charge) + String("mAh");
+  return s;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "BaseMessage.h"
+#include "VEDirectAggregate.h"
+
+#define MSG_VED_AGG_ID 0xB2
+
+typedef struct r24_message_ved_agg_t {
+  uint8_t id;
+  uint16_t pid;
+  uint8_t samples;      // Saturates at 255
+  uint16_t seconds;     // Window length
+  int16_t v[3];         // min, mean, max in 10 mV
+  int16_t i[3];         // min, mean, max in 10 mA
+  int16_t p[3];         // min, mean, max in W, panel power for MPPT, VA for inverters
+  int32_t energy;       // mWh
+  int32_t charge;       // mAh
+} __attribute__((packed)) r24_message_ved_agg_t;
+
+// Statistics of one device over a reporting window, see VEDirectAggregate.h
+class CRF24Message_VED_AGG: public CBaseMessage {
+
+private:
+  r24_message_ved_agg_t msg;
+
+public:
+  CRF24Message_VED_AGG(uint8_t pipe, const r24_message_ved_agg_t &msg);
+  CRF24Message_VED_AGG(uint8_t pipe, const ved_aggregate_t &aggregate);
+
+  virtual const void* getMessageBuffer() { return &msg; }
+  virtual const uint8_t getMessageLength() { return sizeof(msg); }
+  virtual const String getString();
+};
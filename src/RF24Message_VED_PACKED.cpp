@@ -0,0 +1,32 @@
+#include <Arduino.h>
+
+#include "RF24Message_VED_PACKED.h"
+
+CRF24Message_VED_PACKED::CRF24Message_VED_PACKED(uint8_t pipe, const CVEDPackedWriter &writer)
+:CBaseMessage(pipe), length(writer.getLength()) {
+  memcpy(buffer, writer.getBuffer(), length);
+}
+
+CRF24Message_VED_PACKED::CRF24Message_VED_PACKED(uint8_t pipe, const void *buffer, uint8_t length)
+:CBaseMessage(pipe), length(length < VED_PACKED_MAX_SIZE ? length : VED_PACKED_MAX_SIZE) {
+  memcpy(this->buffer, buffer, this->length);
+}
+
+const String CRF24Message_VED_PACKED::getString() {
+  CVEDPackedReader reader(buffer, length);
+  if (!reader.isValid()) {
+    return String("PACKED invalid");
+  }
+  String s = String("PACKED T=") + String(reader.getTemperature(), 1);
+  ved_snapshot_t snapshot;
+  while (reader.next(&snapshot)) {
+    s += String(" [") + String(snapshot.deviceClass) + String(":") + String(snapshot.pid, HEX);
+    for (uint8_t f = 0; f < VED_schema(snapshot.deviceClass)->count; f++) {
+      if (snapshot.present & (1 << f)) {
+        s += String(" ") + String(snapshot.raw[f]);
+      }
+    }
+    s += String("]");
+  }
+  return s;
+}
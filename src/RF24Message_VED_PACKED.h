@@ -0,0 +1,20 @@
+#pragma once
+
+#include "BaseMessage.h"
+#include "VEDirectPacked.h"
+
+// Several VE.Direct device snapshots in one radio payload, see VEDirectPacked.h for the layout
+class CRF24Message_VED_PACKED: public CBaseMessage {
+
+private:
+  uint8_t buffer[VED_PACKED_MAX_SIZE];
+  uint8_t length;
+
+public:
+  CRF24Message_VED_PACKED(uint8_t pipe, const CVEDPackedWriter &writer);
+  CRF24Message_VED_PACKED(uint8_t pipe, const void *buffer, uint8_t length);
+
+  virtual const void* getMessageBuffer() { return buffer; }
+  virtual const uint8_t getMessageLength() { return length; }
+  virtual const String getString();
+};
@@ -0,0 +1,122 @@
+#include <string.h>
+
+#include "RF24Parity.h"
+
+// CRC-8 without the trailing zeros, which static payloads and the body pad members with
+static uint8_t memberCrc(const uint8_t *data, uint8_t length) {
+  while (length > 0 && data[length - 1] == 0) {
+    length--;
+  }
+  uint8_t crc = 0;
+  while (length--) {
+    crc ^= *data++;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+void CRF24ParityEncoder::begin() {
+  memset(buffer, 0, sizeof(buffer));
+  buffer[0] = MSG_PARITY_ID;
+  count = 0;
+  length = 0;
+}
+
+bool CRF24ParityEncoder::add(const void *payload, uint8_t size) {
+  if (size > RF24_PARITY_MAX_MEMBER || count == RF24_PARITY_MAX_COUNT) {
+    return false;
+  }
+  const uint8_t *p = static_cast<const uint8_t*>(payload);
+  uint8_t *body = buffer + RF24_PARITY_HEADER_SIZE;
+  for (uint8_t i = 0; i < size; i++) {
+    body[i] ^= p[i];
+  }
+  if (size > length) {
+    length = size;
+  }
+  count++;
+  buffer[1] = count << 5 | length;
+  buffer[2] ^= memberCrc(p, size);
+  return true;
+}
+
+CRF24ParityDecoder::CRF24ParityDecoder()
+:head(0), stored(0) {
+  memset(members, 0, sizeof(members));
+}
+
+void CRF24ParityDecoder::add(const uint8_t *payload, uint8_t size, uint32_t now) {
+  member_t &member = members[head];
+  head = (head + 1) % RF24_PARITY_MAX_COUNT;
+  if (stored < RF24_PARITY_MAX_COUNT) {
+    stored++;
+  }
+  // Up to the last byte that isn't zero padding, longer payloads can't be members
+  uint8_t used = size;
+  while (used > 0 && payload[used - 1] == 0) {
+    used--;
+  }
+  member.size = used;
+  memset(member.payload, 0, sizeof(member.payload));
+  memcpy(member.payload, payload, used < RF24_PARITY_MAX_MEMBER ? used : RF24_PARITY_MAX_MEMBER);
+  member.ms = now;
+}
+
+bool CRF24ParityDecoder::rebuild(const uint8_t *parity, uint8_t paritySize, uint32_t now, uint8_t *payload, uint8_t size) {
+  // The members since the last parity, newest first
+  const member_t *recent[RF24_PARITY_MAX_COUNT];
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < stored; i++) {
+    const member_t &member = members[(head + RF24_PARITY_MAX_COUNT - 1 - i) % RF24_PARITY_MAX_COUNT];
+    if (now - member.ms > RF24_PARITY_WINDOW_MS) {
+      break;
+    }
+    recent[n++] = &member;
+  }
+  stored = 0; // Next group
+
+  if (paritySize < RF24_PARITY_HEADER_SIZE) {
+    return false;
+  }
+  const uint8_t count = parity[1] >> 5;
+  const uint8_t length = parity[1] & 0x1F;
+  if (count == 0 || count > RF24_PARITY_MAX_COUNT || length > RF24_PARITY_MAX_MEMBER
+      || paritySize < RF24_PARITY_HEADER_SIZE + length || size < length) {
+    return false;
+  }
+
+  // All of them arrived, unless the newest are a lost group's members and this group's are missing
+  uint8_t check = 0;
+  bool fit = n >= count;
+  for (uint8_t i = 0; i < count && fit; i++) {
+    fit = recent[i]->size <= length;
+    check ^= memberCrc(recent[i]->payload, length);
+  }
+  if (fit && check == parity[2]) {
+    return false;
+  }
+  if (n + 1 < count) {
+    return false; // More than one is missing
+  }
+
+  uint8_t rebuilt[RF24_PARITY_MAX_MEMBER];
+  memcpy(rebuilt, parity + RF24_PARITY_HEADER_SIZE, length);
+  check = 0;
+  for (uint8_t i = 0; i + 1 < count; i++) {
+    if (recent[i]->size > length) {
+      return false;
+    }
+    for (uint8_t b = 0; b < length; b++) {
+      rebuilt[b] ^= recent[i]->payload[b];
+    }
+    check ^= memberCrc(recent[i]->payload, length);
+  }
+  if ((check ^ memberCrc(rebuilt, length)) != parity[2]) {
+    return false;
+  }
+  memset(payload, 0, size);
+  memcpy(payload, rebuilt, length);
+  return true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+
+// XOR parity over the payloads of a burst (RF24_PARITY), so the receiver can rebuild any one of
+// them that was lost without the node sending every payload again.
+//
+//   id      MSG_PARITY_ID
+//   group   member count in the top 3 bits, body length in the low 5 bits
+//   check   XOR of the CRC-8 of every member over the body length
+//   body    XOR of the members, zero padded to the longest one
+//
+// Members are at most RF24_PARITY_MAX_MEMBER bytes, which covers every fixed layout message, so
+// the parity still fits one static payload. The receiver takes the payloads that arrived on the
+// pipe since the previous parity as the members. When all but one are there the missing one is
+// their XOR with the body, the check rejects a group mixed up with another node's payloads.
+
+#define MSG_PARITY_ID 0xB4
+#define RF24_PARITY_HEADER_SIZE 3
+#define RF24_PARITY_MAX_MEMBER 29 // 32 byte payload less the header
+#define RF24_PARITY_MAX_COUNT 4 // Members of a group, RF24_BURST_SIZE at most
+#define RF24_PARITY_WINDOW_MS 100 // Members arrive within this before their parity, a burst takes a few ms
+
+// Sending side, one group at a time
+class CRF24ParityEncoder {
+
+private:
+  uint8_t buffer[RF24_PARITY_HEADER_SIZE + RF24_PARITY_MAX_MEMBER];
+  uint8_t count;
+  uint8_t length;   // Of the body
+
+public:
+  CRF24ParityEncoder() { begin(); }
+
+  void begin();
+  // False for a member too long or one too many, the group can't cover it
+  bool add(const void *payload, uint8_t size);
+
+  uint8_t getCount() const { return count; }
+  const uint8_t* getBuffer() const { return buffer; }
+  uint8_t getLength() const { return RF24_PARITY_HEADER_SIZE + length; }
+};
+
+// Receiving side, one per pipe
+class CRF24ParityDecoder {
+
+private:
+  typedef struct {
+    uint8_t payload[RF24_PARITY_MAX_MEMBER];
+    uint8_t size;   // Without the zero padding, above RF24_PARITY_MAX_MEMBER for no member
+    uint32_t ms;
+  } member_t;
+
+  member_t members[RF24_PARITY_MAX_COUNT];
+  uint8_t head;     // Next one written
+  uint8_t stored;
+
+public:
+  CRF24ParityDecoder();
+
+  // Every payload but parities received on the pipe, a member of the next group maybe
+  void add(const uint8_t *payload, uint8_t size, uint32_t now);
+  // With a parity received, rebuilds the one member missing into payload, zero padded to size.
+  // False when none or more than one is missing, or the check fails. Starts the next group.
+  bool rebuild(const uint8_t *parity, uint8_t paritySize, uint32_t now, uint8_t *payload, uint8_t size);
+};
@@ -0,0 +1,75 @@
+#include "RF24Slots.h"
+
+CRF24Slots::CRF24Slots(rf24_slot_state_t *state, uint16_t defaultSec, uint32_t slotMs)
+:state(state), defaultSec(defaultSec), slotMs(slotMs), count(countOf(defaultSec, slotMs)), deviceId(0), fixed(-1), busy(false) {
+}
+
+uint16_t CRF24Slots::countOf(uint16_t intervalSec, uint32_t slotMs) {
+  const uint32_t slots = slotMs > 0 ? intervalSec * 1000UL / slotMs : 0;
+  return slots == 0 ? 1 : slots > 255 ? 255 : slots;
+}
+
+void CRF24Slots::begin(uint32_t deviceId, int16_t fixed) {
+  this->deviceId = deviceId;
+  this->fixed = fixed;
+  busy = false;
+  count = countOf(state->intervalSec, slotMs);
+  if (state->intervalSec != 0 && state->slot < count) {
+    return;
+  }
+  state->intervalSec = defaultSec;
+  state->moves = 0;
+  pickSlot();
+}
+
+void CRF24Slots::setInterval(uint16_t sec) {
+  state->intervalSec = sec == 0 ? defaultSec : sec;
+  pickSlot();
+}
+
+void CRF24Slots::setSlot(uint16_t slot) {
+  state->slot = slot % count;
+}
+
+void CRF24Slots::pickSlot() {
+  count = countOf(state->intervalSec, slotMs);
+  state->slot = fixed >= 0 ? fixed % count : slotOf(deviceId, count);
+}
+
+// Ids of the same chip series differ in a few low bits, mixed so neighbours land apart
+uint16_t CRF24Slots::slotOf(uint32_t deviceId, uint16_t count) {
+  uint32_t h = deviceId;
+  h ^= h >> 16;
+  h *= 0x45D9F3B;
+  h ^= h >> 16;
+  h *= 0x45D9F3B;
+  h ^= h >> 16;
+  return h % count;
+}
+
+bool CRF24Slots::endWake(uint32_t random) {
+  const bool move = busy && count > 1;
+  busy = false;
+  if (!move) {
+    return false;
+  }
+  state->slot = (state->slot + 1 + random % (count - 1)) % count;
+  if (state->moves < 255) {
+    state->moves++;
+  }
+  return true;
+}
+
+uint32_t CRF24Slots::getSleepMs(uint64_t clockMs) const {
+  const uint32_t intervalMs = getIntervalMs();
+  if (intervalMs == 0) {
+    return 0;
+  }
+  const uint32_t phase = clockMs % intervalMs;
+  const uint32_t start = static_cast<uint32_t>(state->slot) * slotMs;
+  uint32_t sleep = start >= phase ? start - phase : intervalMs - phase + start;
+  if (sleep < intervalMs / 2) {
+    sleep += intervalMs; // Just past its slot or woke early, the next one is too close
+  }
+  return sleep;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+
+// Transmit slots for nodes sharing RF24_CHANNEL without acknowledgements (RF24_TX_SLOTS).
+//
+// The sleep interval is split into slots of RF24_SLOT_MS. Instead of sleeping a fixed interval
+// after its last transmission, a node sleeps until the start of its own slot in the next interval.
+// Wakes are anchored to the retained clock, so the varying awake time no longer shifts the phase
+// from one cycle to the next. Only the drift of the sleep timer does, and the guard time left in
+// the slot absorbs that for a while. The first slot is derived from the device id, so nodes
+// booted together spread over the interval from their second wake on.
+//
+// A channel found busy before a burst means another node shares the slot or drifted into it.
+// After such a wake the node moves to a random other slot for the next interval.
+//
+// The state also keeps the sleep interval, which the gateway can change (RF24Command.h), so the
+// node builds CRF24Slots with or without RF24_TX_SLOTS.
+
+typedef struct rf24_slot_state_t {
+  uint8_t slot;
+  uint8_t moves;    // Slot changes after a busy channel, saturates at 255
+  uint16_t intervalSec; // 0 marks a state to start over with the default interval
+} rf24_slot_state_t;
+
+class CRF24Slots {
+
+private:
+  rf24_slot_state_t *state;
+  uint16_t defaultSec;
+  uint32_t slotMs;
+  uint16_t count;
+  uint32_t deviceId;
+  int16_t fixed;
+  bool busy;
+
+  static uint16_t countOf(uint16_t intervalSec, uint32_t slotMs);
+  void pickSlot();
+
+public:
+  CRF24Slots(rf24_slot_state_t *state, uint16_t defaultSec, uint32_t slotMs);
+
+  // Keeps a valid retained state, else starts the default interval in fixed when >= 0 or in the slot of deviceId
+  void begin(uint32_t deviceId, int16_t fixed);
+  // New sleep interval, 0 for the default, the slot is picked again for the new count
+  void setInterval(uint16_t sec);
+  // Moves to the slot, modulo the count
+  void setSlot(uint16_t slot);
+  // Another transmission heard during this wake
+  void reportBusy() { busy = true; }
+  // Ends the wake, after a busy channel moves to another slot picked by random, true if it moved
+  bool endWake(uint32_t random);
+  // Sleep from clockMs to the start of the slot, at least half an interval away
+  uint32_t getSleepMs(uint64_t clockMs) const;
+
+  uint16_t getSlot() const { return state->slot; }
+  uint16_t getCount() const { return count; }
+  uint32_t getIntervalMs() const { return state->intervalSec * 1000UL; }
+  bool isBusy() const { return busy; }
+
+  static uint16_t slotOf(uint32_t deviceId, uint16_t count);
+};
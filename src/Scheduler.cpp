@@ -0,0 +1,66 @@
+#include <Arduino.h>
+#include <ArduinoLog.h>
+
+#include "Scheduler.h"
+
+CScheduler::CScheduler()
+:count(0), busyMicros(0), idleMicros(0) {
+}
+
+void CScheduler::add(CBaseManager *manager) {
+  if (count < SCHEDULER_MAX_MANAGERS) {
+    managers[count++] = manager;
+  } else {
+    Log.errorln(F("Scheduler full, manager not added"));
+  }
+}
+
+void CScheduler::run() {
+  const unsigned long tsStart = micros();
+  for (uint8_t i = 0; i < count; i++) {
+    if (managers[i]->getIdleMs() == 0) {
+      managers[i]->loop();
+    }
+  }
+
+  uint32_t idleMs = SCHEDULER_MAX_IDLE_MS;
+  for (uint8_t i = 0; i < count && idleMs > 0; i++) {
+    const uint32_t ms = managers[i]->getIdleMs();
+    if (ms < idleMs) {
+      idleMs = ms;
+    }
+  }
+
+  const unsigned long tsIdle = micros();
+  busyMicros += tsIdle - tsStart;
+  if (idleMs > 0) {
+    idle(idleMs);
+    idleMicros += micros() - tsIdle;
+  }
+}
+
+void CScheduler::idle(uint32_t ms) {
+  #if defined(SEEED_XIAO_M0)
+    // Plain WFI in the lightest sleep, SysTick and the SERCOM interrupts wake the core.
+    // LowPower.deepSleep() leaves SLEEPDEEP set, which would turn this into standby.
+    SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+    PM->SLEEP.reg = PM_SLEEP_IDLE_CPU;
+    const unsigned long tsStart = millis();
+    while (millis() - tsStart < ms) {
+      __WFI();
+    }
+  #else
+    // The ESP cores idle the CPU inside delay() while the UART drivers keep receiving
+    delay(ms);
+  #endif
+}
+
+void CScheduler::resetStats() {
+  busyMicros = 0;
+  idleMicros = 0;
+}
+
+uint16_t CScheduler::getDutyCycle() const {
+  const unsigned long total = busyMicros + idleMicros;
+  return total == 0 ? 1000 : static_cast<uint16_t>((uint64_t)busyMicros * 1000 / total);
+}
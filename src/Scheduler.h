@@ -0,0 +1,32 @@
+#pragma once
+
+#include "BaseManager.h"
+
+#define SCHEDULER_MAX_MANAGERS 4
+#define SCHEDULER_MAX_IDLE_MS 100 // Longest single idle, keeps the main loop responsive
+
+// Runs only the managers whose deadline passed and idles the CPU until the nearest next one,
+// in a sleep state that keeps the UART and SPI interrupts able to wake it
+class CScheduler {
+
+private:
+  CBaseManager *managers[SCHEDULER_MAX_MANAGERS];
+  uint8_t count;
+  unsigned long busyMicros;
+  unsigned long idleMicros;
+
+  void idle(uint32_t ms);
+
+public:
+  CScheduler();
+
+  void add(CBaseManager *manager);
+  // One pass: loops the due managers, then idles until the next deadline
+  void run();
+  void resetStats();
+
+  unsigned long getBusyMicros() const { return busyMicros; }
+  unsigned long getIdleMicros() const { return idleMicros; }
+  // Share of the awake time spent running managers, in permille
+  uint16_t getDutyCycle() const;
+};
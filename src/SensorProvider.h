@@ -5,6 +5,13 @@
 class ISensorProvider {
 public:
   virtual float getTemperature(bool *current) { if (current != NULL) { *current = false; } return 0; }
+  // Sensors with several temperature probes, index 0 is the one getTemperature(current) reports
+  virtual uint8_t getTemperatureCount() { return 1; }
+  virtual float getTemperature(uint8_t index, bool *current) {
+    if (index == 0) { return getTemperature(current); }
+    if (current != NULL) { *current = false; }
+    return 0;
+  }
   virtual float getHumidity(bool *current) { if (current != NULL) { *current = false; } return 0; }
   virtual float getBaroPressure(bool *current) { if (current != NULL) { *current = false; } return 0; }
   virtual float getBatteryVoltage(bool *current) { if (current != NULL) { *current = false; } return 0; }
@@ -5,4 +5,18 @@
 class IVEDMessageProvider {
 public:
   virtual CBaseMessage* pollMessage();
+  // False when pollMessage() would return NULL, lets the consumer idle
+  virtual bool hasMessage() { return true; }
+  // Hands a polled message back once it is no longer needed
+  virtual void releaseMessage(CBaseMessage *msg) { delete msg; }
+  // Hands back a polled message the radio gave up on, instead of releaseMessage()
+  virtual void failedMessage(CBaseMessage *msg) { releaseMessage(msg); }
+  // Records consumed since power up without a message because nothing worth sending changed
+  virtual uint8_t getSuppressedCount() { return 0; }
+  // Messages polled since power up that resend the backlog of earlier wakes rather than current data
+  virtual uint8_t getBacklogCount() { return 0; }
+  // With acknowledgements (RF24_ACK_MODE), every record of this wake was acked and nothing more is expected
+  virtual bool isAllDelivered() { return false; }
+  // Downlink command from the gateway that isn't about the radio (RF24Command.h), false if not handled
+  virtual bool commandEvent(uint8_t command, uint32_t value) { return false; }
 };
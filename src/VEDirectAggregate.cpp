@@ -0,0 +1,128 @@
+#include <string.h>
+
+#include "VEDirectAggregate.h"
+
+#define VED_NO_FIELD 0xFF
+
+static_assert(VED_AGGREGATE_SOURCES <= 8, "One bit per source in taken");
+
+// Schema fields feeding voltage, current and power per device class
+static const uint8_t aggregateFields[VED_CLASS_COUNT][3] = {
+  { VED_NO_FIELD, VED_NO_FIELD, VED_NO_FIELD },         // NONE
+  { VED_MPPT_V, VED_MPPT_I, VED_MPPT_PPV },             // MPPT, panel power
+  { VED_INV_V, VED_NO_FIELD, VED_INV_AC_OUT_S },        // INV, apparent power
+  { VED_BATT_V, VED_BATT_I, VED_BATT_P },               // BATT
+  { VED_NO_FIELD, VED_NO_FIELD, VED_NO_FIELD }          // BATT_SUP, history only
+};
+
+static void statAdd(ved_stat_t &stat, int32_t value, bool first) {
+  if (first || value < stat.min) {
+    stat.min = value;
+  }
+  if (first || value > stat.max) {
+    stat.max = value;
+  }
+  stat.sum += value;
+}
+
+CVEDAggregator::CVEDAggregator() {
+  clear();
+}
+
+void CVEDAggregator::clear() {
+  memset(sources, 0, sizeof(sources));
+  taken = 0;
+}
+
+void CVEDAggregator::add(const ved_snapshot_t &snapshot, uint32_t now) {
+  if (snapshot.deviceClass >= VED_CLASS_COUNT) {
+    return;
+  }
+  const uint8_t *fields = aggregateFields[snapshot.deviceClass];
+  uint16_t needed = 0;
+  for (uint8_t f = 0; f < 3; f++) {
+    if (fields[f] != VED_NO_FIELD) {
+      needed |= 1 << fields[f];
+    }
+  }
+  if (needed == 0 || (snapshot.present & needed) != needed) {
+    return; // Partial snapshots would skew min and mean
+  }
+
+  ved_aggregate_t *aggregate = NULL;
+  for (uint8_t i = 0; i < VED_AGGREGATE_SOURCES && aggregate == NULL; i++) {
+    if (sources[i].deviceClass == snapshot.deviceClass && sources[i].pid == snapshot.pid) {
+      aggregate = &sources[i];
+    }
+  }
+  if (aggregate == NULL) {
+    for (uint8_t i = 0; i < VED_AGGREGATE_SOURCES && aggregate == NULL; i++) {
+      if (sources[i].deviceClass == VED_CLASS_NONE) {
+        aggregate = &sources[i];
+        aggregate->deviceClass = snapshot.deviceClass;
+        aggregate->pid = snapshot.pid;
+        aggregate->firstMs = aggregate->lastMs = now;
+      }
+    }
+    if (aggregate == NULL) {
+      return;
+    }
+  } else if (now - aggregate->lastMs <= VED_AGGREGATE_MAX_GAP_MS) {
+    // Values hold until the next snapshot
+    const uint32_t dt = now - aggregate->lastMs;
+    aggregate->energy += static_cast<int64_t>(aggregate->lastPower) * dt;
+    aggregate->charge += static_cast<int64_t>(aggregate->lastCurrent) * dt;
+  }
+
+  const int32_t voltage = fields[0] != VED_NO_FIELD ? snapshot.raw[fields[0]] : 0;
+  const int32_t current = fields[1] != VED_NO_FIELD ? snapshot.raw[fields[1]] : 0;
+  const int32_t power = fields[2] != VED_NO_FIELD ? snapshot.raw[fields[2]] : 0;
+  aggregate->lastCurrent = current;
+  aggregate->lastPower = power;
+  aggregate->lastMs = now;
+  if (aggregate->samples == UINT16_MAX) {
+    return; // Means stay exact, only the integration goes on
+  }
+  const bool first = aggregate->samples == 0;
+  statAdd(aggregate->voltage, voltage, first);
+  statAdd(aggregate->current, current, first);
+  statAdd(aggregate->power, power, first);
+  aggregate->samples++;
+}
+
+bool CVEDAggregator::take(ved_aggregate_t *aggregate, uint32_t minWindowMs) {
+  for (uint8_t i = 0; i < VED_AGGREGATE_SOURCES; i++) {
+    if (isComplete(sources[i], minWindowMs)) {
+      *aggregate = sources[i];
+      taken |= 1 << i;
+      // The last values carry into the next window, so no interval goes unintegrated
+      ved_aggregate_t &next = sources[i];
+      memset(&next.voltage, 0, sizeof(next.voltage));
+      memset(&next.current, 0, sizeof(next.current));
+      memset(&next.power, 0, sizeof(next.power));
+      next.samples = 0;
+      next.firstMs = next.lastMs;
+      next.energy = next.charge = 0;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool CVEDAggregator::isReady(uint32_t minWindowMs) const {
+  for (uint8_t i = 0; i < VED_AGGREGATE_SOURCES; i++) {
+    if (isComplete(sources[i], minWindowMs)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool CVEDAggregator::isPending(uint32_t now) const {
+  for (uint8_t i = 0; i < VED_AGGREGATE_SOURCES; i++) {
+    if (sources[i].deviceClass != VED_CLASS_NONE && (taken & (1 << i)) == 0 && now - sources[i].lastMs <= VED_AGGREGATE_MAX_GAP_MS) {
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "VEDirectSchema.h"
+
+#define VED_AGGREGATE_SOURCES 2       // Devices aggregated at once, at most 8
+#define VED_AGGREGATE_MAX_GAP_MS 5000 // Longer gaps between snapshots are not integrated
+
+typedef struct ved_stat_t {
+  int32_t min;
+  int32_t max;
+  int64_t sum;
+} ved_stat_t;
+
+// Statistics of one device since its last report, TEXT protocol units
+typedef struct ved_aggregate_t {
+  uint8_t deviceClass;
+  uint16_t pid;
+  uint16_t samples;     // Snapshots in this window
+  uint32_t firstMs;
+  uint32_t lastMs;
+  ved_stat_t voltage;   // mV
+  ved_stat_t current;   // mA
+  ved_stat_t power;     // W
+  int64_t energy;       // W * ms
+  int64_t charge;       // mA * ms
+  int32_t lastCurrent;
+  int32_t lastPower;
+} ved_aggregate_t;
+
+// Running min/max/mean of voltage, current and power per device, plus the energy and charge
+// integrated over consecutive snapshots, in constant memory
+class CVEDAggregator {
+
+private:
+  ved_aggregate_t sources[VED_AGGREGATE_SOURCES]; // deviceClass VED_CLASS_NONE when free
+  uint8_t taken;        // Bit per source taken since clear()
+
+  static bool isComplete(const ved_aggregate_t &aggregate, uint32_t minWindowMs) {
+    return aggregate.samples > 0 && aggregate.lastMs - aggregate.firstMs >= minWindowMs;
+  }
+
+public:
+  CVEDAggregator();
+
+  // Device classes without voltage, current or power fields are ignored
+  void add(const ved_snapshot_t &snapshot, uint32_t now);
+  // Copies out and restarts a device whose window spans at least minWindowMs
+  bool take(ved_aggregate_t *aggregate, uint32_t minWindowMs);
+  // True when take() would copy out a device
+  bool isReady(uint32_t minWindowMs) const;
+  // A device seen since clear() wasn't taken yet and still sends, its first window is to come
+  bool isPending(uint32_t now) const;
+  void clear();
+
+  static int32_t mean(const ved_stat_t &stat, uint16_t samples) { return samples > 0 ? stat.sum / samples : 0; }
+  static int32_t energyMWh(const ved_aggregate_t &aggregate) { return aggregate.energy / 3600; }
+  static int32_t chargeMAh(const ved_aggregate_t &aggregate) { return aggregate.charge / 3600000; }
+};
@@ -0,0 +1,62 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include "VEDirectDeadband.h"
+
+CVEDDeadband::CVEDDeadband(ved_deadband_state_t *state, const ved_deadband_t *config)
+:state(state), config(config), deliveredNow(0) {
+}
+
+void CVEDDeadband::clear() {
+  memset(state, 0, sizeof(*state));
+  deliveredNow = 0;
+}
+
+uint8_t CVEDDeadband::find(const ved_snapshot_t &snapshot) const {
+  uint8_t s = 0;
+  while (s < VED_DEADBAND_SOURCES
+      && !(state->sources[s].deviceClass == snapshot.deviceClass && state->sources[s].pid == snapshot.pid)) {
+    s++;
+  }
+  return s;
+}
+
+bool CVEDDeadband::pass(const ved_snapshot_t &snapshot, uint32_t now) {
+  const ved_deadband_t &deadband = config[snapshot.deviceClass < VED_CLASS_COUNT ? snapshot.deviceClass : VED_CLASS_NONE];
+  const uint8_t s = find(snapshot);
+
+  bool changed = true;
+  if (s < VED_DEADBAND_SOURCES && deadband.heartbeatSec > 0
+      && !(deliveredNow & (1 << s))
+      && now - state->sources[s].sentAt < deadband.heartbeatSec
+      && state->sources[s].present == snapshot.present) {
+
+    changed = false;
+    const VEDSchema *schema = VED_schema(snapshot.deviceClass);
+    for (uint8_t f = 0; f < schema->count && !changed; f++) {
+      const int32_t band = deadband.band[schema->fields[f].unit];
+      const int32_t delta = labs(snapshot.raw[f] - state->sources[s].raw[f]);
+      changed = band == 0 ? delta != 0 : delta >= band;
+    }
+  }
+
+  if (!changed) {
+    state->stats.suppressed++;
+  }
+  return changed;
+}
+
+void CVEDDeadband::commit(const ved_snapshot_t &snapshot, uint32_t now) {
+  uint8_t s = find(snapshot);
+  if (s == VED_DEADBAND_SOURCES) {
+    s = state->next;
+    state->next = (state->next + 1) % VED_DEADBAND_SOURCES;
+  }
+  state->sources[s].deviceClass = snapshot.deviceClass;
+  state->sources[s].pid = snapshot.pid;
+  state->sources[s].present = snapshot.present;
+  state->sources[s].sentAt = now;
+  memcpy(state->sources[s].raw, snapshot.raw, sizeof(snapshot.raw));
+  state->stats.sent++;
+  deliveredNow |= 1 << s;
+}
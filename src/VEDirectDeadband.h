@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "VEDirectSchema.h"
+
+#define VED_DEADBAND_SOURCES 4 // Distinct sources (device class, PID) remembered
+static_assert(VED_DEADBAND_SOURCES <= 8, "Sources delivered in a wake are bits of a byte");
+
+// Per device class thresholds, a field counts as changed once it moved by at least its unit's band.
+// A band of 0 makes any change count.
+typedef struct ved_deadband_t {
+  int32_t band[VED_UNIT_COUNT];
+  uint32_t heartbeatSec;  // Send unchanged values at least this often, 0 - never suppress
+} ved_deadband_t;
+
+typedef struct ved_deadband_stats_t {
+  uint32_t sent;
+  uint32_t suppressed;
+} ved_deadband_stats_t;
+
+// Everything the filter needs to remember between wake cycles, kept in retained memory by the owner
+typedef struct ved_deadband_state_t {
+  struct {
+    uint8_t deviceClass;
+    uint16_t pid;
+    uint16_t present;
+    uint32_t sentAt;
+    int32_t raw[VED_SNAPSHOT_MAX_FIELDS];
+  } sources[VED_DEADBAND_SOURCES];
+  uint8_t next;               // Source slot replaced when a new one shows up
+  ved_deadband_stats_t stats;
+} ved_deadband_state_t;
+
+// Change driven transmission: passes a snapshot only when a field left the deadband around
+// the last value delivered for its source, or the heartbeat interval ran out. A source delivered
+// in this wake passes for the rest of it, so its repeated copies still go out.
+class CVEDDeadband {
+
+private:
+  ved_deadband_state_t *state;
+  const ved_deadband_t *config;   // Indexed by device class
+  uint8_t deliveredNow;           // Sources committed since newWake(), a bit per slot
+
+  uint8_t find(const ved_snapshot_t &snapshot) const;
+
+public:
+  CVEDDeadband(ved_deadband_state_t *state, const ved_deadband_t *config);
+
+  // True if the snapshot should be sent. Time in seconds.
+  bool pass(const ved_snapshot_t &snapshot, uint32_t now);
+  // Remembers a snapshot the radio delivered as the last one sent for its source
+  void commit(const ved_snapshot_t &snapshot, uint32_t now);
+  void newWake() { deliveredNow = 0; }
+  void clear();
+
+  const ved_deadband_stats_t& getStats() const { return state->stats; }
+};
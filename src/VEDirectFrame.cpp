@@ -0,0 +1,62 @@
+#include "VEDirectFrame.h"
+
+#define VED_LABEL_NAME(id, name, radix) name,
+static const char* const labelNames[VED_LABEL_COUNT] = {
+  VED_LABELS(VED_LABEL_NAME)
+};
+#undef VED_LABEL_NAME
+
+#define VED_LABEL_RADIX(id, name, radix) radix,
+static const uint8_t labelRadix[VED_LABEL_COUNT] = {
+  VED_LABELS(VED_LABEL_RADIX)
+};
+#undef VED_LABEL_RADIX
+
+VEDLabel VED_labelLookup(uint32_t hash, const char *name) {
+  VEDLabel label;
+  switch(hash) {
+    #define VED_LABEL_CASE(id, name, radix) case VED_labelHash(name): label = VED_LABEL_##id; break;
+    VED_LABELS(VED_LABEL_CASE)
+    #undef VED_LABEL_CASE
+    default:
+      return VED_LABEL_UNKNOWN;
+  }
+  // Guard against a foreign label colliding with a known hash
+  return strcmp(labelNames[label], name) == 0 ? label : VED_LABEL_UNKNOWN;
+}
+
+const char* VED_labelName(uint8_t label) {
+  return label < VED_LABEL_COUNT ? labelNames[label] : "?";
+}
+
+uint8_t VED_labelRadix(uint8_t label) {
+  return label < VED_LABEL_COUNT ? labelRadix[label] : 0;
+}
+
+void CVEDFrame::clear() {
+  memset(mOffset, 0xFF, sizeof(mOffset));
+  mArenaUsed = 0;
+  mRecords = 0;
+  mDropped = 0;
+}
+
+bool CVEDFrame::set(VEDLabel label, const char *text, uint8_t length, const CVEDValueDecoder &decoder) {
+  mRecords++;
+  if (label >= VED_LABEL_COUNT) {
+    return true;
+  }
+  if (mArenaUsed + length + 1 > VED_FRAME_ARENA_SIZE) {
+    mDropped++;
+    return false;
+  }
+  memcpy(mArena + mArenaUsed, text, length);
+  mArena[mArenaUsed + length] = 0;
+  mOffset[label] = mArenaUsed;
+  if (decoder.isNumeric()) {
+    mValue[label] = decoder.value();
+  } else {
+    mValue[label] = strcmp(text, "ON") == 0 ? 1 : 0;
+  }
+  mArenaUsed += length + 1;
+  return true;
+}
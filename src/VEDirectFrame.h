@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+// Fixed-capacity store for the records of a single VE.Direct TEXT frame.
+// Labels are resolved to a compile-time ID while the name streams in, values are
+// kept in a static arena, so parsing a frame never touches the heap.
+
+#define VED_FRAME_ARENA_SIZE 320  // Enough for ~25 records of typical length
+#define VED_FRAME_NO_VALUE 0xFFFF
+
+// Labels as they appear on the wire after upper-casing (see VE.Direct Protocol 3.33),
+// with the radix their value is decoded in while streaming (0 - text, ON/OFF maps to 1/0)
+#define VED_LABELS(X) \
+  X(V, "V", 10) X(V2, "V2", 10) X(V3, "V3", 10) X(VS, "VS", 10) X(VM, "VM", 10) X(DM, "DM", 10) \
+  X(VPV, "VPV", 10) X(PPV, "PPV", 10) X(I, "I", 10) X(I2, "I2", 10) X(I3, "I3", 10) X(IL, "IL", 10) \
+  X(LOAD, "LOAD", 0) X(T, "T", 10) X(P, "P", 10) X(CE, "CE", 10) X(SOC, "SOC", 10) X(TTG, "TTG", 10) \
+  X(ALARM, "ALARM", 0) X(RELAY, "RELAY", 0) X(AR, "AR", 10) X(OR, "OR", 16) \
+  X(H1, "H1", 10) X(H2, "H2", 10) X(H3, "H3", 10) X(H4, "H4", 10) X(H5, "H5", 10) X(H6, "H6", 10) \
+  X(H7, "H7", 10) X(H8, "H8", 10) X(H9, "H9", 10) X(H10, "H10", 10) X(H11, "H11", 10) X(H12, "H12", 10) \
+  X(H13, "H13", 10) X(H14, "H14", 10) X(H15, "H15", 10) X(H16, "H16", 10) X(H17, "H17", 10) X(H18, "H18", 10) \
+  X(H19, "H19", 10) X(H20, "H20", 10) X(H21, "H21", 10) X(H22, "H22", 10) X(H23, "H23", 10) \
+  X(ERR, "ERR", 10) X(CS, "CS", 10) X(BMV, "BMV", 0) X(FW, "FW", 0) X(FWE, "FWE", 0) X(PID, "PID", 16) \
+  X(SER, "SER#", 0) X(HSDS, "HSDS", 10) X(MODE, "MODE", 10) \
+  X(AC_OUT_V, "AC_OUT_V", 10) X(AC_OUT_I, "AC_OUT_I", 10) X(AC_OUT_S, "AC_OUT_S", 10) \
+  X(WARN, "WARN", 10) X(MPPT, "MPPT", 10) X(MON, "MON", 10) \
+  X(DC_IN_V, "DC_IN_V", 10) X(DC_IN_I, "DC_IN_I", 10) X(DC_IN_P, "DC_IN_P", 10) \
+  X(CHECKSUM, "CHECKSUM", 0)
+
+#define VED_LABEL_ENUM(id, name, radix) VED_LABEL_##id,
+enum VEDLabel : uint8_t {
+  VED_LABELS(VED_LABEL_ENUM)
+  VED_LABEL_COUNT,
+  VED_LABEL_UNKNOWN = 0xFF
+};
+#undef VED_LABEL_ENUM
+
+// FNV-1a, usable both at compile time (case labels) and byte by byte in the parser
+#define VED_LABEL_HASH_SEED 2166136261u
+constexpr uint32_t VED_labelHashStep(uint32_t h, uint8_t c) { return (h ^ c) * 16777619u; }
+constexpr uint32_t VED_labelHash(const char *s, uint32_t h = VED_LABEL_HASH_SEED) {
+  return *s ? VED_labelHash(s + 1, VED_labelHashStep(h, static_cast<uint8_t>(*s))) : h;
+}
+
+VEDLabel VED_labelLookup(uint32_t hash, const char *name);
+const char* VED_labelName(uint8_t label);
+uint8_t VED_labelRadix(uint8_t label);
+
+// Decodes a record value into an integer one byte at a time, as it is received
+class CVEDValueDecoder {
+
+private:
+  uint32_t mAcc;
+  uint8_t mRadix;
+  uint8_t mDigits;
+  bool mNegative;
+  bool mNumeric;
+
+public:
+  void begin(uint8_t radix) { mAcc = 0; mRadix = radix; mDigits = 0; mNegative = false; mNumeric = radix != 0; }
+  void step(uint8_t c) {
+    if (!mNumeric) {
+      return;
+    }
+    uint8_t d;
+    if (c >= '0' && c <= '9') {
+      d = c - '0';
+    } else if (c >= 'A' && c <= 'F') {
+      d = c - 'A' + 10;
+    } else if (c == '-' && mDigits == 0 && !mNegative) {
+      mNegative = true;
+      return;
+    } else if (c == 'X' && mRadix == 16 && mDigits == 1 && mAcc == 0) {
+      return; // 0x prefix
+    } else {
+      d = 0xFF;
+    }
+    if (d >= mRadix) {
+      mNumeric = false;
+      return;
+    }
+    mAcc = mAcc * mRadix + d;
+    mDigits++;
+  }
+  bool isNumeric() const { return mNumeric && mDigits > 0; }
+  int32_t value() const { return mNegative ? -static_cast<int32_t>(mAcc) : static_cast<int32_t>(mAcc); }
+};
+
+class CVEDFrame {
+
+private:
+  uint16_t mOffset[VED_LABEL_COUNT];
+  int32_t mValue[VED_LABEL_COUNT];
+  char mArena[VED_FRAME_ARENA_SIZE];
+  uint16_t mArenaUsed;
+  uint8_t mRecords;
+  uint8_t mDropped;
+
+public:
+  CVEDFrame() { clear(); }
+
+  void clear();
+  // Stores a record and its decoded value (unknown labels are only counted); returns false when the arena is exhausted
+  bool set(VEDLabel label, const char *text, uint8_t length, const CVEDValueDecoder &decoder);
+
+  bool has(VEDLabel label) const { return label < VED_LABEL_COUNT && mOffset[label] != VED_FRAME_NO_VALUE; }
+  // Value of the record or an empty string when the label was not received
+  const char* get(VEDLabel label) const { return has(label) ? mArena + mOffset[label] : ""; }
+  // Decoded value of the record or 0 when the label was not received
+  int32_t getInt(VEDLabel label) const { return has(label) ? mValue[label] : 0; }
+
+  uint8_t size() const { return mRecords; }
+  uint8_t dropped() const { return mDropped; }
+};
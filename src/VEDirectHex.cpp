@@ -0,0 +1,250 @@
+#include <string.h>
+
+#include "VEDirectHex.h"
+
+// Protocol https://www.victronenergy.com/upload/documents/VE.Direct-Protocol-3.33.pdf
+// and the per product "HEX protocol" register documents
+
+static const char hexDigits[] = "0123456789ABCDEF";
+
+static int8_t hexNibble(uint8_t c) {
+  if (c >= '0' && c <= '9') { return c - '0'; }
+  if (c >= 'A' && c <= 'F') { return c - 'A' + 10; }
+  if (c >= 'a' && c <= 'f') { return c - 'a' + 10; }
+  return -1;
+}
+
+CVEDirectHex::CVEDirectHex(IVEDHexHandler *handler)
+:handler(handler), rxActive(false), rxHighNibble(true), rxError(false), rxCommand(0), rxLength(0) {
+  memset(pending, 0, sizeof(pending));
+  memset(&stats, 0, sizeof(stats));
+}
+
+void CVEDirectHex::reset() {
+  memset(pending, 0, sizeof(pending));
+  rxActive = false;
+}
+
+uint8_t CVEDirectHex::getPendingCount() const {
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < VED_HEX_MAX_PENDING; i++) {
+    if (pending[i].active) { n++; }
+  }
+  return n;
+}
+
+int32_t CVEDirectHex::decodeValue(const uint8_t *data, uint8_t length, bool isSigned) {
+  if (length > 4) { length = 4; }
+  uint32_t v = 0;
+  for (uint8_t i = 0; i < length; i++) {
+    v |= static_cast<uint32_t>(data[i]) << (8 * i);
+  }
+  if (isSigned && length > 0 && length < 4 && (data[length - 1] & 0x80)) {
+    v |= 0xFFFFFFFFUL << (8 * length);
+  }
+  return static_cast<int32_t>(v);
+}
+
+uint8_t CVEDirectHex::encode(uint8_t command, const uint8_t *payload, uint8_t length, uint8_t *out) {
+  uint8_t n = 0;
+  uint8_t checksum = 0x55 - command;
+  out[n++] = ':';
+  out[n++] = hexDigits[command & 0x0F];
+  for (uint8_t i = 0; i < length; i++) {
+    out[n++] = hexDigits[payload[i] >> 4];
+    out[n++] = hexDigits[payload[i] & 0x0F];
+    checksum -= payload[i];
+  }
+  out[n++] = hexDigits[checksum >> 4];
+  out[n++] = hexDigits[checksum & 0x0F];
+  out[n++] = '\n';
+  return n;
+}
+
+bool CVEDirectHex::send(uint8_t command, uint16_t reg, const uint8_t *payload, uint8_t length, unsigned long now) {
+  int8_t slot = -1;
+  for (uint8_t i = 0; i < VED_HEX_MAX_PENDING; i++) {
+    if (!pending[i].active) { slot = i; break; }
+  }
+  if (slot < 0) {
+    return false;
+  }
+  pending[slot].active = true;
+  pending[slot].command = command;
+  pending[slot].reg = reg;
+  pending[slot].tSent = now;
+
+  uint8_t buffer[2 * (3 + VED_HEX_MAX_DATA) + 6];
+  handler->hexWrite(buffer, encode(command, payload, length, buffer));
+  stats.sent++;
+  return true;
+}
+
+bool CVEDirectHex::ping(unsigned long now) {
+  return send(VED_HEX_CMD_PING, 0, NULL, 0, now);
+}
+
+bool CVEDirectHex::productId(unsigned long now) {
+  return send(VED_HEX_CMD_PRODUCT_ID, 0, NULL, 0, now);
+}
+
+bool CVEDirectHex::get(uint16_t reg, unsigned long now) {
+  const uint8_t payload[3] = { static_cast<uint8_t>(reg & 0xFF), static_cast<uint8_t>(reg >> 8), 0 };
+  return send(VED_HEX_CMD_GET, reg, payload, sizeof(payload), now);
+}
+
+bool CVEDirectHex::set(uint16_t reg, const uint8_t *value, uint8_t length, unsigned long now) {
+  if (length > VED_HEX_MAX_DATA) {
+    return false;
+  }
+  uint8_t payload[3 + VED_HEX_MAX_DATA] = { static_cast<uint8_t>(reg & 0xFF), static_cast<uint8_t>(reg >> 8), 0 };
+  memcpy(payload + 3, value, length);
+  return send(VED_HEX_CMD_SET, reg, payload, 3 + length, now);
+}
+
+void CVEDirectHex::loop(unsigned long now) {
+  for (uint8_t i = 0; i < VED_HEX_MAX_PENDING; i++) {
+    if (pending[i].active && now - pending[i].tSent > VED_HEX_TIMEOUT_MS) {
+      stats.timeouts++;
+      complete(i, VED_HEX_TIMEOUT, NULL, 0);
+    }
+  }
+}
+
+void CVEDirectHex::complete(uint8_t slot, VEDHexStatus status, const uint8_t *data, uint8_t length) {
+  const uint8_t command = pending[slot].command;
+  const uint16_t reg = pending[slot].reg;
+  pending[slot].active = false;
+  handler->hexResponse(command, reg, status, data, length);
+}
+
+int8_t CVEDirectHex::findPending(uint8_t command, uint16_t reg, bool matchReg) const {
+  // Oldest matching request first, the device answers in order
+  int8_t found = -1;
+  for (uint8_t i = 0; i < VED_HEX_MAX_PENDING; i++) {
+    if (pending[i].active && (command == 0 || pending[i].command == command) && (!matchReg || pending[i].reg == reg)
+        && (found < 0 || static_cast<long>(pending[i].tSent - pending[found].tSent) < 0)) {
+      found = i;
+    }
+  }
+  return found;
+}
+
+bool CVEDirectHex::rxData(uint8_t inbyte) {
+  if (inbyte == ':') {
+    rxActive = true;
+    rxHighNibble = true;
+    rxError = false;
+    rxCommand = 0xFF;
+    rxLength = 0;
+    return false;
+  }
+  if (!rxActive) {
+    return true;
+  }
+
+  switch(inbyte) {
+    case '\n':
+      rxActive = false;
+      if (rxError || !rxHighNibble || rxCommand == 0xFF || rxLength == 0) {
+        stats.frameErrors++;
+      } else {
+        messageEvent();
+      }
+      return true;
+    case '\r':
+      return false;
+    default: {
+      const int8_t nibble = hexNibble(inbyte);
+      if (nibble < 0) {
+        // Not a HEX message after all, abandon it and resume TEXT parsing
+        stats.frameErrors++;
+        rxActive = false;
+        return true;
+      }
+      if (rxCommand == 0xFF) {
+        rxCommand = nibble;
+      } else if (rxLength >= VED_HEX_MAX_BYTES) {
+        rxError = true;
+      } else if (rxHighNibble) {
+        rxBuffer[rxLength] = nibble << 4;
+        rxHighNibble = false;
+      } else {
+        rxBuffer[rxLength++] |= nibble;
+        rxHighNibble = true;
+      }
+      return false;
+    }
+  }
+}
+
+void CVEDirectHex::messageEvent() {
+  uint8_t checksum = rxCommand;
+  for (uint8_t i = 0; i < rxLength; i++) {
+    checksum += rxBuffer[i];
+  }
+  if (checksum != 0x55) {
+    stats.frameErrors++;
+    return;
+  }
+  const uint8_t length = rxLength - 1; // Without checksum
+  int8_t slot = -1;
+
+  switch(rxCommand) {
+    case VED_HEX_RSP_GET:
+    case VED_HEX_RSP_SET:
+    case VED_HEX_RSP_ASYNC: {
+      if (length < 3) {
+        stats.frameErrors++;
+        return;
+      }
+      const uint16_t reg = rxBuffer[0] | (rxBuffer[1] << 8);
+      const uint8_t flags = rxBuffer[2];
+      if (rxCommand == VED_HEX_RSP_ASYNC) {
+        stats.async++;
+        handler->hexAsync(reg, rxBuffer + 3, length - 3);
+        return;
+      }
+      slot = findPending(rxCommand == VED_HEX_RSP_GET ? VED_HEX_CMD_GET : VED_HEX_CMD_SET, reg, true);
+      if (slot >= 0) {
+        VEDHexStatus status = VED_HEX_OK;
+        if (flags & 0x01) {
+          status = VED_HEX_UNKNOWN_ID;
+        } else if (flags & 0x02) {
+          status = VED_HEX_NOT_SUPPORTED;
+        } else if (flags & 0x04) {
+          status = VED_HEX_PARAM_ERROR;
+        }
+        stats.responses++;
+        complete(slot, status, rxBuffer + 3, length - 3);
+        return;
+      }
+      break;
+    }
+    case VED_HEX_RSP_PING:
+      slot = findPending(VED_HEX_CMD_PING, 0, false);
+      break;
+    case VED_HEX_RSP_DONE:
+      slot = findPending(VED_HEX_CMD_PRODUCT_ID, 0, false);
+      if (slot < 0) {
+        slot = findPending(VED_HEX_CMD_VERSION, 0, false);
+      }
+      break;
+    case VED_HEX_RSP_UNKNOWN:
+    case VED_HEX_RSP_ERROR:
+      slot = findPending(0, 0, false);
+      if (slot >= 0) {
+        stats.responses++;
+        complete(slot, VED_HEX_REJECTED, rxBuffer, length);
+        return;
+      }
+      break;
+  }
+
+  if (slot >= 0) {
+    stats.responses++;
+    complete(slot, VED_HEX_OK, rxBuffer, length);
+  } else {
+    stats.unmatched++;
+  }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stdint.h>
+
+// VE.Direct HEX protocol: framing, checksum and asynchronous request/response matching.
+// Messages are ':' + command nibble + payload bytes as hex pairs + checksum + '\n',
+// where command + payload bytes + checksum add up to 0x55.
+
+#define VED_HEX_MAX_PENDING 4
+#define VED_HEX_MAX_BYTES 36      // Payload bytes of a received message, including the checksum
+#define VED_HEX_MAX_DATA 8        // Value bytes of an outgoing Set
+#define VED_HEX_TIMEOUT_MS 250
+
+enum VEDHexCommand : uint8_t {
+  VED_HEX_CMD_PING = 0x1,
+  VED_HEX_CMD_VERSION = 0x3,
+  VED_HEX_CMD_PRODUCT_ID = 0x4,
+  VED_HEX_CMD_GET = 0x7,
+  VED_HEX_CMD_SET = 0x8
+};
+
+enum VEDHexResponse : uint8_t {
+  VED_HEX_RSP_DONE = 0x1,
+  VED_HEX_RSP_UNKNOWN = 0x3,
+  VED_HEX_RSP_ERROR = 0x4,
+  VED_HEX_RSP_PING = 0x5,
+  VED_HEX_RSP_GET = 0x7,
+  VED_HEX_RSP_SET = 0x8,
+  VED_HEX_RSP_ASYNC = 0xA
+};
+
+enum VEDHexStatus : uint8_t {
+  VED_HEX_OK,
+  VED_HEX_TIMEOUT,
+  VED_HEX_UNKNOWN_ID,
+  VED_HEX_NOT_SUPPORTED,
+  VED_HEX_PARAM_ERROR,
+  VED_HEX_REJECTED        // Device answered with "unknown command" or "frame error"
+};
+
+class IVEDHexHandler {
+public:
+  // Sends an encoded message to the device
+  virtual void hexWrite(const uint8_t *buffer, uint8_t length) = 0;
+  // Completion of a request, reg is 0 for commands without a register
+  virtual void hexResponse(uint8_t command, uint16_t reg, VEDHexStatus status, const uint8_t *data, uint8_t length) {};
+  // Register value pushed by the device without a request
+  virtual void hexAsync(uint16_t reg, const uint8_t *data, uint8_t length) {};
+};
+
+typedef struct ved_hex_stats_t {
+  uint32_t sent;
+  uint32_t responses;
+  uint32_t timeouts;
+  uint32_t frameErrors;   // Bad checksum, odd length or non hex characters
+  uint32_t unmatched;     // Valid responses without a pending request
+  uint32_t async;
+} ved_hex_stats_t;
+
+class CVEDirectHex {
+
+private:
+  typedef struct pending_t {
+    bool active;
+    uint8_t command;
+    uint16_t reg;
+    unsigned long tSent;
+  } pending_t;
+
+  IVEDHexHandler *handler;
+  pending_t pending[VED_HEX_MAX_PENDING];
+  ved_hex_stats_t stats;
+
+  bool rxActive;
+  bool rxHighNibble;
+  bool rxError;
+  uint8_t rxCommand;
+  uint8_t rxLength;
+  uint8_t rxBuffer[VED_HEX_MAX_BYTES];
+
+  bool send(uint8_t command, uint16_t reg, const uint8_t *payload, uint8_t length, unsigned long now);
+  void complete(uint8_t slot, VEDHexStatus status, const uint8_t *data, uint8_t length);
+  int8_t findPending(uint8_t command, uint16_t reg, bool matchReg) const;
+  void messageEvent();
+
+public:
+  CVEDirectHex(IVEDHexHandler *handler);
+
+  // Requests return false when all pending slots are taken
+  bool ping(unsigned long now);
+  bool productId(unsigned long now);
+  bool get(uint16_t reg, unsigned long now);
+  bool set(uint16_t reg, const uint8_t *value, uint8_t length, unsigned long now);
+
+  // Feeds a received byte, the first one being ':'; returns true once the message ended
+  bool rxData(uint8_t inbyte);
+  // Expires requests that were not answered in time
+  void loop(unsigned long now);
+  void reset();
+
+  uint8_t getPendingCount() const;
+  const ved_hex_stats_t& getStats() const { return stats; }
+
+  // Little endian register value of the given width, sign extended when requested
+  static int32_t decodeValue(const uint8_t *data, uint8_t length, bool isSigned);
+  // Writes a complete message into out (at least 2 * length + 10 bytes) and returns its length
+  static uint8_t encode(uint8_t command, const uint8_t *payload, uint8_t length, uint8_t *out);
+};
@@ -0,0 +1,223 @@
+#include <string.h>
+
+#include "VEDirectLog.h"
+
+static uint8_t crc8(uint8_t crc, const uint8_t *data, uint16_t length) {
+  while (length--) {
+    crc ^= *data++;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+CVEDLogRamStore::CVEDLogRamStore(uint8_t *memory, uint16_t size, uint16_t sectorSize)
+:memory(memory), size(size), sectorSize(sectorSize), erases(0) {
+}
+
+void CVEDLogRamStore::read(uint16_t address, void *data, uint16_t length) {
+  memcpy(data, memory + address, length);
+}
+
+void CVEDLogRamStore::program(uint16_t address, const void *data, uint16_t length) {
+  const uint8_t *bytes = static_cast<const uint8_t*>(data);
+  for (uint16_t i = 0; i < length; i++) {
+    memory[address + i] &= bytes[i];
+  }
+}
+
+void CVEDLogRamStore::erase(uint16_t sector) {
+  memset(memory + sector * sectorSize, 0xFF, sectorSize);
+  erases++;
+}
+
+CVEDLog::CVEDLog(IVEDLogStore *store)
+:store(store), sectorSize(0), sectors(0), head(0), tail(0), headFull(false), nextSeq(0), pending(0) {
+  memset(&stats, 0, sizeof(stats));
+}
+
+bool CVEDLog::readRecord(uint16_t address, ved_log_record_t *record, uint8_t *state) {
+  const uint16_t end = address - address % sectorSize + sectorSize;
+  if (address + VED_LOG_HEADER_SIZE > end) {
+    return false;
+  }
+  uint8_t header[VED_LOG_HEADER_SIZE];
+  store->read(address, header, sizeof(header));
+  if (header[0] != VED_LOG_MAGIC || header[1] > VED_LOG_MAX_PAYLOAD || address + VED_LOG_HEADER_SIZE + header[1] > end) {
+    return false;
+  }
+  record->length = header[1];
+  store->read(address + VED_LOG_HEADER_SIZE, record->payload, record->length);
+  if (crc8(crc8(0, header + 4, 6), record->payload, record->length) != header[3]) {
+    return false;
+  }
+  *state = header[2];
+  record->seq = header[4] | header[5] << 8;
+  record->clock = header[6] | header[7] << 8 | static_cast<uint32_t>(header[8]) << 16 | static_cast<uint32_t>(header[9]) << 24;
+  return true;
+}
+
+// Offset after the last record of a sector, clean when what follows is erased
+uint16_t CVEDLog::sectorEnd(uint16_t sector, bool *clean, uint16_t *lastSeq, bool *hasRecords) {
+  const uint16_t start = sector * sectorSize;
+  uint16_t address = start;
+  ved_log_record_t record;
+  uint8_t state;
+  *hasRecords = false;
+  while (readRecord(address, &record, &state)) {
+    *hasRecords = true;
+    *lastSeq = record.seq;
+    address += VED_LOG_HEADER_SIZE + record.length;
+  }
+  uint8_t magic = 0xFF;
+  if (address < start + sectorSize) {
+    store->read(address, &magic, 1);
+  }
+  *clean = magic == 0xFF;
+  return address;
+}
+
+void CVEDLog::mount() {
+  sectorSize = store->getSectorSize();
+  sectors = store->getSize() / sectorSize;
+  pending = 0;
+
+  bool found = false;
+  uint16_t latestSeq = 0;
+  for (uint16_t s = 0; s < sectors; s++) {
+    bool clean, hasRecords;
+    uint16_t seq;
+    const uint16_t end = sectorEnd(s, &clean, &seq, &hasRecords);
+    if (!hasRecords) {
+      if (!clean) {
+        store->erase(s); // Never held a log
+      }
+      continue;
+    }
+    if (!found || static_cast<int16_t>(seq - latestSeq) > 0) {
+      found = true;
+      latestSeq = seq;
+      head = end;
+      headFull = !clean;
+    }
+  }
+  if (!found) {
+    head = tail = 0;
+    headFull = false;
+    return;
+  }
+  nextSeq = latestSeq + 1;
+
+  // Sent records are marked in order, the first pending one is the tail
+  const uint16_t oldest = (head / sectorSize + 1) % sectors * sectorSize;
+  tail = head;
+  uint16_t cursor = oldest;
+  ved_log_record_t record;
+  uint8_t state;
+  if (!readRecord(cursor, &record, &state)) {
+    next(&cursor);
+  }
+  for (uint16_t guard = store->getSize(); cursor != head && guard > 0; guard--) {
+    if (readRecord(cursor, &record, &state) && state == VED_LOG_PENDING) {
+      if (pending++ == 0) {
+        tail = cursor;
+      }
+    }
+    if (!next(&cursor)) {
+      break;
+    }
+  }
+}
+
+void CVEDLog::clear() {
+  for (uint16_t s = 0; s < sectors; s++) {
+    store->erase(s);
+  }
+  head = tail = 0;
+  headFull = false;
+  pending = 0;
+}
+
+bool CVEDLog::next(uint16_t *cursor) {
+  if (*cursor == head) {
+    return false;
+  }
+  ved_log_record_t record;
+  uint8_t state;
+  uint16_t address = *cursor;
+  if (readRecord(address, &record, &state)) {
+    address += VED_LOG_HEADER_SIZE + record.length;
+  }
+  // Past the records of a sector, continue at the start of the next one
+  for (uint16_t jumps = 0; address != head && !readRecord(address, &record, &state) && jumps <= sectors; jumps++) {
+    address = (address - address % sectorSize + sectorSize) % store->getSize();
+  }
+  *cursor = address;
+  return true;
+}
+
+bool CVEDLog::read(uint16_t cursor, ved_log_record_t *record) {
+  uint8_t state;
+  return cursor != head && readRecord(cursor, record, &state);
+}
+
+void CVEDLog::advanceSector() {
+  const uint16_t sector = (head / sectorSize + 1) % sectors;
+  while (pending > 0 && tail / sectorSize == sector) {
+    next(&tail);
+    pending--;
+    stats.dropped++;
+  }
+  store->erase(sector);
+  head = sector * sectorSize;
+  headFull = false;
+  if (pending == 0) {
+    tail = head;
+  }
+}
+
+bool CVEDLog::append(uint32_t clock, const void *payload, uint8_t length) {
+  const uint16_t size = VED_LOG_HEADER_SIZE + length;
+  if (sectors < 2 || length > VED_LOG_MAX_PAYLOAD || size >= sectorSize) {
+    return false;
+  }
+  // A sector is never filled to the last byte, so the head can't sit on the start of the oldest one
+  if (headFull || head % sectorSize + size >= sectorSize) {
+    advanceSector();
+  }
+
+  uint8_t buffer[VED_LOG_HEADER_SIZE + VED_LOG_MAX_PAYLOAD];
+  buffer[0] = VED_LOG_MAGIC;
+  buffer[1] = length;
+  buffer[2] = VED_LOG_PENDING;
+  buffer[4] = nextSeq;
+  buffer[5] = nextSeq >> 8;
+  buffer[6] = clock;
+  buffer[7] = clock >> 8;
+  buffer[8] = clock >> 16;
+  buffer[9] = clock >> 24;
+  memcpy(buffer + VED_LOG_HEADER_SIZE, payload, length);
+  buffer[3] = crc8(crc8(0, buffer + 4, 6), buffer + VED_LOG_HEADER_SIZE, length);
+  store->program(head, buffer, size);
+
+  if (pending++ == 0) {
+    tail = head;
+  }
+  head += size;
+  nextSeq++;
+  stats.appended++;
+  return true;
+}
+
+bool CVEDLog::pop() {
+  if (pending == 0) {
+    return false;
+  }
+  const uint8_t sent = VED_LOG_SENT;
+  store->program(tail + 2, &sent, 1);
+  next(&tail);
+  pending--;
+  stats.delivered++;
+  return true;
+}
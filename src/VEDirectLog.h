@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stdint.h>
+
+// Store-and-forward log of undelivered radio payloads, kept across deep sleep.
+//
+// Records are appended to sectors of a backing store with NOR flash semantics: programming
+// only clears bits, and a whole sector is erased before it's written again. The head walks the
+// sectors in a circle and erases the next one when it runs full, so every sector is erased
+// equally often and the oldest records are dropped first.
+//
+//   magic  VED_LOG_MAGIC, 0xFF marks the erased end of a sector
+//   length payload bytes
+//   state  VED_LOG_PENDING until the record was delivered, then programmed to VED_LOG_SENT
+//   crc    CRC-8 of seq, clock and payload
+//   seq    2 bytes, orders the sectors after a restart
+//   clock  4 bytes, CONFIG_getClock() when logged
+//   payload
+//
+// Records are marked sent in order, so everything from the tail to the head is pending.
+
+#define VED_LOG_MAGIC 0xA5
+#define VED_LOG_PENDING 0xFF
+#define VED_LOG_SENT 0x00
+#define VED_LOG_HEADER_SIZE 10
+#define VED_LOG_MAX_PAYLOAD 32
+
+// Backing store of the log, erased bytes read as 0xFF
+class IVEDLogStore {
+public:
+  virtual uint16_t getSize() = 0;
+  virtual uint16_t getSectorSize() = 0;
+  virtual void read(uint16_t address, void *data, uint16_t length) = 0;
+  // Like NOR flash, can only clear bits of erased bytes
+  virtual void program(uint16_t address, const void *data, uint16_t length) = 0;
+  virtual void erase(uint16_t sector) = 0;
+};
+
+// Store in RAM, for RTC memory and host tests. Programming ANDs into the memory so
+// code that would break flash breaks here too.
+class CVEDLogRamStore: public IVEDLogStore {
+
+private:
+  uint8_t *memory;
+  uint16_t size;
+  uint16_t sectorSize;
+  uint32_t erases;
+
+public:
+  CVEDLogRamStore(uint8_t *memory, uint16_t size, uint16_t sectorSize);
+
+  virtual uint16_t getSize() { return size; }
+  virtual uint16_t getSectorSize() { return sectorSize; }
+  virtual void read(uint16_t address, void *data, uint16_t length);
+  virtual void program(uint16_t address, const void *data, uint16_t length);
+  virtual void erase(uint16_t sector);
+
+  uint32_t getEraseCount() const { return erases; }
+};
+
+typedef struct ved_log_record_t {
+  uint16_t seq;
+  uint32_t clock;
+  uint8_t length;
+  uint8_t payload[VED_LOG_MAX_PAYLOAD];
+} ved_log_record_t;
+
+typedef struct ved_log_stats_t {
+  uint32_t appended;
+  uint32_t delivered;
+  uint32_t dropped;     // Overwritten before delivery
+} ved_log_stats_t;
+
+class CVEDLog {
+
+private:
+  IVEDLogStore *store;
+  uint16_t sectorSize;
+  uint16_t sectors;
+  uint16_t head;        // Next record goes here
+  uint16_t tail;        // Oldest pending record, head when there is none
+  bool headFull;        // Head sector can't take more records, also after garbage found by mount()
+  uint16_t nextSeq;
+  uint16_t pending;
+  ved_log_stats_t stats;
+
+  bool readRecord(uint16_t address, ved_log_record_t *record, uint8_t *state);
+  uint16_t sectorEnd(uint16_t sector, bool *clean, uint16_t *lastSeq, bool *hasRecords);
+  void advanceSector();
+
+public:
+  CVEDLog(IVEDLogStore *store);
+
+  // Recovers head and tail from the store, erases it when it holds no log
+  void mount();
+  void clear();
+  bool append(uint32_t clock, const void *payload, uint8_t length);
+  // Cursor of the oldest pending record, walks towards the newest with next()
+  uint16_t first() const { return tail; }
+  bool next(uint16_t *cursor);
+  // False at the head
+  bool read(uint16_t cursor, ved_log_record_t *record);
+  // Marks the oldest pending record delivered
+  bool pop();
+
+  // Sequence number of the next record, records below it were appended earlier
+  uint16_t getNextSeq() const { return nextSeq; }
+  uint16_t pendingCount() const { return pending; }
+  bool isEmpty() const { return pending == 0; }
+  const ved_log_stats_t& getStats() const { return stats; }
+};
@@ -0,0 +1,95 @@
+#include <Arduino.h>
+
+#include "VEDirectLogFlash.h"
+
+#if defined(ESP32) || defined(ESP8266)
+  #include <EEPROM.h>
+#endif
+
+#if defined(SEEED_XIAO_M0)
+
+CVEDLogFlashStore::CVEDLogFlashStore(const volatile void *region, uint16_t size)
+:base(static_cast<uint32_t>(reinterpret_cast<uintptr_t>(region))), size(size) {
+  NVMCTRL->CTRLB.bit.MANW = 1; // Pages are written by command only
+}
+
+void CVEDLogFlashStore::command(uint32_t cmd) {
+  NVMCTRL->STATUS.reg |= NVMCTRL_STATUS_MASK; // Clear errors
+  NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | cmd;
+  while (!NVMCTRL->INTFLAG.bit.READY) {}
+}
+
+void CVEDLogFlashStore::read(uint16_t address, void *data, uint16_t length) {
+  memcpy(data, reinterpret_cast<const void*>(base + address), length);
+}
+
+void CVEDLogFlashStore::program(uint16_t address, const void *data, uint16_t length) {
+  const uint8_t *bytes = static_cast<const uint8_t*>(data);
+  while (length > 0) {
+    // The page buffer takes 32 bit writes, bytes outside the range stay 0xFF and leave the flash as is
+    const uint32_t page = (base + address) & ~(FLASH_PAGE_SIZE - 1);
+    command(NVMCTRL_CTRLA_CMD_PBC);
+    volatile uint32_t *dst = reinterpret_cast<volatile uint32_t*>(page);
+    for (uint32_t offset = 0; offset < FLASH_PAGE_SIZE; offset += 4) {
+      uint32_t word = 0xFFFFFFFF;
+      for (uint8_t b = 0; b < 4; b++) {
+        const uint32_t at = page + offset + b;
+        if (length > 0 && at == base + address) {
+          word &= ~(static_cast<uint32_t>(static_cast<uint8_t>(~*bytes)) << (8 * b));
+          bytes++;
+          address++;
+          length--;
+        }
+      }
+      *dst++ = word;
+    }
+    NVMCTRL->ADDR.reg = page / 2;
+    command(NVMCTRL_CTRLA_CMD_WP);
+  }
+}
+
+void CVEDLogFlashStore::erase(uint16_t sector) {
+  NVMCTRL->ADDR.reg = (base + sector * VED_LOG_FLASH_ROW_SIZE) / 2;
+  command(NVMCTRL_CTRLA_CMD_ER);
+}
+
+#elif defined(ESP32) || defined(ESP8266)
+
+CVEDLogEepromStore::CVEDLogEepromStore(uint16_t address, uint16_t size)
+:base(address), size(size), started(false) {
+}
+
+// Not from the constructor, EEPROM may not be constructed yet during static initialization
+void CVEDLogEepromStore::begin() {
+  if (!started) {
+    EEPROM.begin(base + size);
+    started = true;
+  }
+}
+
+void CVEDLogEepromStore::read(uint16_t address, void *data, uint16_t length) {
+  begin();
+  uint8_t *bytes = static_cast<uint8_t*>(data);
+  for (uint16_t i = 0; i < length; i++) {
+    bytes[i] = EEPROM.read(base + address + i);
+  }
+}
+
+void CVEDLogEepromStore::program(uint16_t address, const void *data, uint16_t length) {
+  begin();
+  const uint8_t *bytes = static_cast<const uint8_t*>(data);
+  for (uint16_t i = 0; i < length; i++) {
+    EEPROM.write(base + address + i, EEPROM.read(base + address + i) & bytes[i]);
+  }
+  EEPROM.commit();
+}
+
+void CVEDLogEepromStore::erase(uint16_t sector) {
+  begin();
+  for (uint16_t i = 0; i < size; i++) {
+    EEPROM.write(base + i, 0xFF);
+  }
+  EEPROM.commit();
+}
+
+#endif
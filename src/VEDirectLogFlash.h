@@ -0,0 +1,55 @@
+#pragma once
+
+#include "VEDirectLog.h"
+
+#if defined(SEEED_XIAO_M0)
+
+#include <Arduino.h>
+
+#define VED_LOG_FLASH_ROW_SIZE (FLASH_PAGE_SIZE * NVMCTRL_ROW_PAGES)
+
+// Log store in a reserved region of the SAMD21 program flash, erased in 256 byte rows and
+// written through the 64 byte page buffer. The region is part of the firmware image, so an
+// upload starts an empty log.
+class CVEDLogFlashStore: public IVEDLogStore {
+
+private:
+  uint32_t base;
+  uint16_t size;
+
+  void command(uint32_t cmd);
+
+public:
+  CVEDLogFlashStore(const volatile void *region, uint16_t size);
+
+  virtual uint16_t getSize() { return size; }
+  virtual uint16_t getSectorSize() { return VED_LOG_FLASH_ROW_SIZE; }
+  virtual void read(uint16_t address, void *data, uint16_t length);
+  virtual void program(uint16_t address, const void *data, uint16_t length);
+  virtual void erase(uint16_t sector);
+};
+
+#elif defined(ESP32) || defined(ESP8266)
+
+// Store in the emulated EEPROM, a single sector. Every change is committed to flash right away,
+// meant for small, rarely written data.
+class CVEDLogEepromStore: public IVEDLogStore {
+
+private:
+  uint16_t base;
+  uint16_t size;
+  bool started;
+
+  void begin();
+
+public:
+  CVEDLogEepromStore(uint16_t address, uint16_t size);
+
+  virtual uint16_t getSize() { return size; }
+  virtual uint16_t getSectorSize() { return size; }
+  virtual void read(uint16_t address, void *data, uint16_t length);
+  virtual void program(uint16_t address, const void *data, uint16_t length);
+  virtual void erase(uint16_t sector);
+};
+
+#endif
@@ -3,7 +3,6 @@
 #include <RF24.h>
 #include <nRF24L01.h>
 #include <ArduinoLog.h>
-#include <set>
 
 #if defined(ESP8266)
   #include <SoftwareSerial.h> // ESP8266 uses software UART because of USB conflict with its single full hardware UART
@@ -22,38 +21,127 @@
   #error Unsupported platform
 #endif
 
-#include <RF24Message_VED_MPPT.h>
-#include <RF24Message_VED_INV.h>
-#include <RF24Message_VED_BATT.h>
-#include <RF24Message_VED_BATT_SUP.h>
-#include <RF24Message.h>
+#if defined(ESP32) && defined(ESP_ARDUINO_VERSION_MAJOR) && ESP_ARDUINO_VERSION_MAJOR >= 2
+  #define VED_RX_DRIVER_CALLBACK  // UART driver task feeds the ring as soon as bytes arrive
+#endif
+
+#define VED_RX_CHUNK_SIZE 64
+
+#if defined(SEEED_XIAO_M0)
+  #define VED_RX_IDLE_MS 20   // Core UART buffer of 64 bytes fills in 33ms at 19200 baud
+#else
+  #define VED_RX_IDLE_MS 100  // Driver buffer of VED_RX_BUFFER_SIZE bytes
+#endif
+
 #include "VEDirectManager.h"
+#include "VEDirectSchema.h"
+#include "VEDirectLogFlash.h"
+#include "EventTrace.h"
+#include "RF24Command.h"
 
-static constexpr char checksumTagName[] = "CHECKSUM";
+#ifdef VED_REGISTRY_STORE
+  #if defined(SEEED_XIAO_M0)
+    // Zero filled by the upload, which reads as no blob
+    __attribute__((__aligned__(VED_LOG_FLASH_ROW_SIZE))) static const volatile uint8_t registryRegion[VED_LOG_FLASH_ROW_SIZE] = {};
+    static CVEDLogFlashStore registryStore(registryRegion, VED_LOG_FLASH_ROW_SIZE);
+  #else
+    static CVEDLogEepromStore registryStore(VED_REGISTRY_EEPROM_ADDRESS, VED_REGISTRY_BLOB_SIZE);
+  #endif
+#endif
 
-const std::set<uint16_t> PIDS_MPPT = {0XA057, 0XA055}; //
-const std::set<uint16_t> PIDS_INV = {0xA2FA}; //
-const std::set<uint16_t> PIDS_BATT = {0XA389}; //
-const std::set<uint16_t> PIDS_WITH_SUPPLEMENTALS = {0XA389}; //
+#ifdef TEMP_PROBE_PIDS
+  typedef struct {
+    uint16_t pid;
+    uint8_t probe;
+  } ved_probe_pid_t;
+  static const ved_probe_pid_t probePids[] = TEMP_PROBE_PIDS;
+#endif
+
+#ifdef VED_DEADBAND_FILTER
+static const ved_deadband_t deadbandConfig[VED_CLASS_COUNT] = {
+  //  STATE  MV               MA               MAH               PERMILLE               W               OTHER
+  { { 0,     0,               0,               0,                0,                     0,              0 },   0 },                          // NONE
+  { { 0,     VED_DEADBAND_MV, VED_DEADBAND_MA, VED_DEADBAND_MAH, VED_DEADBAND_PERMILLE, VED_DEADBAND_W, 1 },   VED_DEADBAND_HEARTBEAT_SEC }, // MPPT, yield in 0.01kWh
+  { { 0,     VED_DEADBAND_MV, VED_DEADBAND_MA, VED_DEADBAND_MAH, VED_DEADBAND_PERMILLE, VED_DEADBAND_W, 5 },   VED_DEADBAND_HEARTBEAT_SEC }, // INV, 0.1A and 0.01V
+  { { 0,     VED_DEADBAND_MV, VED_DEADBAND_MA, VED_DEADBAND_MAH, VED_DEADBAND_PERMILLE, VED_DEADBAND_W, 10 },  VED_DEADBAND_HEARTBEAT_SEC }, // BATT, time to go in minutes
+  { { 0,     VED_DEADBAND_MV, VED_DEADBAND_MA, VED_DEADBAND_MAH, VED_DEADBAND_PERMILLE, VED_DEADBAND_W, 1 },   VED_DEADBAND_HEARTBEAT_SEC }  // BATT_SUP, cycles and 0.01kWh
+};
+#else
+static const ved_deadband_t deadbandConfig[VED_CLASS_COUNT] = {}; // Heartbeat 0, everything passes
+#endif
+static RETAINED ved_deadband_state_t deadbandState;
+static_assert(RETAINED_BLOCK_DEADBAND + RETAINED_BLOCKS_FOR(ved_deadband_state_t) <= RETAINED_BLOCK_TRACE, "Deadband state overlaps the next retained block");
+
+#ifdef VED_LOG
+  #if defined(SEEED_XIAO_M0)
+    // Zero filled by the upload, mount() erases it
+    __attribute__((__aligned__(VED_LOG_FLASH_ROW_SIZE))) static const volatile uint8_t logRegion[VED_LOG_SIZE] = {};
+    static CVEDLogFlashStore logStore(logRegion, VED_LOG_SIZE);
+  #else
+    static RETAINED uint8_t logMemory[VED_LOG_SIZE];
+    static CVEDLogRamStore logStore(logMemory, VED_LOG_SIZE, VED_LOG_SECTOR_SIZE);
+    #if defined(ESP8266)
+      static_assert(RETAINED_BLOCK_LOG + RETAINED_BLOCKS_FOR(logMemory) <= RETAINED_BLOCKS, "Log exceeds RTC user memory");
+    #endif
+  #endif
+#endif
 
 // Protocol https://www.victronenergy.com/upload/documents/VE.Direct-Protocol-3.33.pdf
 
 CVEDirectManager::CVEDirectManager(ISensorProvider* sensor)
-:tMillis(0), tMillisError(millis()), jobDone(false), mState(IDLE), mChecksum(0), mTextPointer(0), sensor(sensor), lastPid(0), randomDelay(0) {  
+:tMillis(0), tMillisError(millis()), tsAwake(millis()), jobDone(false), uartOverflows(0), parser(this), hex(this), hexField(0), deadband(&deadbandState, deadbandConfig), suppressedCount(0), phasesSent(false), errorMessage(NULL),
+  #ifdef VED_LOG
+    log(&logStore), logCursor(0), logMountSeq(0), logMarkerLeft(0), backlogCount(0), linkUp(false), linkDown(false),
+  #endif
+  pollSources(0),
+  #ifdef RF24_ACK_MODE
+    tsNewSource(millis()), statusMessage(NULL), statusDelivered(false),
+  #endif
+  sensor(sensor), lastPid(0), registryFullPid(0) {  
 
   #if defined(ESP32)
+    Serial2.setRxBufferSize(VED_RX_BUFFER_SIZE);
     Serial2.begin(19200, SERIAL_8N1, VE_RX, VE_TX);
     VEDirectStream = &Serial2;
+    #ifdef VED_RX_DRIVER_CALLBACK
+      Serial2.onReceive([this]() { pumpRx(); });
+    #endif
   #elif defined(ESP8266)
     pinMode(VE_RX, INPUT);
     pinMode(VE_TX, OUTPUT);
     SoftwareSerial *ves = new SoftwareSerial(VE_RX, VE_TX);
-    ves->begin(19200, SWSERIAL_8N1);
+    ves->begin(19200, SWSERIAL_8N1, VE_RX, VE_TX, false, VED_RX_BUFFER_SIZE); // Bytes are collected by the pin change ISR
     VEDirectStream = ves;
   #elif defined(SEEED_XIAO_M0)
     Serial1.begin(19200, SERIAL_8N1); // Defaults to RX=D7; TX=D8;
     VEDirectStream = &Serial1;
   #endif
+
+  if (!CONFIG_retainedRestore(&deadbandState, sizeof(deadbandState), RETAINED_BLOCK_DEADBAND)) {
+    deadband.clear();
+  }
+  #ifdef VED_LOG
+    #if !defined(SEEED_XIAO_M0)
+      if (!CONFIG_retainedRestore(logMemory, sizeof(logMemory), RETAINED_BLOCK_LOG)) {
+        memset(logMemory, 0xFF, sizeof(logMemory)); // Erased, the log starts empty
+      }
+    #endif
+    log.mount();
+    logCursor = log.first();
+    logMountSeq = log.getNextSeq();
+    if (!log.isEmpty()) {
+      Log.noticeln(F("Log holds %i undelivered messages"), log.pendingCount());
+    }
+  #endif
+  memset(inflight, 0, sizeof(inflight));
+
+  #ifdef VED_REGISTRY_STORE
+    if (registry.load(&registryStore)) {
+      Log.noticeln(F("Loaded %i PIDs from the registry store"), registry.getCount());
+    }
+  #endif
+
+  startHexQuery();
 }
 
 CVEDirectManager::~CVEDirectManager() { 
@@ -68,24 +156,42 @@ void CVEDirectManager::loop() {
     return;
   }
   
-  if (millis() - tMillis > 1000) {
-    
-    char rc;
-    while (VEDirectStream->available() > 0) {
-      rc = VEDirectStream->read();
-      rxData(rc);
+  #ifndef VED_RX_DRIVER_CALLBACK
+    pumpRx();
+  #endif
+
+  // Parse everything queued since the last pass in bulk
+  uint8_t chunk[VED_RX_CHUNK_SIZE];
+  uint16_t n;
+  while ((n = rxRing.pop(chunk, sizeof(chunk))) > 0) {
+    TRACE_mark(PHASE_FIRST_BYTE);
+    for (uint16_t i = 0; i < n; i++) {
+      parser.rxData(chunk[i]);
     }
+  }
 
-    Log.verboseln("Read %u VE.Direct values", mVEData.size());
+  hex.loop(millis());
+
+  if (millis() - tMillis > 1000) {
+    tMillis = millis();
+
+    const ved_parser_stats_t &stats = parser.getStats();
+    Log.verboseln("Read %u VE.Direct values; frames=%u checksumErrors=%u dropped=%u", parser.frame().size(), stats.frames, stats.checksumErrors, stats.droppedRecords);
+    if (getRxOverflows() > 0) {
+      Log.warningln(F("VE.Direct RX overflows: ring=%u uart=%u"), rxRing.getOverflows(), uartOverflows);
+    }
+    #ifdef VED_DEADBAND_FILTER
+      Log.verboseln(F("Deadband sent=%u suppressed=%u"), deadband.getStats().sent, deadband.getStats().suppressed);
+    #endif
     if (Log.getLevel() >= LOG_LEVEL_VERBOSE) {
-      std::map<String, String>::iterator it = mVEData.begin();
-      while (it != mVEData.end()) {
-        Log.verboseln("  [%s]='%s'",it->first.c_str(), it->second.c_str());
-        ++it;
+      for (uint8_t l = 0; l < VED_LABEL_COUNT; l++) {
+        if (parser.frame().has((VEDLabel)l)) {
+          Log.verboseln("  [%s]='%s'", VED_labelName(l), parser.frame().get((VEDLabel)l));
+        }
       }
     }
     
-    if (messages.size() != 0) {
+    if (!outbox.isEmpty() || errorMessage != NULL) {
       // S'all good
       tMillisError = millis();
     } else if (millis() - tMillisError > 10000) {
@@ -101,256 +207,666 @@ void CVEDirectManager::loop() {
         sensor->getBaroPressure(NULL),
         VEDirectCommFail
       };
-      addMessage(new CRF24Message(0, _msg));
+      errorMessage = pool.create(_msg);
     }
   }
 }
 
+const uint32_t CVEDirectManager::getIdleMs() {
+  if (isJobDone()) {
+    return MANAGER_IDLE_FOREVER;
+  }
+  if (!rxRing.isEmpty() || VEDirectStream->available() > 0) {
+    return 0;
+  }
+  const uint32_t sinceTick = millis() - tMillis;
+  if (sinceTick > 1000) {
+    return 0;
+  }
+  // loop() ticks once more than 1000 ms passed
+  const uint32_t untilTick = 1000 - sinceTick + 1;
+  return untilTick < VED_RX_IDLE_MS ? untilTick : VED_RX_IDLE_MS;
+}
+
+void CVEDirectManager::pumpRx() {
+  while (VEDirectStream->available() > 0) {
+    rxRing.push(static_cast<uint8_t>(VEDirectStream->read()));
+  }
+  #if defined(ESP8266)
+    if (static_cast<SoftwareSerial*>(VEDirectStream)->overflow()) {
+      uartOverflows++;
+    }
+  #endif
+}
+
 void CVEDirectManager::powerDown() {
   jobDone = true;
-  while(!messages.empty()) {
-    CBaseMessage *msg = messages.front();
-    messages.pop();
-    delete msg;
+  #ifdef VED_LOG
+    if (linkDown) {
+      // The radio gave up this wake, keep what is still queued
+      CBaseMessage *msg;
+      while ((msg = nextMessage()) != NULL) {
+        logMessage(msg);
+        pool.release(msg);
+      }
+    }
+    #if !defined(SEEED_XIAO_M0)
+      CONFIG_retainedSave(logMemory, sizeof(logMemory), RETAINED_BLOCK_LOG);
+    #endif
+  #endif
+  outbox.clear();
+  aggregator.clear(); // Windows cover awake time only
+  if (errorMessage != NULL) {
+    pool.release(errorMessage);
+    errorMessage = NULL;
   }
-  mVEData.clear();
+  parser.reset();
 }
 
 void CVEDirectManager::powerUp() {
   jobDone = false;
   tMillis = 0;
   tMillisError = millis();
-  mVEData.clear();
+  tsAwake = millis();
+  suppressedCount = 0;
+  phasesSent = false;
+  registryFullPid = 0;
+  #ifdef VED_LOG
+    logCursor = log.first();
+    logMarkerLeft = 0;
+    backlogCount = 0;
+    linkUp = linkDown = false;
+  #endif
+  memset(inflight, 0, sizeof(inflight)); // The radio settled everything at powerDown()
+  deadband.newWake();
+  #ifdef RF24_ACK_MODE
+    tsNewSource = millis();
+    statusMessage = NULL;
+    statusDelivered = false;
+  #endif
+  parser.reset();
+  startHexQuery();
+}
+
+bool CVEDirectManager::hexRxEvent(uint8_t inbyte) {
+  return hex.rxData(inbyte);
+}
+
+void CVEDirectManager::hexWrite(const uint8_t *buffer, uint8_t length) {
+  VEDirectStream->write(buffer, length);
 }
 
-void CVEDirectManager::rxData(uint8_t inbyte) {
+void CVEDirectManager::hexResponse(uint8_t command, uint16_t reg, VEDHexStatus status, const uint8_t *data, uint8_t length) {
+  if (command == VED_HEX_CMD_PRODUCT_ID) {
+    if (status != VED_HEX_OK || length < 2) {
+      Log.noticeln(F("VE.Direct HEX product id query failed (%i), waiting for TEXT frames"), status);
+      return;
+    }
+    const uint16_t pid = static_cast<uint16_t>(CVEDirectHex::decodeValue(data, 2, false));
+    const uint8_t deviceClass = registry.getDeviceClass(pid);
+    TRACE_EVENT(HEX_PID, deviceClass, pid, 0);
+    memset(&hexSnapshot, 0, sizeof(hexSnapshot));
+    hexSnapshot.deviceClass = deviceClass;
+    hexSnapshot.pid = pid;
+    hexField = VED_nextHexField(deviceClass, 0);
+    requestHexField();
+    return;
+  }
 
-  if ( (inbyte == ':') && (mState != CHECKSUM) ) {
-    mState = RECORD_HEX;
+  if (command != VED_HEX_CMD_GET || hexSnapshot.deviceClass == VED_CLASS_NONE
+      || hexField >= VED_schema(hexSnapshot.deviceClass)->count
+      || reg != VED_schema(hexSnapshot.deviceClass)->fields[hexField].hexRegister) {
+    return;
   }
-  if (mState != RECORD_HEX) {
-    mChecksum += inbyte;
+  if (status == VED_HEX_OK) {
+    VED_captureHex(data, length, hexField, &hexSnapshot);
+  } else {
+    TRACE_EVENT(HEX_REGISTER, status, reg, 0);
   }
-  inbyte = toupper(inbyte);
- 
-  switch(mState) {
-    case IDLE:
-      /* wait for \n of the start of an record */
-      switch(inbyte) {
-        case '\n':
-          mState = RECORD_BEGIN;
-          break;
-        case '\r': /* Skip */
-        default:
-          break;
-      }
-      break;
-    case RECORD_BEGIN:
-      mTextPointer = mName;
-      *mTextPointer++ = inbyte;
-      mState = RECORD_NAME;
-      break;
-    case RECORD_NAME:
-      // The record name is being received, terminated by a \t
-      switch(inbyte) {
-      case '\t':
-        // the Checksum record indicates a EOR
-        if ( mTextPointer < (mName + sizeof(mName)) ) {
-          *mTextPointer = 0; /* Zero terminate */
-          if (strcmp(mName, checksumTagName) == 0) {
-            mState = CHECKSUM;
-            break;
-          }
-        }
-        mTextPointer = mValue; /* Reset value pointer */
-        mState = RECORD_VALUE;
-        break;
-      default:
-        // add byte to name, but do no overflow
-        if ( mTextPointer < (mName + sizeof(mName)) )
-          *mTextPointer++ = inbyte;
-        break;
-      }
-      break;
-    case RECORD_VALUE:
-      // The record value is being received.  The \r indicates a new record.
-      switch(inbyte) {
-      case '\n':
-        // forward record, only if it could be stored completely
-        if ( mTextPointer < (mValue + sizeof(mValue)) ) {
-          *mTextPointer = 0; // make zero ended
-          mVEData[String(mName)] = String(mValue);
-          if (Log.getLevel() >= LOG_LEVEL_VERBOSE) {
-            //Log.verboseln("~~ [%s] = '%s'", mName, mValue);
-          }
-        }
-        mState = RECORD_BEGIN;
-        break;
-      case '\r': /* Skip */
-        break;
-      default:
-        // add byte to value, but do no overflow
-        if ( mTextPointer < (mValue + sizeof(mValue)) )
-          *mTextPointer++ = inbyte;
-        break;
-      }
-      break;
-    case CHECKSUM: {
-      Log.traceln("mVEData size=%i, checksum=%i", mVEData.size(), mChecksum);
-      if (mChecksum != 0) {
-        Log.traceln("Ignoring frame with invalid checksum %x", mChecksum);
-      } else if (mVEData.size() == 0) {
-        Log.traceln(F("Ignoring empty frame"));
-      } else {
-        frameEndEvent();
-      }
-      mChecksum = 0;
-      mState = IDLE;
-      mVEData.clear();
-      break;
-    }
-    case RECORD_HEX:
-      if (hexRxEvent(inbyte)) {
-        mChecksum = 0;
-        mState = IDLE;
-      }
-      break;
+  hexField = VED_nextHexField(hexSnapshot.deviceClass, hexField + 1);
+  requestHexField();
+}
+
+void CVEDirectManager::requestHexField() {
+  const VEDSchema *schema = VED_schema(hexSnapshot.deviceClass);
+  if (hexField < schema->count) {
+    hex.get(schema->fields[hexField].hexRegister, millis());
+    return;
   }
+
+  // All registers of the device class answered or timed out
+  if (hexSnapshot.present != 0) {
+    TRACE_EVENT(HEX_SNAPSHOT, 0, hexSnapshot.pid, hex.getStats().responses);
+    tMillisError = millis();
+    addSnapshot(hexSnapshot, getCurrentTemperature(hexSnapshot.pid, NAN));
+  }
+  hexSnapshot.deviceClass = VED_CLASS_NONE;
 }
 
-bool CVEDirectManager::hexRxEvent(uint8_t inbyte) {
-  Log.infoln("Unsupported HEX data %x", inbyte);
-  return true;
+void CVEDirectManager::startHexQuery() {
+  #ifdef VED_HEX_QUERY_ON_WAKE
+    hex.reset();
+    hexSnapshot.deviceClass = VED_CLASS_NONE;
+    hex.productId(millis());
+  #endif
 }
 
-void CVEDirectManager::frameEndEvent() {
+// Learns an unknown device from its frame, when it looks like one of the supported classes
+uint8_t CVEDirectManager::learnDevice(uint16_t pid, const CVEDFrame &frame) {
+  #ifdef VED_REGISTRY_LEARN
+    const uint8_t deviceClass = CVEDRegistry::classify(frame);
+    if (deviceClass == VED_CLASS_NONE) {
+      return VED_CLASS_NONE;
+    }
+    // Battery monitors send their history in a second frame without a PID
+    const uint8_t flags = VED_PID_LEARNED | (deviceClass == VED_CLASS_BATT ? VED_PID_SUPPLEMENTALS : 0);
+    if (!registry.add(pid, deviceClass, flags)) {
+      if (pid != registryFullPid) {
+        // Its frames keep coming every second
+        Log.warningln(F("PID registry full, can't learn PID %x"), pid);
+        registryFullPid = pid;
+      }
+      return VED_CLASS_NONE;
+    }
+    Log.noticeln(F("Learned PID %x as device class %i"), pid, deviceClass);
+    #ifdef VED_REGISTRY_STORE
+      registry.save(&registryStore);
+    #endif
+    return deviceClass;
+  #else
+    return VED_CLASS_NONE;
+  #endif
+}
+
+void CVEDirectManager::frameEndEvent(const CVEDFrame &frame) {
+  TRACE_mark(PHASE_FIRST_FRAME);
 
-  std::map<String, String>::const_iterator pid = mVEData.find(String("PID"));
-  if (pid == mVEData.end() 
-      && (lastPid == 0 || PIDS_WITH_SUPPLEMENTALS.find(lastPid) == PIDS_WITH_SUPPLEMENTALS.end())) {
+  const bool hasPid = frame.has(VED_LABEL_PID);
+  if (!hasPid
+      && (lastPid == 0 || !registry.hasSupplementals(lastPid))) {
 
     Log.warningln("Ignoring frame without a PID (lastPid=%x)", lastPid);
     if (Log.getLevel() >= LOG_LEVEL_NOTICE) {
-      std::map<String, String>::iterator it = mVEData.begin();
-      while (it != mVEData.end()) {
-        Log.noticeln(F("  [%s]='%s'"),it->first.c_str(), it->second.c_str());
-        ++it;
+      for (uint8_t l = 0; l < VED_LABEL_COUNT; l++) {
+        if (frame.has((VEDLabel)l)) {
+          Log.noticeln(F("  [%s]='%s'"), VED_labelName(l), frame.get((VEDLabel)l));
+        }
       }
     }
     return;
   }
 
-  bool tempCurrent = false;
-  float temp = sensor->getTemperature(&tempCurrent);
-  if (!sensor->isSensorReady() || !tempCurrent) {
-    Log.verboseln(F("Skipping frame while temperature sensor not ready or stale"));
+  // Queued right away, a reading that arrives later is patched in when the message is built
+  if (hasPid) {
+    lastPid = static_cast<uint16_t>(frame.getInt(VED_LABEL_PID));
+  }
+  const float temp = getCurrentTemperature(lastPid, NAN);
+  tMillisError = millis();
+  ved_snapshot_t snap;
+  if (hasPid) {
+    const uint16_t pidInt = lastPid;
+    const ved_pid_entry_t *entry = registry.find(pidInt);
+    const uint8_t deviceClass = entry != NULL ? entry->deviceClass : learnDevice(pidInt, frame);
+    TRACE_EVENT(FRAME, deviceClass, pidInt, frame.size());
+    if (deviceClass == VED_CLASS_NONE) {
+      Log.warningln("Received frame with unsupported PID: %s", frame.get(VED_LABEL_PID));
+      return;
+    }
+    VED_capture(frame, deviceClass, pidInt, &snap);
+  } else {
+    TRACE_EVENT(SUPPLEMENTAL, 0, lastPid, frame.size());
+    VED_capture(frame, VED_CLASS_BATT_SUP, lastPid, &snap); // TODO: Support other devices that might have supplemental messages
+  }
+  addSnapshot(snap, temp);
+}
+
+void CVEDirectManager::addSnapshot(const ved_snapshot_t &snap, float temp) {
+  #ifdef VED_AGGREGATE
+    aggregator.add(snap, millis());
+  #endif
+  #ifdef RF24_ACK_MODE
+    const uint8_t sources = outbox.sourceCount();
+  #endif
+  if (!outbox.put(snap, temp)) {
+    Log.warningln(F("Outbox full, dropping snapshot of PID %x"), snap.pid);
     return;
   }
+  #ifdef RF24_ACK_MODE
+    if (outbox.sourceCount() > sources) {
+      tsNewSource = millis();
+    }
+  #endif
+  TRACE_mark(PHASE_FIRST_QUEUED);
+  TRACE_EVENT(QUEUED, outbox.pendingCount(), snap.pid, outbox.getStats().coalesced);
+}
 
-  tMillisError = millis();
-  uint16_t pidInt = 0;
-  if (pid != mVEData.end()) {
-    pidInt = std::stoul(pid->second.c_str(), nullptr, 16);
-    lastPid = pidInt;
-
-    Log.traceln(F("Preparing event for PID '%s'(%x) with %i values and sensor temp %DC"), pid->second.c_str(), pidInt, mVEData.size(), temp);
-    if (PIDS_MPPT.find(pidInt) != PIDS_MPPT.end()) {
-      Log.traceln(F("PID is MPPT charger"));
+CBaseMessage* CVEDirectManager::createMessage(const ved_snapshot_t &snap, float temp) {
+  TRACE_EVENT(MESSAGE, snap.deviceClass, snap.pid, 0);
+  switch(snap.deviceClass) {
+    case VED_CLASS_MPPT: {
       const r24_message_ved_mppt_t _msg {
         MSG_VED_MPPT_ID,
         //
-        static_cast<float>(atoi(mVEData[String("V")].c_str()) / 1000.0),
-        static_cast<float>(atoi(mVEData[String("I")].c_str()) / 1000.0),
-        static_cast<float>(atoi(mVEData[String("VPV")].c_str()) / 1000.0),
-        static_cast<float>(atoi(mVEData[String("PPV")].c_str())),
+        snap.value<float>(VED_MPPT_V),
+        snap.value<float>(VED_MPPT_I),
+        snap.value<float>(VED_MPPT_VPV),
+        snap.value<float>(VED_MPPT_PPV),
         //
-        static_cast<uint8_t>(atoi(mVEData[String("CS")].c_str())),
-        static_cast<uint8_t>(atoi(mVEData[String("MPPT")].c_str())),
-        static_cast<uint8_t>(strtol(mVEData[String("OR")].c_str(), NULL, 16)),
-        static_cast<uint8_t>(atoi(mVEData[String("ERR")].c_str())),
+        snap.value<uint8_t>(VED_MPPT_CS),
+        snap.value<uint8_t>(VED_MPPT_MPPT),
+        snap.value<uint8_t>(VED_MPPT_OR),
+        snap.value<uint8_t>(VED_MPPT_ERR),
         //
-        static_cast<uint16_t>(atoi(mVEData[String("H20")].c_str()) * 10),
-        static_cast<uint16_t>(atoi(mVEData[String("H21")].c_str())),
+        snap.value<uint16_t>(VED_MPPT_H20),
+        snap.value<uint16_t>(VED_MPPT_H21),
         //
         temp
       };
-      addMessage(new CRF24Message_VED_MPPT(0, _msg));
-    } else if (PIDS_INV.find(pidInt) != PIDS_INV.end()) {
-      Log.traceln("PID is AC inverter");
+      return pool.create(_msg);
+    }
+    case VED_CLASS_INV: {
       const r24_message_ved_inv_t _msg {
         MSG_VED_INV_ID,
         //
-        static_cast<float>(atoi(mVEData[String("V")].c_str()) / 1000.0),
-        static_cast<float>(atoi(mVEData[String("AC_OUT_I")].c_str()) / 10.0),
-        static_cast<float>(atoi(mVEData[String("AC_OUT_V")].c_str()) / 100.0),
-        static_cast<float>(atoi(mVEData[String("AC_OUT_S")].c_str())),
+        snap.value<float>(VED_INV_V),
+        snap.value<float>(VED_INV_AC_OUT_I),
+        snap.value<float>(VED_INV_AC_OUT_V),
+        snap.value<float>(VED_INV_AC_OUT_S),
         //
-        static_cast<uint8_t>(atoi(mVEData[String("CS")].c_str())),
-        static_cast<int8_t>(atoi(mVEData[String("MODE")].c_str())),
-        static_cast<uint8_t>(strtol(mVEData[String("OR")].c_str(), NULL, 16)),
-        static_cast<uint8_t>(atoi(mVEData[String("AR")].c_str())),
-        static_cast<uint8_t>(atoi(mVEData[String("WARN")].c_str())),
+        snap.value<uint8_t>(VED_INV_CS),
+        snap.value<int8_t>(VED_INV_MODE),
+        snap.value<uint8_t>(VED_INV_OR),
+        snap.value<uint8_t>(VED_INV_AR),
+        snap.value<uint8_t>(VED_INV_WARN),
         //
         temp
       };
-      addMessage(new CRF24Message_VED_INV(0, _msg));
-    } else if (PIDS_BATT.find(pidInt) != PIDS_BATT.end()) {
-      Log.traceln("PID is BATT monitor");
+      return pool.create(_msg);
+    }
+    case VED_CLASS_BATT: {
       const r24_message_ved_batt_t _msg {
         MSG_VED_BATT_ID,
         //
-        static_cast<float>(atoi(mVEData[String("V")].c_str()) / 1000.0),
-        static_cast<float>(atoi(mVEData[String("VS")].c_str()) / 1000.0),
-        static_cast<float>(atoi(mVEData[String("I")].c_str()) / 1000.0),
-        static_cast<int16_t>(atoi(mVEData[String("P")].c_str())),
+        snap.value<float>(VED_BATT_V),
+        snap.value<float>(VED_BATT_VS),
+        snap.value<float>(VED_BATT_I),
+        snap.value<int16_t>(VED_BATT_P),
+        //
+        snap.value<float>(VED_BATT_CE),
+        snap.value<uint16_t>(VED_BATT_SOC),
+        snap.value<uint16_t>(VED_BATT_TTG),
+        //
+        snap.value<uint8_t>(VED_BATT_AR),
+      };
+      return pool.create(_msg);
+    }
+    case VED_CLASS_BATT_SUP: {
+      const r24_message_ved_batt_sup_t _msg {
+        MSG_VED_BATT_SUP_ID,
+        //
+        snap.value<float>(VED_BATT_SUP_H2),
+        snap.value<uint16_t>(VED_BATT_SUP_H4),
+        //
+        snap.value<float>(VED_BATT_SUP_H7),
+        snap.value<float>(VED_BATT_SUP_H15),
         //
-        static_cast<float>(atoi(mVEData[String("CE")].c_str()) / 1000.0),
-        static_cast<uint16_t>(atoi(mVEData[String("SOC")].c_str())),
-        static_cast<uint16_t>(atoi(mVEData[String("TTG")].c_str())),
+        snap.value<float>(VED_BATT_SUP_H18),
+        snap.value<float>(VED_BATT_SUP_H17),
         //
-        static_cast<uint8_t>(atoi(mVEData[String("AR")].c_str())),
+        temp
       };
-      addMessage(new CRF24Message_VED_BATT(0, _msg));
-    } else if (pid != mVEData.end()) {
-      Log.warningln("Received frame with unsupported PID: %s", pid->second.c_str());
-    }
-  } else if (lastPid && PIDS_WITH_SUPPLEMENTALS.find(lastPid) != PIDS_WITH_SUPPLEMENTALS.end()) {
-    Log.noticeln(F("Preparing supplemental event for PID %x with %i values and sensor temp %DC"), lastPid, mVEData.size(), temp);
-    const r24_message_ved_batt_sup_t _msg {
-      MSG_VED_BATT_SUP_ID, // TODO: Support other devices that might have supplemental messages
-      //
-      static_cast<float>(atoi(mVEData[String("H2")].c_str()) / 1000.0),
-      static_cast<uint16_t>(atoi(mVEData[String("H4")].c_str())),
-      //
-      static_cast<float>(atoi(mVEData[String("H7")].c_str()) / 1000.0),
-      static_cast<float>(atoi(mVEData[String("H15")].c_str()) / 1000.0),
-      //
-      static_cast<float>(atoi(mVEData[String("H18")].c_str()) * 10.0),
-      static_cast<float>(atoi(mVEData[String("H17")].c_str()) * 10.0),
-      //
-      temp
-    };
-    addMessage(new CRF24Message_VED_BATT_SUP(0, _msg));
-  }
-}
-
-CBaseMessage* CVEDirectManager::pollMessage() { 
-  if (messages.size() == 0) {
+      return pool.create(_msg);
+    }
+  }
+  return NULL;
+}
+
+CBaseMessage* CVEDirectManager::pollMessage() {
+  pollSources = 0;
+  CBaseMessage* msg = nextMessage();
+  if (msg == NULL) {
     return NULL;
   }
-  CBaseMessage* msg = messages.front();
-  messages.pop();
+  // Remembered until the radio settles the message, delivery commits its sources
+  for (uint8_t i = 0; i < VED_INFLIGHT_SIZE; i++) {
+    if (inflight[i].msg == NULL) {
+      inflight[i].msg = msg;
+      inflight[i].sources = pollSources;
+      return msg;
+    }
+  }
+  Log.warningln(F("More than %i messages in flight, a delivery won't count"), VED_INFLIGHT_SIZE);
   return msg;
 }
 
-void CVEDirectManager::addMessage(CBaseMessage *msg) {
-  if (messages.size() > MSGS_TO_TRANSMIT_BEFORE_DONE + 1 && messages.front()->getId() == msg->getId()) {
-    Log.noticeln("Deleting excess message with ID %x", msg->getId());
-    CBaseMessage* msg = messages.front();
-    messages.pop();
-    delete msg;
+bool CVEDirectManager::hasMessage() {
+  // Whatever nextMessage() would return something for, in the same order
+  if (errorMessage != NULL) {
+    return true;
   }
-  Log.noticeln("Adding message with ID %i to queue of size: %i", msg->getId(), messages.size());
-  messages.push(msg);
-  
-}
\ No newline at end of file
+  #ifdef VED_LOG
+    if (linkUp && !linkDown && hasBacklog()) {
+      return true;
+    }
+  #endif
+  #ifdef PHASE_TRACE_MESSAGE
+    if (!phasesSent && TRACE_getStats().cycles > 0) {
+      return true;
+    }
+  #endif
+  #ifdef VED_AGGREGATE
+    if (aggregator.isReady(VED_AGGREGATE_WINDOW_MS)) {
+      return true;
+    }
+  #endif
+  return !outbox.isEmpty() && isTemperatureSettled();
+}
+
+CBaseMessage* CVEDirectManager::nextMessage() {
+  if (errorMessage != NULL) {
+    CBaseMessage* msg = errorMessage;
+    errorMessage = NULL;
+    #ifdef RF24_ACK_MODE
+      statusMessage = msg;
+    #endif
+    return msg;
+  }
+  #ifdef VED_LOG
+    if (linkUp && !linkDown) {
+      // Current data went through, catch up on the backlog before more of it
+      CBaseMessage* msg = pollBacklog();
+      if (msg != NULL) {
+        return msg;
+      }
+    }
+  #endif
+  #ifdef PHASE_TRACE_MESSAGE
+    if (!phasesSent && TRACE_getStats().cycles > 0) {
+      phasesSent = true;
+      CBaseMessage* msg = pool.create(TRACE_getStats());
+      if (msg != NULL) {
+        return msg;
+      }
+    }
+  #endif
+  #ifdef VED_AGGREGATE
+    ved_aggregate_t aggregate;
+    if (aggregator.take(&aggregate, VED_AGGREGATE_WINDOW_MS)) {
+      CBaseMessage* msg = pool.create(aggregate);
+      if (msg != NULL) {
+        return msg;
+      }
+      Log.warningln(F("Message pool exhausted, dropping aggregate of PID %x"), aggregate.pid);
+    }
+  #endif
+  #ifdef VED_PACKED_PAYLOAD
+    return createPackedMessage();
+  #else
+    if (!isTemperatureSettled()) {
+      return NULL;
+    }
+    ved_snapshot_t snap;
+    float temp;
+    uint8_t source;
+    while (outbox.take(&snap, &temp, &source)) {
+      if (!isWorthSending(snap, source)) {
+        continue;
+      }
+      CBaseMessage* msg = createMessage(snap, getCurrentTemperature(snap.pid, temp));
+      if (msg == NULL) {
+        Log.warningln(F("Message pool exhausted, dropping snapshot of PID %x"), snap.pid);
+      } else {
+        pollSources = source;
+      }
+      return msg;
+    }
+    return NULL;
+  #endif
+}
+
+CBaseMessage* CVEDirectManager::createPackedMessage() {
+  if (!isTemperatureSettled()) {
+    return NULL;
+  }
+  CVEDPackedWriter writer;
+  ved_snapshot_t snap;
+  float temp;
+  uint8_t source;
+  while (outbox.take(&snap, &temp, &source)) {
+    if (writer.getRecordCount() > 0 && !writer.fits(snap)) {
+      outbox.put(snap, temp); // Goes into the next frame
+      break;
+    }
+    if (!isWorthSending(snap, source)) {
+      continue;
+    }
+    if (writer.getRecordCount() == 0) {
+      writer.begin(getCurrentTemperature(snap.pid, temp)); // One per frame, from the probe of its first device
+    }
+    if (!writer.add(snap)) {
+      Log.warningln(F("Snapshot of PID %x too large for a packed frame"), snap.pid);
+    } else {
+      pollSources |= source;
+    }
+  }
+  if (writer.getRecordCount() == 0) {
+    return NULL;
+  }
+  TRACE_EVENT(PACKED, writer.getRecordCount(), 0, writer.getLength());
+  CBaseMessage* msg = pool.create(writer);
+  if (msg == NULL) {
+    Log.warningln(F("Message pool exhausted, dropping packed message"));
+    pollSources = 0;
+  }
+  return msg;
+}
+
+// Probe on the chassis of the device, the first one for devices not in TEMP_PROBE_PIDS
+uint8_t CVEDirectManager::getTemperatureProbe(uint16_t pid) {
+  #ifdef TEMP_PROBE_PIDS
+    for (uint8_t i = 0; i < sizeof(probePids) / sizeof(probePids[0]); i++) {
+      if (probePids[i].pid == pid && probePids[i].probe < sensor->getTemperatureCount()) {
+        return probePids[i].probe;
+      }
+    }
+  #endif
+  return 0;
+}
+
+// The newest reading, or what was captured with the frame when there is no current one
+float CVEDirectManager::getCurrentTemperature(uint16_t pid, float captured) {
+  bool current = false;
+  const float temp = sensor->getTemperature(getTemperatureProbe(pid), &current);
+  return current ? temp : captured;
+}
+
+// Frames of a fresh wake wait a little for the first reading rather than go without one
+bool CVEDirectManager::isTemperatureSettled() {
+  #ifdef TEMP_SENSOR_WAIT_MS
+    bool current = false;
+    sensor->getTemperature(&current);
+    return current || millis() - tsAwake >= TEMP_SENSOR_WAIT_MS;
+  #else
+    return true;
+  #endif
+}
+
+// Outbox slot of a source bit
+static uint8_t sourceSlot(uint8_t source) {
+  uint8_t slot = 0;
+  while (source > 1) {
+    source >>= 1;
+    slot++;
+  }
+  return slot;
+}
+
+bool CVEDirectManager::isWorthSending(const ved_snapshot_t &snap, uint8_t source) {
+  if (!deadband.pass(snap, CONFIG_getClock())) {
+    TRACE_EVENT(SUPPRESSED, snap.deviceClass, snap.pid, 0);
+    suppressedCount++;
+    #ifdef RF24_ACK_MODE
+      outbox.setDelivered(source); // The gateway has it already
+    #endif
+    return false;
+  }
+  polled[sourceSlot(source)] = snap;
+  return true;
+}
+
+void CVEDirectManager::releaseMessage(CBaseMessage *msg) {
+  settle(msg, true);
+  #ifdef VED_LOG
+    linkUp = true;
+    CRF24Message_LOG *logged = pool.findLog(msg);
+    if (logged != NULL && logged->isReplay()) {
+      log.pop(); // Delivered in the order polled
+    }
+  #endif
+  if (!pool.release(msg)) {
+    Log.warningln(F("Released message with ID %i not from the pool"), msg->getId());
+  }
+}
+
+void CVEDirectManager::failedMessage(CBaseMessage *msg) {
+  settle(msg, false);
+  #ifdef VED_LOG
+    linkDown = true;
+    if (pool.findLog(msg) != NULL) {
+      // Still in the log, start over from the oldest undelivered one next time
+      logCursor = log.first();
+      logMarkerLeft = 0;
+    } else {
+      logMessage(msg);
+    }
+  #endif
+  pool.release(msg);
+}
+
+// Forgets a message in flight. The snapshots of a delivered one become what the deadband compares
+// against in later wakes, with the ack their sources are done for this wake.
+void CVEDirectManager::settle(CBaseMessage *msg, bool delivered) {
+  for (uint8_t i = 0; i < VED_INFLIGHT_SIZE; i++) {
+    if (inflight[i].msg != msg) {
+      continue;
+    }
+    if (delivered) {
+      for (uint8_t slot = 0; slot < VED_OUTBOX_SLOTS; slot++) {
+        if (inflight[i].sources & (1 << slot)) {
+          deadband.commit(polled[slot], CONFIG_getClock());
+        }
+      }
+      CONFIG_retainedSave(&deadbandState, sizeof(deadbandState), RETAINED_BLOCK_DEADBAND);
+      #ifdef RF24_ACK_MODE
+        outbox.setDelivered(inflight[i].sources);
+      #endif
+    }
+    inflight[i].msg = NULL;
+  }
+  #ifdef RF24_ACK_MODE
+    if (msg == statusMessage) {
+      statusDelivered = delivered;
+      statusMessage = NULL;
+    }
+  #endif
+}
+
+bool CVEDirectManager::isAllDelivered() {
+  #ifdef RF24_ACK_MODE
+    if (errorMessage != NULL || hasMessage()) {
+      return false;
+    }
+    for (uint8_t i = 0; i < VED_INFLIGHT_SIZE; i++) {
+      if (inflight[i].msg != NULL) {
+        return false;
+      }
+    }
+    #ifdef VED_AGGREGATE
+      if (aggregator.isPending(millis())) {
+        return false; // A device's first window of the wake is still filling
+      }
+    #endif
+    if (outbox.sourceCount() == 0) {
+      return statusDelivered; // Nothing on VE.Direct, the status message tells why
+    }
+    // A battery monitor sends its history in every other frame, wait a little for more sources
+    return outbox.isDelivered() && millis() - tsNewSource >= RF24_ACK_QUIET_MS;
+  #else
+    return false;
+  #endif
+}
+
+bool CVEDirectManager::commandEvent(uint8_t command, uint32_t value) {
+  if (command != RF24_COMMAND_RESEND) {
+    return false;
+  }
+  // Everything once more, this wake and the next, as if the gateway had never seen it
+  deadband.clear();
+  CONFIG_retainedSave(&deadbandState, sizeof(deadbandState), RETAINED_BLOCK_DEADBAND);
+  outbox.resend();
+  Log.noticeln(F("Resending %i sources on request"), outbox.sourceCount());
+  return true;
+}
+
+#ifdef VED_LOG
+
+void CVEDirectManager::logMessage(CBaseMessage *msg) {
+  if (!log.append(CONFIG_getClock(), msg->getMessageBuffer(), msg->getMessageLength())) {
+    Log.warningln(F("Message with ID %i too large for the log"), msg->getId());
+    return;
+  }
+  if (log.pendingCount() == 1) {
+    logCursor = log.first();
+  }
+  Log.noticeln(F("Logged message with ID %i, %i undelivered"), msg->getId(), log.pendingCount());
+}
+
+CBaseMessage* CVEDirectManager::pollBacklog() {
+  ved_log_record_t record;
+  if (backlogCount >= VED_LOG_DRAIN_PER_WAKE || !log.read(logCursor, &record)) {
+    return NULL;
+  }
+  CBaseMessage* msg;
+  if (logMarkerLeft == 0) {
+    // Records logged together share a marker, as many as this wake can still send
+    const uint8_t budget = VED_LOG_DRAIN_PER_WAKE - backlogCount - 1;
+    uint8_t count = 0;
+    ved_log_record_t following;
+    for (uint16_t cursor = logCursor; count < budget && log.read(cursor, &following) && following.clock == record.clock; log.next(&cursor)) {
+      count++;
+    }
+    if (count == 0) {
+      return NULL;
+    }
+    const uint32_t now = CONFIG_getClock();
+    bool known = record.clock <= now;
+    #if defined(SEEED_XIAO_M0)
+      known = known && static_cast<int16_t>(record.seq - logMountSeq) >= 0; // Flash keeps the log through a power loss, the clock restarts
+    #endif
+    const r24_message_log_marker_t marker { MSG_LOG_MARKER_ID, known ? now - record.clock : MSG_LOG_AGE_UNKNOWN, count };
+    msg = pool.create(marker);
+    if (msg != NULL) {
+      logMarkerLeft = count;
+    }
+  } else {
+    msg = pool.create(record);
+    if (msg != NULL) {
+      log.next(&logCursor);
+      logMarkerLeft--;
+    }
+  }
+  if (msg != NULL) {
+    backlogCount++;
+  }
+  return msg;
+}
+
+bool CVEDirectManager::hasBacklog() {
+  ved_log_record_t record;
+  if (backlogCount >= VED_LOG_DRAIN_PER_WAKE || !log.read(logCursor, &record)) {
+    return false;
+  }
+  // A new marker needs room for at least one record after it
+  return logMarkerLeft > 0 || backlogCount + 1 < VED_LOG_DRAIN_PER_WAKE;
+}
+#endif
@@ -1,47 +1,87 @@
 #pragma once
 
-#include <map>
-#include <queue>
-
 #include "BaseManager.h"
 #include "VEDMessageProvider.h"
 #include "SensorProvider.h"
+#include "VEDirectParser.h"
+#include "VEDirectHex.h"
+#include "VEDirectSchema.h"
+#include "VEDirectOutbox.h"
+#include "VEDirectDeadband.h"
+#include "VEDirectAggregate.h"
+#include "VEDirectLog.h"
+#include "VEDirectRegistry.h"
+#include "LockFreeRing.h"
+#include "MessagePool.h"
+
+#define VED_INFLIGHT_SIZE 4 // Polled messages not released yet, the radio holds up to its TX FIFO
 
-class CVEDirectManager: public CBaseManager, public IVEDMessageProvider {
+class CVEDirectManager: public CBaseManager, public IVEDMessageProvider, public IVEDFrameHandler, public IVEDHexHandler {
 
 private:
   unsigned long tMillis;
   unsigned long tMillisError;
+  unsigned long tsAwake;
   bool jobDone;
 
   Stream *VEDirectStream;
-  std::map<String, String> mVEData;
-
-  enum States {
-        IDLE,
-        RECORD_BEGIN,
-        RECORD_NAME,
-        RECORD_VALUE,
-        CHECKSUM,
-        RECORD_HEX
-    };
-
-  int mState;
-  uint8_t	mChecksum;
-  char *mTextPointer;
-  char mName[9];
-  char mValue[33]; 
-
-  std::queue<CBaseMessage*> messages;
+  CLockFreeRing<uint8_t, VED_RX_BUFFER_SIZE> rxRing;
+  uint32_t uartOverflows;
+  CVEDirectParser parser;
+  CVEDirectHex hex;
+  ved_snapshot_t hexSnapshot;
+  uint8_t hexField;
+
+  CMessagePool pool;
+  CVEDOutbox outbox;
+  CVEDDeadband deadband;
+  CVEDAggregator aggregator;
+  CVEDRegistry registry;
+  uint8_t suppressedCount;
+  bool phasesSent;
+  CBaseMessage *errorMessage;
+  #ifdef VED_LOG
+    CVEDLog log;
+    uint16_t logCursor;       // Next record to poll, runs ahead of the tail by what is in flight
+    uint16_t logMountSeq;
+    uint8_t logMarkerLeft;    // Records still to follow the last marker
+    uint8_t backlogCount;
+    bool linkUp, linkDown;    // A message was delivered / given up on since power up
+  #endif
+  typedef struct {
+    CBaseMessage *msg;
+    uint8_t sources;          // Outbox sources of the snapshots in the message
+  } inflight_t;
+  inflight_t inflight[VED_INFLIGHT_SIZE];
+  uint8_t pollSources;        // Of the message nextMessage() returns
+  ved_snapshot_t polled[VED_OUTBOX_SLOTS]; // Last snapshot polled per source, committed to the deadband once delivered
+  #ifdef RF24_ACK_MODE
+    unsigned long tsNewSource;
+    CBaseMessage *statusMessage;
+    bool statusDelivered;
+  #endif
   ISensorProvider* sensor;
 
   uint16_t lastPid;
-  uint16_t randomDelay;
+  uint16_t registryFullPid;   // Last PID the full registry couldn't take, warned about once a wake
   
-  void rxData(uint8_t inbyte);
-  bool hexRxEvent(uint8_t inbyte);
-  void frameEndEvent();
-  void addMessage(CBaseMessage *msg);
+  void addSnapshot(const ved_snapshot_t &snap, float temp);
+  CBaseMessage* createMessage(const ved_snapshot_t &snap, float temp);
+  CBaseMessage* createPackedMessage();
+  CBaseMessage* nextMessage();
+  void settle(CBaseMessage *msg, bool delivered);
+  #ifdef VED_LOG
+    CBaseMessage* pollBacklog();
+    bool hasBacklog();
+    void logMessage(CBaseMessage *msg);
+  #endif
+  bool isWorthSending(const ved_snapshot_t &snap, uint8_t source);
+  uint8_t getTemperatureProbe(uint16_t pid);
+  float getCurrentTemperature(uint16_t pid, float captured);
+  bool isTemperatureSettled();
+  uint8_t learnDevice(uint16_t pid, const CVEDFrame &frame);
+  void startHexQuery();
+  void requestHexField();
   
 public:
 	CVEDirectManager(ISensorProvider* sensor);
@@ -52,6 +92,30 @@ public:
   virtual void powerDown();
   virtual void powerUp();
   virtual const bool isJobDone() { return jobDone; }
+  virtual const uint32_t getIdleMs();
 
   virtual CBaseMessage* pollMessage();
+  virtual bool hasMessage();
+  virtual void releaseMessage(CBaseMessage *msg);
+  virtual void failedMessage(CBaseMessage *msg);
+  virtual bool isAllDelivered();
+  virtual bool commandEvent(uint8_t command, uint32_t value);
+  #ifdef VED_LOG
+    virtual uint8_t getBacklogCount() { return backlogCount; }
+    const ved_log_stats_t& getLogStats() const { return log.getStats(); }
+  #endif
+  virtual uint8_t getSuppressedCount() { return suppressedCount; }
+  const ved_deadband_stats_t& getDeadbandStats() const { return deadband.getStats(); }
+
+  // Moves received bytes from the UART driver into the RX ring, safe to call from yield()
+  void pumpRx();
+  uint32_t getRxOverflows() const { return rxRing.getOverflows() + uartOverflows; }
+
+  // IVEDFrameHandler
+  virtual void frameEndEvent(const CVEDFrame &frame);
+  virtual bool hexRxEvent(uint8_t inbyte);
+
+  // IVEDHexHandler
+  virtual void hexWrite(const uint8_t *buffer, uint8_t length);
+  virtual void hexResponse(uint8_t command, uint16_t reg, VEDHexStatus status, const uint8_t *data, uint8_t length);
 };
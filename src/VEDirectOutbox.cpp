@@ -0,0 +1,112 @@
+#include <string.h>
+
+#include "VEDirectOutbox.h"
+
+CVEDOutbox::CVEDOutbox()
+:cursor(0) {
+  memset(slots, 0, sizeof(slots));
+  memset(&stats, 0, sizeof(stats));
+}
+
+bool CVEDOutbox::put(const ved_snapshot_t &snapshot, float temperature) {
+  slot_t *target = NULL;
+  slot_t *idle = NULL;
+  for (uint8_t i = 0; i < VED_OUTBOX_SLOTS; i++) {
+    slot_t &slot = slots[i];
+    if (slot.used && slot.snapshot.deviceClass == snapshot.deviceClass && slot.snapshot.pid == snapshot.pid) {
+      target = &slot;
+      break;
+    }
+    if (idle == NULL && (!slot.used || !slot.pending)) {
+      idle = &slot;
+    }
+  }
+
+  if (target == NULL) {
+    if (idle == NULL) {
+      stats.dropped++;
+      return false;
+    }
+    target = idle;
+    target->delivered = false; // Another source
+  } else if (target->pending) {
+    stats.coalesced++;
+  }
+
+  target->snapshot = snapshot;
+  target->temperature = temperature;
+  target->used = true;
+  target->pending = !target->delivered;
+  stats.added++;
+  return true;
+}
+
+bool CVEDOutbox::take(ved_snapshot_t *snapshot, float *temperature, uint8_t *source) {
+  for (uint8_t n = 0; n < VED_OUTBOX_SLOTS; n++) {
+    cursor = (cursor + 1) % VED_OUTBOX_SLOTS;
+    slot_t &slot = slots[cursor];
+    if (slot.pending) {
+      slot.pending = false;
+      *snapshot = slot.snapshot;
+      *temperature = slot.temperature;
+      if (source != NULL) {
+        *source = 1 << cursor;
+      }
+      stats.taken++;
+      return true;
+    }
+  }
+  return false;
+}
+
+void CVEDOutbox::setDelivered(uint8_t sources) {
+  for (uint8_t i = 0; i < VED_OUTBOX_SLOTS; i++) {
+    if (sources & (1 << i)) {
+      slots[i].delivered = true;
+    }
+  }
+}
+
+void CVEDOutbox::resend() {
+  for (uint8_t i = 0; i < VED_OUTBOX_SLOTS; i++) {
+    slots[i].delivered = false;
+    slots[i].pending = slots[i].used;
+  }
+}
+
+void CVEDOutbox::clear() {
+  for (uint8_t i = 0; i < VED_OUTBOX_SLOTS; i++) {
+    slots[i].used = false;
+    slots[i].pending = false;
+    slots[i].delivered = false;
+  }
+}
+
+uint8_t CVEDOutbox::pendingCount() const {
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < VED_OUTBOX_SLOTS; i++) {
+    if (slots[i].pending) {
+      n++;
+    }
+  }
+  return n;
+}
+
+uint8_t CVEDOutbox::sourceCount() const {
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < VED_OUTBOX_SLOTS; i++) {
+    if (slots[i].used) {
+      n++;
+    }
+  }
+  return n;
+}
+
+bool CVEDOutbox::isDelivered() const {
+  for (uint8_t i = 0; i < VED_OUTBOX_SLOTS; i++) {
+    if (slots[i].used && !slots[i].delivered) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "VEDirectSchema.h"
+
+#define VED_OUTBOX_SLOTS 4 // Distinct sources (device class, PID) held at once
+static_assert(VED_OUTBOX_SLOTS <= 8, "Sources are passed around as bits of a byte");
+
+typedef struct ved_outbox_stats_t {
+  uint32_t added;
+  uint32_t coalesced;   // Pending snapshots replaced by a newer one from the same source
+  uint32_t dropped;     // New source while every slot held a pending snapshot
+  uint32_t taken;
+} ved_outbox_stats_t;
+
+// Latest-value outbox with one slot per (device class, PID). A new snapshot replaces
+// the pending one of its source, and sources are drained round-robin.
+//
+// With acknowledgements a source is marked delivered once a message with its snapshot was
+// acked, and later snapshots of it are not queued again until resend() or clear().
+class CVEDOutbox {
+
+private:
+  typedef struct slot_t {
+    ved_snapshot_t snapshot;
+    float temperature;
+    bool used;
+    bool pending;
+    bool delivered;
+  } slot_t;
+
+  slot_t slots[VED_OUTBOX_SLOTS];
+  uint8_t cursor;
+  ved_outbox_stats_t stats;
+
+public:
+  CVEDOutbox();
+
+  // Stores the newest snapshot of its source, false if it had to be dropped
+  bool put(const ved_snapshot_t &snapshot, float temperature);
+  // Copies out the next pending snapshot after the last one taken, false when none is pending.
+  // source, if given, receives the bit of its slot for setDelivered().
+  bool take(ved_snapshot_t *snapshot, float *temperature, uint8_t *source = NULL);
+  // Marks the sources of a mask of take() bits as delivered
+  void setDelivered(uint8_t sources);
+  // Queues the last snapshot of every source again, delivered or not
+  void resend();
+  // Forgets all sources
+  void clear();
+
+  uint8_t pendingCount() const;
+  uint8_t sourceCount() const;
+  // Every source seen was delivered, true without sources
+  bool isDelivered() const;
+  bool isEmpty() const { return pendingCount() == 0; }
+  const ved_outbox_stats_t& getStats() const { return stats; }
+};
@@ -0,0 +1,175 @@
+#include <math.h>
+#include <string.h>
+
+#include "VEDirectPacked.h"
+
+#define VED_PACKED_CLASS_MASK 0x0F
+#define VED_PACKED_VARINT_MAX 5
+
+static uint8_t writeVarint(uint32_t value, uint8_t *out) {
+  uint8_t n = 0;
+  while (value >= 0x80) {
+    out[n++] = static_cast<uint8_t>(value) | 0x80;
+    value >>= 7;
+  }
+  out[n++] = static_cast<uint8_t>(value);
+  return n;
+}
+
+static uint32_t zigzag(int32_t value) {
+  return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value) {
+  return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+}
+
+// Rounds half away from zero
+static int32_t quantize(int32_t value, uint8_t quantum) {
+  if (quantum == 1) {
+    return value;
+  }
+  return value >= 0 ? (value + quantum / 2) / quantum : -((-value + quantum / 2) / quantum);
+}
+
+static bool isSigned(VEDFieldType type) {
+  return type != VED_FIELD_U8 && type != VED_FIELD_U16;
+}
+
+uint8_t VED_packedQuantum(VEDUnit unit) {
+  switch(unit) {
+    case VED_UNIT_MV: return 10;
+    case VED_UNIT_MA: return 10;
+    case VED_UNIT_MAH: return 10;
+    default: return 1;
+  }
+}
+
+CVEDPackedWriter::CVEDPackedWriter() {
+  begin(0);
+}
+
+void CVEDPackedWriter::begin(float temperature) {
+  const int32_t deciC = isnan(temperature) ? VED_PACKED_NO_TEMPERATURE : static_cast<int32_t>(temperature * 10 + (temperature < 0 ? -0.5f : 0.5f));
+  buffer[0] = VED_PACKED_ID | VED_PACKED_VERSION;
+  length = 1 + writeVarint(zigzag(deciC), buffer + 1);
+  records = 0;
+  lastPid = 0;
+}
+
+uint8_t CVEDPackedWriter::encodeRecord(const ved_snapshot_t &snapshot, uint8_t *out) const {
+  const VEDSchema *schema = VED_schema(snapshot.deviceClass);
+  const uint16_t allPresent = static_cast<uint16_t>((1 << schema->count) - 1);
+  uint8_t n = 1;
+
+  out[0] = snapshot.deviceClass & VED_PACKED_CLASS_MASK;
+  if (records > 0 && snapshot.pid == lastPid) {
+    out[0] |= VED_PACKED_SAME_PID;
+  } else {
+    out[n++] = snapshot.pid & 0xFF;
+    out[n++] = snapshot.pid >> 8;
+  }
+  if ((snapshot.present & allPresent) == allPresent) {
+    out[0] |= VED_PACKED_ALL_PRESENT;
+  } else {
+    n += writeVarint(snapshot.present & allPresent, out + n);
+  }
+  for (uint8_t f = 0; f < schema->count; f++) {
+    if (snapshot.present & (1 << f)) {
+      const VEDFieldSpec &spec = schema->fields[f];
+      const int32_t value = quantize(snapshot.raw[f], VED_packedQuantum(spec.unit));
+      n += writeVarint(isSigned(spec.type) ? zigzag(value) : static_cast<uint32_t>(value), out + n);
+    }
+  }
+  return n;
+}
+
+bool CVEDPackedWriter::fits(const ved_snapshot_t &snapshot) const {
+  uint8_t record[4 + VED_SNAPSHOT_MAX_FIELDS * VED_PACKED_VARINT_MAX];
+  return length + encodeRecord(snapshot, record) <= VED_PACKED_MAX_SIZE;
+}
+
+bool CVEDPackedWriter::add(const ved_snapshot_t &snapshot) {
+  uint8_t record[4 + VED_SNAPSHOT_MAX_FIELDS * VED_PACKED_VARINT_MAX];
+  const uint8_t n = encodeRecord(snapshot, record);
+  if (length + n > VED_PACKED_MAX_SIZE) {
+    return false;
+  }
+  memcpy(buffer + length, record, n);
+  length += n;
+  records++;
+  lastPid = snapshot.pid;
+  return true;
+}
+
+CVEDPackedReader::CVEDPackedReader(const uint8_t *buffer, uint8_t length)
+:buffer(buffer), length(length), position(1), lastPid(0), temperature(0), valid(false) {
+  if (length < 2 || buffer[0] != (VED_PACKED_ID | VED_PACKED_VERSION)) {
+    return;
+  }
+  uint32_t deciC;
+  if (readVarint(&deciC)) {
+    const int32_t value = unzigzag(deciC);
+    temperature = value == VED_PACKED_NO_TEMPERATURE ? NAN : value / 10.0f;
+    valid = true;
+  }
+}
+
+bool CVEDPackedReader::readVarint(uint32_t *value) {
+  *value = 0;
+  for (uint8_t shift = 0; shift < 7 * VED_PACKED_VARINT_MAX && position < length; shift += 7) {
+    const uint8_t b = buffer[position++];
+    *value |= static_cast<uint32_t>(b & 0x7F) << shift;
+    if (!(b & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool CVEDPackedReader::next(ved_snapshot_t *snapshot) {
+  if (!valid || position >= length || buffer[position] == 0) {
+    return false;
+  }
+  const uint8_t tag = buffer[position++];
+  const uint8_t deviceClass = tag & VED_PACKED_CLASS_MASK;
+  if (deviceClass == VED_CLASS_NONE || deviceClass >= VED_CLASS_COUNT) {
+    valid = false;
+    return false;
+  }
+  const VEDSchema *schema = VED_schema(deviceClass);
+
+  memset(snapshot, 0, sizeof(*snapshot));
+  snapshot->deviceClass = deviceClass;
+  if (tag & VED_PACKED_SAME_PID) {
+    snapshot->pid = lastPid;
+  } else {
+    if (position + 2 > length) {
+      valid = false;
+      return false;
+    }
+    snapshot->pid = buffer[position] | (buffer[position + 1] << 8);
+    position += 2;
+  }
+  lastPid = snapshot->pid;
+
+  uint32_t present = (1 << schema->count) - 1;
+  if (!(tag & VED_PACKED_ALL_PRESENT) && !readVarint(&present)) {
+    valid = false;
+    return false;
+  }
+  snapshot->present = static_cast<uint16_t>(present & ((1 << schema->count) - 1));
+
+  for (uint8_t f = 0; f < schema->count; f++) {
+    if (snapshot->present & (1 << f)) {
+      uint32_t value;
+      if (!readVarint(&value)) {
+        valid = false;
+        return false;
+      }
+      const VEDFieldSpec &spec = schema->fields[f];
+      snapshot->raw[f] = (isSigned(spec.type) ? unzigzag(value) : static_cast<int32_t>(value)) * VED_packedQuantum(spec.unit);
+    }
+  }
+  return true;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "VEDirectSchema.h"
+
+// Packed multi-record payload, several device snapshots in one radio frame.
+//
+//   [0] VED_PACKED_ID | VED_PACKED_VERSION  [1..] temperature, zigzag varint in 0.1C,
+//                                            VED_PACKED_NO_TEMPERATURE without a current reading
+//   records until the end of the payload or a zero tag:
+//     tag      bits 0-3 device class, VED_PACKED_SAME_PID, VED_PACKED_ALL_PRESENT
+//     pid      2 bytes little endian, left out with VED_PACKED_SAME_PID
+//     present  varint field mask, left out with VED_PACKED_ALL_PRESENT
+//     values   varint per present field in schema order, zigzag for signed field types,
+//              TEXT protocol units divided by the unit's quantum (VED_packedQuantum)
+//
+// A change to the quanta or layout needs a new VED_PACKED_VERSION.
+
+#define VED_PACKED_ID 0xA0          // High nibble of the first payload byte, next to the MSG_*_ID of the fixed layout messages
+#define VED_PACKED_VERSION 1        // Low nibble
+#define VED_PACKED_MAX_SIZE 32      // nRF24 payload
+#define VED_PACKED_SAME_PID 0x10
+#define VED_PACKED_ALL_PRESENT 0x20
+#define VED_PACKED_NO_TEMPERATURE INT16_MIN // In place of the temperature when there was no current reading
+
+// Resolution of a unit on air
+uint8_t VED_packedQuantum(VEDUnit unit);
+
+class CVEDPackedWriter {
+
+private:
+  uint8_t buffer[VED_PACKED_MAX_SIZE];
+  uint8_t length;
+  uint8_t records;
+  uint16_t lastPid;
+
+  uint8_t encodeRecord(const ved_snapshot_t &snapshot, uint8_t *out) const;
+
+public:
+  CVEDPackedWriter();
+
+  // NAN temperature when there is no current reading
+  void begin(float temperature);
+  // True if the record still fits
+  bool fits(const ved_snapshot_t &snapshot) const;
+  // Appends the record if it fits
+  bool add(const ved_snapshot_t &snapshot);
+
+  const uint8_t* getBuffer() const { return buffer; }
+  uint8_t getLength() const { return length; }
+  uint8_t getRecordCount() const { return records; }
+};
+
+class CVEDPackedReader {
+
+private:
+  const uint8_t *buffer;
+  uint8_t length;
+  uint8_t position;
+  uint16_t lastPid;
+  float temperature;
+  bool valid;
+
+  bool readVarint(uint32_t *value);
+
+public:
+  CVEDPackedReader(const uint8_t *buffer, uint8_t length);
+
+  // Header id and version recognized
+  bool isValid() const { return valid; }
+  // NAN when the sender had no current reading
+  float getTemperature() const { return temperature; }
+  // Decodes the next record, false at the end or on a truncated record
+  bool next(ved_snapshot_t *snapshot);
+};
@@ -0,0 +1,128 @@
+#include <ctype.h>
+#include <string.h>
+
+#include "VEDirectParser.h"
+
+// Protocol https://www.victronenergy.com/upload/documents/VE.Direct-Protocol-3.33.pdf
+
+CVEDirectParser::CVEDirectParser(IVEDFrameHandler *handler)
+:handler(handler), mState(IDLE), mPrevState(IDLE), mChecksum(0), mTextPointer(0), mNameHash(VED_LABEL_HASH_SEED), mLabel(VED_LABEL_UNKNOWN) {
+  memset(&stats, 0, sizeof(stats));
+}
+
+void CVEDirectParser::reset() {
+  mState = IDLE;
+  mChecksum = 0;
+  mFrame.clear();
+}
+
+void CVEDirectParser::rxData(uint8_t inbyte) {
+
+  stats.bytes++;
+  if ( (inbyte == ':') && (mState != CHECKSUM) ) {
+    if (mState != RECORD_HEX) {
+      stats.hexMessages++;
+      mPrevState = mState;
+    }
+    mState = RECORD_HEX;
+  }
+  if (mState != RECORD_HEX) {
+    mChecksum += inbyte;
+  }
+  inbyte = toupper(inbyte);
+
+  switch(mState) {
+    case IDLE:
+      /* wait for \n of the start of an record */
+      switch(inbyte) {
+        case '\n':
+          mState = RECORD_BEGIN;
+          break;
+        case '\r': /* Skip */
+        default:
+          break;
+      }
+      break;
+    case RECORD_BEGIN:
+      mTextPointer = mName;
+      *mTextPointer++ = inbyte;
+      mNameHash = VED_labelHashStep(VED_LABEL_HASH_SEED, inbyte);
+      mState = RECORD_NAME;
+      break;
+    case RECORD_NAME:
+      // The record name is being received, terminated by a \t
+      switch(inbyte) {
+      case '\t':
+        // the Checksum record indicates a EOR
+        mLabel = VED_LABEL_UNKNOWN;
+        if ( mTextPointer < (mName + sizeof(mName)) ) {
+          *mTextPointer = 0; /* Zero terminate */
+          mLabel = VED_labelLookup(mNameHash, mName);
+          if (mLabel == VED_LABEL_CHECKSUM) {
+            mState = CHECKSUM;
+            break;
+          }
+        } else {
+          stats.droppedRecords++;
+        }
+        mTextPointer = mValue; /* Reset value pointer */
+        mDecoder.begin(VED_labelRadix(mLabel));
+        mState = RECORD_VALUE;
+        break;
+      default:
+        // add byte to name, but do no overflow
+        if ( mTextPointer < (mName + sizeof(mName)) ) {
+          *mTextPointer++ = inbyte;
+          mNameHash = VED_labelHashStep(mNameHash, inbyte);
+        }
+        break;
+      }
+      break;
+    case RECORD_VALUE:
+      // The record value is being received.  The \r indicates a new record.
+      switch(inbyte) {
+      case '\n':
+        // forward record, only if it could be stored completely
+        if ( mTextPointer < (mValue + sizeof(mValue)) ) {
+          *mTextPointer = 0; // make zero ended
+          if (!mFrame.set(mLabel, mValue, mTextPointer - mValue, mDecoder)) {
+            stats.droppedRecords++;
+          }
+        } else {
+          stats.droppedRecords++;
+        }
+        mState = RECORD_BEGIN;
+        break;
+      case '\r': /* Skip */
+        break;
+      default:
+        // add byte to value, but do no overflow
+        if ( mTextPointer < (mValue + sizeof(mValue)) ) {
+          *mTextPointer++ = inbyte;
+          mDecoder.step(inbyte);
+        }
+        break;
+      }
+      break;
+    case CHECKSUM: {
+      if (mChecksum != 0) {
+        stats.checksumErrors++;
+      } else if (mFrame.size() == 0) {
+        stats.emptyFrames++;
+      } else {
+        stats.frames++;
+        handler->frameEndEvent(mFrame);
+      }
+      mChecksum = 0;
+      mState = IDLE;
+      mFrame.clear();
+      break;
+    }
+    case RECORD_HEX:
+      // HEX messages are excluded from the checksum, so the interrupted TEXT frame can continue
+      if (handler->hexRxEvent(inbyte)) {
+        mState = mPrevState;
+      }
+      break;
+  }
+}
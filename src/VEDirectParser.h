@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "VEDirectFrame.h"
+
+// Receives the output of the TEXT protocol state machine
+class IVEDFrameHandler {
+public:
+  // Called with a complete frame whose checksum verified
+  virtual void frameEndEvent(const CVEDFrame &frame) {};
+  // Called for every byte of a HEX message (starting with ':'), return true once the message ended
+  virtual bool hexRxEvent(uint8_t inbyte) { return true; };
+};
+
+typedef struct ved_parser_stats_t {
+  uint32_t bytes;
+  uint32_t frames;            // Frames handed to frameEndEvent
+  uint32_t checksumErrors;
+  uint32_t emptyFrames;
+  uint32_t droppedRecords;    // Name or value overflow, or frame store full
+  uint32_t hexMessages;
+} ved_parser_stats_t;
+
+// VE.Direct TEXT protocol state machine, free of any Arduino dependency so it builds on the host
+class CVEDirectParser {
+
+private:
+  enum States {
+        IDLE,
+        RECORD_BEGIN,
+        RECORD_NAME,
+        RECORD_VALUE,
+        CHECKSUM,
+        RECORD_HEX
+    };
+
+  IVEDFrameHandler *handler;
+
+  int mState;
+  int mPrevState;   // TEXT state to resume after a HEX message
+  uint8_t	mChecksum;
+  char *mTextPointer;
+  uint32_t mNameHash;
+  VEDLabel mLabel;
+  CVEDValueDecoder mDecoder;
+  char mName[9];
+  char mValue[33];
+
+  CVEDFrame mFrame;
+  ved_parser_stats_t stats;
+
+public:
+  CVEDirectParser(IVEDFrameHandler *handler);
+
+  void rxData(uint8_t inbyte);
+  void reset();
+
+  // Records received so far of the frame in progress
+  const CVEDFrame& frame() const { return mFrame; }
+  const ved_parser_stats_t& getStats() const { return stats; }
+};
@@ -0,0 +1,144 @@
+#include <string.h>
+
+#include "VEDirectRegistry.h"
+
+// Sorted by PID
+static const ved_pid_entry_t builtinPids[] = {
+  { 0xA055, VED_CLASS_MPPT, 0 },
+  { 0xA057, VED_CLASS_MPPT, 0 },
+  { 0xA2FA, VED_CLASS_INV,  0 },
+  { 0xA389, VED_CLASS_BATT, VED_PID_SUPPLEMENTALS } // SmartShunt, history in a second frame
+};
+#define BUILTIN_PIDS (sizeof(builtinPids) / sizeof(builtinPids[0]))
+
+static uint8_t crc8(uint8_t crc, const uint8_t *data, uint16_t length) {
+  while (length--) {
+    crc ^= *data++;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+CVEDRegistry::CVEDRegistry()
+:count(0), last(NULL) {
+}
+
+const ved_pid_entry_t* CVEDRegistry::search(const ved_pid_entry_t *table, uint8_t size, uint16_t pid) {
+  uint8_t lo = 0, hi = size;
+  while (lo < hi) {
+    const uint8_t mid = (lo + hi) / 2;
+    if (table[mid].pid < pid) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo < size && table[lo].pid == pid ? table + lo : NULL;
+}
+
+const ved_pid_entry_t* CVEDRegistry::find(uint16_t pid) {
+  if (last != NULL && last->pid == pid) {
+    return last;
+  }
+  const ved_pid_entry_t *entry = search(entries, count, pid);
+  if (entry == NULL) {
+    entry = search(builtinPids, BUILTIN_PIDS, pid);
+  }
+  if (entry != NULL) {
+    last = entry;
+  }
+  return entry;
+}
+
+bool CVEDRegistry::add(uint16_t pid, uint8_t deviceClass, uint8_t flags) {
+  if (deviceClass >= VED_CLASS_COUNT) {
+    return false;
+  }
+  uint8_t i = 0;
+  while (i < count && entries[i].pid < pid) {
+    i++;
+  }
+  if (i == count || entries[i].pid != pid) {
+    if (count == VED_REGISTRY_MAX_ENTRIES) {
+      return false;
+    }
+    memmove(entries + i + 1, entries + i, (count - i) * sizeof(entries[0]));
+    count++;
+  }
+  entries[i].pid = pid;
+  entries[i].deviceClass = deviceClass;
+  entries[i].flags = flags;
+  last = NULL; // Entries moved
+  return true;
+}
+
+bool CVEDRegistry::remove(uint16_t pid) {
+  ved_pid_entry_t *entry = const_cast<ved_pid_entry_t*>(search(entries, count, pid));
+  if (entry == NULL) {
+    return false;
+  }
+  memmove(entry, entry + 1, (entries + count - entry - 1) * sizeof(entries[0]));
+  count--;
+  last = NULL;
+  return true;
+}
+
+void CVEDRegistry::clear() {
+  count = 0;
+  last = NULL;
+}
+
+bool CVEDRegistry::load(IVEDLogStore *store) {
+  clear();
+  uint8_t blob[VED_REGISTRY_BLOB_SIZE];
+  if (store->getSize() < sizeof(blob)) {
+    return false;
+  }
+  store->read(0, blob, 3);
+  const uint8_t n = blob[2];
+  if ((blob[0] | (blob[1] << 8)) != VED_REGISTRY_MAGIC || n > VED_REGISTRY_MAX_ENTRIES) {
+    return false;
+  }
+  const uint16_t length = 3 + n * VED_REGISTRY_ENTRY_SIZE;
+  store->read(3, blob + 3, length - 3 + 1);
+  if (crc8(0, blob + 2, length - 2) != blob[length]) {
+    return false;
+  }
+  // Through add(), a hand written blob doesn't have to be sorted
+  for (uint8_t i = 0; i < n; i++) {
+    const uint8_t *e = blob + 3 + i * VED_REGISTRY_ENTRY_SIZE;
+    add(e[0] | (e[1] << 8), e[2], e[3]);
+  }
+  return true;
+}
+
+void CVEDRegistry::save(IVEDLogStore *store) {
+  uint8_t blob[VED_REGISTRY_BLOB_SIZE];
+  blob[0] = VED_REGISTRY_MAGIC & 0xFF;
+  blob[1] = VED_REGISTRY_MAGIC >> 8;
+  blob[2] = count;
+  for (uint8_t i = 0; i < count; i++) {
+    uint8_t *e = blob + 3 + i * VED_REGISTRY_ENTRY_SIZE;
+    e[0] = entries[i].pid & 0xFF;
+    e[1] = entries[i].pid >> 8;
+    e[2] = entries[i].deviceClass;
+    e[3] = entries[i].flags;
+  }
+  const uint16_t length = 3 + count * VED_REGISTRY_ENTRY_SIZE;
+  blob[length] = crc8(0, blob + 2, length - 2);
+  store->erase(0);
+  store->program(0, blob, length + 1);
+}
+
+uint8_t CVEDRegistry::classify(const CVEDFrame &frame) {
+  if (frame.has(VED_LABEL_PPV) && frame.has(VED_LABEL_VPV)) {
+    return VED_CLASS_MPPT;
+  } else if (frame.has(VED_LABEL_AC_OUT_V)) {
+    return VED_CLASS_INV;
+  } else if (frame.has(VED_LABEL_SOC) || frame.has(VED_LABEL_CE)) {
+    return VED_CLASS_BATT;
+  }
+  return VED_CLASS_NONE;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "VEDirectSchema.h"
+#include "VEDirectLog.h"
+
+// Maps VE.Direct product ids to the device class, and so the schema, their frames are captured with.
+//
+// The built-in table is sorted by PID and stays in flash. Entries added at runtime, loaded from a
+// config blob or learned from frames, are kept sorted in RAM and take precedence, so a device can
+// be added or a built-in one reclassified without a rebuild. Frames of one device come in a row,
+// the last entry found answers the next lookup without a search.
+//
+// Config blob at the start of sector 0 of its store:
+//   magic   VED_REGISTRY_MAGIC, 2 bytes
+//   count   entries
+//   entries VED_REGISTRY_ENTRY_SIZE bytes each: pid (2 bytes, little endian), device class, flags
+//   crc     CRC-8 of count and entries
+
+#define VED_REGISTRY_MAGIC 0x5256
+#define VED_REGISTRY_MAX_ENTRIES 16
+#define VED_REGISTRY_ENTRY_SIZE 4
+#define VED_REGISTRY_BLOB_SIZE (4 + VED_REGISTRY_MAX_ENTRIES * VED_REGISTRY_ENTRY_SIZE)
+
+#define VED_PID_SUPPLEMENTALS 0x01  // Frames without a PID that follow belong to this device
+#define VED_PID_LEARNED       0x80  // Classified from the labels of its frames
+
+typedef struct ved_pid_entry_t {
+  uint16_t pid;
+  uint8_t deviceClass;  // VED_CLASS_NONE ignores the device
+  uint8_t flags;
+} ved_pid_entry_t;
+
+class CVEDRegistry {
+
+private:
+  ved_pid_entry_t entries[VED_REGISTRY_MAX_ENTRIES];
+  uint8_t count;
+  const ved_pid_entry_t *last;
+
+  static const ved_pid_entry_t* search(const ved_pid_entry_t *table, uint8_t size, uint16_t pid);
+
+public:
+  CVEDRegistry();
+
+  // NULL for an unknown PID
+  const ved_pid_entry_t* find(uint16_t pid);
+  uint8_t getDeviceClass(uint16_t pid) { const ved_pid_entry_t *e = find(pid); return e != NULL ? e->deviceClass : static_cast<uint8_t>(VED_CLASS_NONE); }
+  bool hasSupplementals(uint16_t pid) { const ved_pid_entry_t *e = find(pid); return e != NULL && (e->flags & VED_PID_SUPPLEMENTALS); }
+
+  // Adds or replaces a runtime entry, false when the table is full
+  bool add(uint16_t pid, uint8_t deviceClass, uint8_t flags);
+  bool remove(uint16_t pid);
+  // Back to the built-in table only
+  void clear();
+  uint8_t getCount() const { return count; }
+  const ved_pid_entry_t& getEntry(uint8_t index) const { return entries[index]; }
+
+  // Replaces the runtime entries with the blob in the store, false and empty when it holds none
+  bool load(IVEDLogStore *store);
+  void save(IVEDLogStore *store);
+
+  // Guesses the class of an unknown device from the labels in its frame, VED_CLASS_NONE if unsure
+  static uint8_t classify(const CVEDFrame &frame);
+};
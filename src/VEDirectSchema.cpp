@@ -0,0 +1,95 @@
+#include "VEDirectSchema.h"
+#include "VEDirectHex.h"
+
+// HEX registers from the BlueSolar/SmartSolar, BMV/SmartShunt and Phoenix inverter HEX protocol documents
+static constexpr VEDFieldSpec fieldsMPPT[VED_MPPT_FIELDS] = {
+  { VED_LABEL_V,    VED_FIELD_F32, VED_UNIT_MV,       0.001f, 0xEDD5, VED_HEX_UN16, 10, 1 },   // Battery voltage mV -> V
+  { VED_LABEL_I,    VED_FIELD_F32, VED_UNIT_MA,       0.001f, 0xEDD7, VED_HEX_UN16, 100, 1 },  // Battery current mA -> A
+  { VED_LABEL_VPV,  VED_FIELD_F32, VED_UNIT_MV,       0.001f, 0xEDBB, VED_HEX_UN16, 10, 1 },   // Panel voltage mV -> V
+  { VED_LABEL_PPV,  VED_FIELD_F32, VED_UNIT_W,        1,      0xEDBC, VED_HEX_UN32, 1, 100 },  // Panel power W
+  { VED_LABEL_CS,   VED_FIELD_U8,  VED_UNIT_STATE,    1,      0x0201, VED_HEX_UN8,  1, 1 },
+  { VED_LABEL_MPPT, VED_FIELD_U8,  VED_UNIT_STATE,    1,      0xEDB3, VED_HEX_UN8,  1, 1 },
+  { VED_LABEL_OR,   VED_FIELD_U8,  VED_UNIT_STATE,    1,      0x0207, VED_HEX_UN32, 1, 1 },
+  { VED_LABEL_ERR,  VED_FIELD_U8,  VED_UNIT_STATE,    1,      0xEDDA, VED_HEX_UN8,  1, 1 },
+  { VED_LABEL_H20,  VED_FIELD_U16, VED_UNIT_OTHER,    10,     0xEDD3, VED_HEX_UN16, 1, 1 },    // Yield today 0.01kWh -> Wh
+  { VED_LABEL_H21,  VED_FIELD_U16, VED_UNIT_W,        1,      0xEDD2, VED_HEX_UN16, 1, 1 }     // Max power today W
+};
+
+static constexpr VEDFieldSpec fieldsINV[VED_INV_FIELDS] = {
+  { VED_LABEL_V,        VED_FIELD_F32, VED_UNIT_MV,       0.001f, 0xED8D, VED_HEX_SN16, 10, 1 },  // Battery voltage mV -> V
+  { VED_LABEL_AC_OUT_I, VED_FIELD_F32, VED_UNIT_OTHER,    0.1f,   0x2201, VED_HEX_SN16, 1, 1 },   // AC current 0.1A -> A
+  { VED_LABEL_AC_OUT_V, VED_FIELD_F32, VED_UNIT_OTHER,    0.01f,  0x2200, VED_HEX_SN16, 1, 1 },   // AC voltage 0.01V -> V
+  { VED_LABEL_AC_OUT_S, VED_FIELD_F32, VED_UNIT_W,        1,      0,      VED_HEX_NONE, 1, 1 },   // Apparent power VA
+  { VED_LABEL_CS,       VED_FIELD_U8,  VED_UNIT_STATE,    1,      0x0201, VED_HEX_UN8,  1, 1 },
+  { VED_LABEL_MODE,     VED_FIELD_I8,  VED_UNIT_STATE,    1,      0x0200, VED_HEX_UN8,  1, 1 },
+  { VED_LABEL_OR,       VED_FIELD_U8,  VED_UNIT_STATE,    1,      0x0207, VED_HEX_UN32, 1, 1 },
+  { VED_LABEL_AR,       VED_FIELD_U8,  VED_UNIT_STATE,    1,      0x031E, VED_HEX_UN16, 1, 1 },
+  { VED_LABEL_WARN,     VED_FIELD_U8,  VED_UNIT_STATE,    1,      0x031C, VED_HEX_UN16, 1, 1 }
+};
+
+static constexpr VEDFieldSpec fieldsBATT[VED_BATT_FIELDS] = {
+  { VED_LABEL_V,   VED_FIELD_F32, VED_UNIT_MV,       0.001f, 0xED8D, VED_HEX_SN16, 10, 1 },   // Battery voltage mV -> V
+  { VED_LABEL_VS,  VED_FIELD_F32, VED_UNIT_MV,       0.001f, 0xED7D, VED_HEX_UN16, 10, 1 },   // Aux voltage mV -> V
+  { VED_LABEL_I,   VED_FIELD_F32, VED_UNIT_MA,       0.001f, 0xED8F, VED_HEX_SN16, 100, 1 },  // Battery current mA -> A
+  { VED_LABEL_P,   VED_FIELD_I16, VED_UNIT_W,        1,      0xED8E, VED_HEX_SN16, 1, 1 },    // Power W
+  { VED_LABEL_CE,  VED_FIELD_F32, VED_UNIT_MAH,      0.001f, 0xEEFF, VED_HEX_SN32, 100, 1 },  // Consumed mAh -> Ah
+  { VED_LABEL_SOC, VED_FIELD_U16, VED_UNIT_PERMILLE, 1,      0x0FFF, VED_HEX_UN16, 1, 10 },   // State of charge permille
+  { VED_LABEL_TTG, VED_FIELD_U16, VED_UNIT_OTHER,    1,      0x0FFE, VED_HEX_UN16, 1, 1 },    // Time to go minutes
+  { VED_LABEL_AR,  VED_FIELD_U8,  VED_UNIT_STATE,    1,      0,      VED_HEX_NONE, 1, 1 }
+};
+
+// History values, only sent in the second TEXT block of a battery monitor
+static constexpr VEDFieldSpec fieldsBATT_SUP[VED_BATT_SUP_FIELDS] = {
+  { VED_LABEL_H2,  VED_FIELD_F32, VED_UNIT_MAH,      0.001f, 0, VED_HEX_NONE, 1, 1 },  // Depth of last discharge mAh -> Ah
+  { VED_LABEL_H4,  VED_FIELD_U16, VED_UNIT_OTHER,    1,      0, VED_HEX_NONE, 1, 1 },  // Charge cycles
+  { VED_LABEL_H7,  VED_FIELD_F32, VED_UNIT_MV,       0.001f, 0, VED_HEX_NONE, 1, 1 },  // Min battery voltage mV -> V
+  { VED_LABEL_H15, VED_FIELD_F32, VED_UNIT_MV,       0.001f, 0, VED_HEX_NONE, 1, 1 },  // Min aux voltage mV -> V
+  { VED_LABEL_H18, VED_FIELD_F32, VED_UNIT_OTHER,    10,     0, VED_HEX_NONE, 1, 1 },  // Charged energy 0.01kWh -> Wh
+  { VED_LABEL_H17, VED_FIELD_F32, VED_UNIT_OTHER,    10,     0, VED_HEX_NONE, 1, 1 }   // Discharged energy 0.01kWh -> Wh
+};
+
+static constexpr VEDSchema schemas[VED_CLASS_COUNT] = {
+  { VED_CLASS_NONE,     nullptr,        0 },
+  { VED_CLASS_MPPT,     fieldsMPPT,     VED_MPPT_FIELDS },
+  { VED_CLASS_INV,      fieldsINV,      VED_INV_FIELDS },
+  { VED_CLASS_BATT,     fieldsBATT,     VED_BATT_FIELDS },
+  { VED_CLASS_BATT_SUP, fieldsBATT_SUP, VED_BATT_SUP_FIELDS }
+};
+
+static_assert(VED_MPPT_FIELDS <= VED_SNAPSHOT_MAX_FIELDS && VED_INV_FIELDS <= VED_SNAPSHOT_MAX_FIELDS
+  && VED_BATT_FIELDS <= VED_SNAPSHOT_MAX_FIELDS && VED_BATT_SUP_FIELDS <= VED_SNAPSHOT_MAX_FIELDS,
+  "VED_SNAPSHOT_MAX_FIELDS too small for a device schema");
+
+const VEDSchema* VED_schema(uint8_t deviceClass) {
+  return deviceClass < VED_CLASS_COUNT ? &schemas[deviceClass] : &schemas[VED_CLASS_NONE];
+}
+
+void VED_capture(const CVEDFrame &frame, uint8_t deviceClass, uint16_t pid, ved_snapshot_t *snapshot) {
+  const VEDSchema *schema = VED_schema(deviceClass);
+  snapshot->deviceClass = deviceClass;
+  snapshot->pid = pid;
+  snapshot->present = 0;
+  for (uint8_t f = 0; f < schema->count; f++) {
+    const VEDLabel label = schema->fields[f].label;
+    snapshot->raw[f] = frame.getInt(label);
+    if (frame.has(label)) {
+      snapshot->present |= 1 << f;
+    }
+  }
+}
+
+void VED_captureHex(const uint8_t *data, uint8_t length, uint8_t field, ved_snapshot_t *snapshot) {
+  const VEDFieldSpec &spec = VED_schema(snapshot->deviceClass)->fields[field];
+  const bool isSigned = spec.hexType == VED_HEX_SN16 || spec.hexType == VED_HEX_SN32;
+  const int32_t value = CVEDirectHex::decodeValue(data, length, isSigned);
+  snapshot->raw[field] = value * spec.hexMul / spec.hexDiv;
+  snapshot->present |= 1 << field;
+}
+
+uint8_t VED_nextHexField(uint8_t deviceClass, uint8_t field) {
+  const VEDSchema *schema = VED_schema(deviceClass);
+  while (field < schema->count && schema->fields[field].hexType == VED_HEX_NONE) {
+    field++;
+  }
+  return field;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "VEDirectFrame.h"
+
+// Per device class description of which VE.Direct labels feed which message field.
+// Field order matches the layout of the corresponding r24_message_ved_*_t struct.
+
+enum VEDDeviceClass : uint8_t {
+  VED_CLASS_NONE = 0,
+  VED_CLASS_MPPT,
+  VED_CLASS_INV,
+  VED_CLASS_BATT,
+  VED_CLASS_BATT_SUP,
+  VED_CLASS_COUNT
+};
+
+enum VEDFieldType : uint8_t {
+  VED_FIELD_F32,
+  VED_FIELD_U8,
+  VED_FIELD_I8,
+  VED_FIELD_U16,
+  VED_FIELD_I16
+};
+
+// What a field's TEXT protocol value measures, selects its deadband
+enum VEDUnit : uint8_t {
+  VED_UNIT_STATE,     // Enumerations and flags, any change counts
+  VED_UNIT_MV,
+  VED_UNIT_MA,
+  VED_UNIT_MAH,
+  VED_UNIT_PERMILLE,
+  VED_UNIT_W,         // W or VA
+  VED_UNIT_OTHER,     // Counters, energy and time, in the label's own unit
+  VED_UNIT_COUNT
+};
+
+// Width and sign of a HEX protocol register
+enum VEDHexType : uint8_t {
+  VED_HEX_NONE,     // Not available over HEX
+  VED_HEX_UN8,
+  VED_HEX_UN16,
+  VED_HEX_SN16,
+  VED_HEX_UN32,
+  VED_HEX_SN32
+};
+
+struct VEDFieldSpec {
+  VEDLabel label;
+  VEDFieldType type;
+  VEDUnit unit;
+  float scale;          // Message value = decoded label value * scale
+  uint16_t hexRegister; // Register holding the same value, queried over HEX
+  VEDHexType hexType;
+  int16_t hexMul;       // Label value = register value * hexMul / hexDiv
+  uint8_t hexDiv;
+};
+
+struct VEDSchema {
+  VEDDeviceClass deviceClass;
+  const VEDFieldSpec *fields;
+  uint8_t count;
+};
+
+enum { VED_MPPT_V, VED_MPPT_I, VED_MPPT_VPV, VED_MPPT_PPV, VED_MPPT_CS, VED_MPPT_MPPT, VED_MPPT_OR, VED_MPPT_ERR, VED_MPPT_H20, VED_MPPT_H21, VED_MPPT_FIELDS };
+enum { VED_INV_V, VED_INV_AC_OUT_I, VED_INV_AC_OUT_V, VED_INV_AC_OUT_S, VED_INV_CS, VED_INV_MODE, VED_INV_OR, VED_INV_AR, VED_INV_WARN, VED_INV_FIELDS };
+enum { VED_BATT_V, VED_BATT_VS, VED_BATT_I, VED_BATT_P, VED_BATT_CE, VED_BATT_SOC, VED_BATT_TTG, VED_BATT_AR, VED_BATT_FIELDS };
+enum { VED_BATT_SUP_H2, VED_BATT_SUP_H4, VED_BATT_SUP_H7, VED_BATT_SUP_H15, VED_BATT_SUP_H18, VED_BATT_SUP_H17, VED_BATT_SUP_FIELDS };
+
+#define VED_SNAPSHOT_MAX_FIELDS 10
+
+const VEDSchema* VED_schema(uint8_t deviceClass);
+
+// Integer values of one device frame, captured according to its class schema
+typedef struct ved_snapshot_t {
+  uint8_t deviceClass;
+  uint16_t pid;
+  uint16_t present;   // Bit per schema field, cleared when the label was missing from the frame
+  int32_t raw[VED_SNAPSHOT_MAX_FIELDS];
+
+  template <typename T>
+  T value(uint8_t field) const {
+    const VEDFieldSpec &spec = VED_schema(deviceClass)->fields[field];
+    return spec.scale == 1 ? static_cast<T>(raw[field]) : static_cast<T>(raw[field] * spec.scale);
+  }
+} ved_snapshot_t;
+
+// Copies the schema fields out of a received frame, missing labels read as 0
+void VED_capture(const CVEDFrame &frame, uint8_t deviceClass, uint16_t pid, ved_snapshot_t *snapshot);
+// Stores a HEX register value into the snapshot field, converted to TEXT protocol units
+void VED_captureHex(const uint8_t *data, uint8_t length, uint8_t field, ved_snapshot_t *snapshot);
+// Next field at or after the given one that can be queried over HEX, or the field count when none
+uint8_t VED_nextHexField(uint8_t deviceClass, uint8_t field);
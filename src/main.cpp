@@ -10,15 +10,32 @@
 #include "VEDMessageProvider.h"
 #include "RF24Manager.h"
 #include "VEDirectManager.h"
+#include "Scheduler.h"
+#include "PhaseTrace.h"
+#include "EventTrace.h"
+#include "RF24Gateway.h"
+
+#ifndef STUS_GATEWAY
 
 CRF24Manager *rf24Manager;
-CVEDirectManager *vedManager;
+CVEDirectManager *vedManager = NULL;
 CDevice *device;
+CScheduler scheduler;
 unsigned long tsMillisBooted;
 
+#if defined(SEEED_XIAO_M0)
+// The core calls yield() while waiting in delay(), keep draining the small UART buffer meanwhile
+void yield() {
+  if (vedManager != NULL) {
+    vedManager->pumpRx();
+  }
+}
+#endif
+
 #define LED_SETUP INTERNAL_LED_PIN
 
 void setup() {
+  TRACE_begin(0);
   randomSeed(analogRead(0));
   
   pinMode(INTERNAL_LED_PIN, OUTPUT);
@@ -30,13 +47,20 @@ void setup() {
   Serial.begin(19200); while (!Serial); delay(100);
   Log.begin(LOG_LEVEL, &Serial);
   Log.infoln(F("Initializing..."));
+  #elif EVENT_TRACE_LEVEL > LOG_LEVEL_SILENT
+  Serial.begin(19200); // Not waiting for USB, the dump is skipped when nobody listens
   #endif
 
+  // Right after logging, so its init messages show, the temperature conversion runs while the rest boots
   device = new CDevice();
   vedManager = new CVEDirectManager(device);
   rf24Manager = new CRF24Manager(vedManager);
   tsMillisBooted = millis();
 
+  scheduler.add(device);
+  scheduler.add(vedManager);
+  scheduler.add(rf24Manager);
+
   if (rf24Manager->isError() || vedManager->isError()) {
     Log.errorln(F("rf24Manager->isError()=%i; vedManager->isError()=%i"), rf24Manager->isError(), vedManager->isError());
     while(true) {
@@ -52,14 +76,13 @@ void setup() {
   digitalWrite(LED_SETUP, LOW);
   delay(100);
   digitalWrite(LED_SETUP, HIGH);
+  TRACE_mark(PHASE_SETUP);
 }
 
 void loop() {
   
   intLEDOn();
-  device->loop();
-  vedManager->loop();
-  rf24Manager->loop();
+  scheduler.run();
 
   // Conditions for deep sleep:
   // - Min time elapsed since smooth boot
@@ -68,22 +91,40 @@ void loop() {
     && millis() - tsMillisBooted > DEEP_SLEEP_MIN_AWAKE_MS
     && rf24Manager->isJobDone()) {
 
-    Log.noticeln(F("Initiating deep sleep for %u sec"), DEEP_SLEEP_INTERVAL_SEC);
+    Log.noticeln(F("Awake %u ms with a duty cycle of %u permille"), millis() - tsMillisBooted, scheduler.getDutyCycle());
+    TRACE_end();
+    TRACE_log();
     intLEDOff();
+    rf24Manager->powerDown(); // First, so what it couldn't deliver reaches the log
+    vedManager->powerDown();
+    device->powerDown();
+    const uint32_t sleepMs = rf24Manager->getSleepMs();
+    #if EVENT_TRACE_LEVEL > LOG_LEVEL_SILENT
+      if (Serial) {
+        EVENT_dump(&Serial);
+        Serial.flush();
+      }
+    #endif
+    Log.noticeln(F("Initiating deep sleep for %u ms"), sleepMs);
+    CONFIG_sleepClock(sleepMs);
     #if defined(ESP32)
-      ESP.deepSleep((uint64_t)DEEP_SLEEP_INTERVAL_SEC * 1e6);
+      ESP.deepSleep((uint64_t)sleepMs * 1000);
     #elif defined(ESP8266)
-      ESP.deepSleep((uint64_t)DEEP_SLEEP_INTERVAL_SEC * 1e6); 
+      ESP.deepSleep((uint64_t)sleepMs * 1000); 
     #elif defined(SEEED_XIAO_M0)
-      rf24Manager->powerDown();
-      LowPower.deepSleep(DEEP_SLEEP_INTERVAL_SEC * 1000);
+      LowPower.deepSleep(sleepMs);
       delay(100);
       // This deep sleep resumes where it left off on waking
+      device->powerUp();
       rf24Manager->powerUp();
+      vedManager->powerUp();
       tsMillisBooted = millis();
+      scheduler.resetStats();
+      TRACE_begin(tsMillisBooted);
+      TRACE_mark(PHASE_SETUP);
     #else
       Log.warningln(F("Scratch that, deep sleep is not supported on this platform, delaying instead"));
-      delayMicroseconds((uint64_t)DEEP_SLEEP_INTERVAL_SEC * 1e6);
+      delay(sleepMs);
     #endif
   } else if (DEEP_SLEEP_INTERVAL_SEC == 0 
     && millis() - tsMillisBooted > DEEP_SLEEP_MIN_AWAKE_MS
@@ -92,11 +133,16 @@ void loop() {
     intLEDOff();
     rf24Manager->powerDown();
     vedManager->powerDown();
+    TRACE_end();
+    TRACE_log();
     Log.infoln(F("Deep sleep disabled, chilling for 5 sec"));
     delay(5000);
     rf24Manager->powerUp();
     vedManager->powerUp();
     tsMillisBooted = millis();
+    scheduler.resetStats();
+    TRACE_begin(tsMillisBooted);
+    TRACE_mark(PHASE_SETUP);
   }
 
   if (rf24Manager->isRebootNeeded() 
@@ -115,4 +161,30 @@ void loop() {
   yield();
 }
 
+#else
+
+CRF24Gateway *gateway;
+
+void setup() {
+  pinMode(INTERNAL_LED_PIN, OUTPUT);
+  Serial.begin(GATEWAY_SERIAL_BAUD);
+  #ifndef DISABLE_LOGGING
+  Log.begin(LOG_LEVEL, &Serial);
+  #endif
+
+  gateway = new CRF24Gateway(&Serial, &Serial);
+  if (gateway->isError()) {
+    while(true) {
+      intLEDBlink(250);
+      delay(250);
+    }
+  }
+  intLEDOn();
+}
+
+void loop() {
+  gateway->loop();
+  yield();
+}
 
+#endif